@@ -0,0 +1,261 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#pragma once
+#include <fileio.h>
+#include <path_string.h>
+#include "../parse/parser/parse.h"
+#include "../output/common/analisis/resolve_names.h"
+#include "../calc/fold_const.h"
+#include "../output/cpp/generic_schema.h"
+#include "../output/cpp/alias_to_enum.h"
+#include "../output/cpp/add_error_enum.h"
+#include "../output/cpp/runtime_helper.h"
+#include "../output/cpp/generic_engine.h"
+#include "../output/cpp/harness.h"
+#include "work_pool.h"
+#include <set>
+
+namespace binred::build {
+    struct SourceFile {
+        std::string path;
+        TokenReader red;
+        ParseResult result;
+        Record record;
+        cpp::CppOutContext aliases, cargos;
+        std::vector<std::string> names;
+        // cargos which generic backend can't translate
+        std::vector<std::string> unsupported;
+        std::string error;
+    };
+
+    // Build translates many files into one header
+    // files are parsed and emitted in parallel, and Records are merged in input order,
+    // so that output does not depend on thread count
+    // name resolution needs every Record, so resolve and fold run once on merged Record
+    struct Build {
+        std::vector<SourceFile> files;
+        Record record;
+        ParseResult result;
+        // output option flags; error enums and buffer are merged into it
+        cpp::CppOutContext ctx;
+        std::vector<std::string> names;
+        // cargos written by normal backend in generic mode
+        std::set<std::string> fallback;
+        std::string error;
+
+        static void parse_file(SourceFile& file) {
+            commonlib2::Reader<commonlib2::FileReader> fin(commonlib2::FileReader(commonlib2::ToPath(file.path).c_str()));
+            if (!fin.ref().is_open()) {
+                file.error = file.path + ": couldn't open";
+                return;
+            }
+            if (!parse_binred(fin, file.red, file.record, file.result)) {
+                file.error = file.path + ": parse error (code " + std::to_string(int(file.red.code)) + ")";
+                if (file.red.additional) {
+                    file.error += std::string(" ") + file.red.additional;
+                }
+            }
+        }
+
+        // find_unsupported tries generic backend on scratch context
+        static void find_unsupported(SourceFile& file, Record& record, const cpp::CppOutContext& option) {
+            for (auto& e : file.result) {
+                if (e->type != ElementType::cargo) {
+                    continue;
+                }
+                auto cargo = castptr<Cargo>(e);
+                auto scratch = option;
+                if (!cpp::CargoToGeneric::convert(scratch, *cargo, record)) {
+                    file.unsupported.push_back(cargo->name);
+                }
+            }
+        }
+
+        // cargo linked to fallback cargo by base or nested param falls back too,
+        // because normal backend calls member functions of linked cargo and generic engine needs its schema
+        void close_fallback() {
+            for (auto& file : files) {
+                fallback.insert(file.unsupported.begin(), file.unsupported.end());
+            }
+            auto link = [&](const std::string& a, const std::string& b) {
+                if (!record.cargos.count(b) || fallback.count(a) == fallback.count(b)) {
+                    return false;
+                }
+                fallback.insert(a);
+                fallback.insert(b);
+                return true;
+            };
+            for (auto changed = fallback.size() != 0; changed;) {
+                changed = false;
+                for (auto& c : record.cargos) {
+                    changed |= link(c.first, c.second->base.basename);
+                    for (auto& param : c.second->params) {
+                        if (param->type == ParamType::custom) {
+                            changed |= link(c.first, castptr<Custom>(param)->cargoname);
+                        }
+                    }
+                }
+            }
+        }
+
+        // emit_file reads merged Record only
+        static void emit_file(SourceFile& file, Record& record, const cpp::CppOutContext& option, const std::set<std::string>& fallback) {
+            file.aliases = option;
+            file.cargos = option;
+            for (auto& a : file.record.aliases) {
+                cpp::AliasToCppEnum::convert(file.aliases, *a.second);
+            }
+            for (auto& e : file.result) {
+                if (e->type != ElementType::cargo) {
+                    continue;
+                }
+                auto cargo = castptr<Cargo>(e);
+                auto generic = option.generic && !fallback.count(cargo->name);
+                if (option.generic && !generic) {
+                    file.cargos.write("\n// " + cargo->name + " is not supported by generic engine and has member functions instead\n");
+                }
+                auto ok = generic ? cpp::CargoToGeneric::convert(file.cargos, *cargo, record)
+                                  : cpp::CargoToCppStruct::convert(file.cargos, *cargo, record);
+                if (!ok) {
+                    file.error = file.path + ": cargo `" + cargo->name + "` couldn't be translated";
+                    return;
+                }
+                file.names.push_back(cargo->name);
+            }
+        }
+
+        bool collect_error() {
+            for (auto& file : files) {
+                if (file.error.size()) {
+                    if (error.size()) {
+                        error += "\n";
+                    }
+                    error += file.error;
+                }
+            }
+            return error.size() == 0;
+        }
+
+        // get selects same map of each Record
+        template <class Get>
+        bool merge_map(Get get, const char* kind, size_t index) {
+            auto& to = get(record);
+            for (auto& e : get(files[index].record)) {
+                if (to.insert(e).second) {
+                    continue;
+                }
+                std::string first;
+                for (size_t i = 0; i < index; i++) {
+                    if (get(files[i].record).count(e.first)) {
+                        first = files[i].path;
+                        break;
+                    }
+                }
+                error = files[index].path + ": " + kind + " `" + e.first + "` is already defined in " + first;
+                return false;
+            }
+            return true;
+        }
+
+        bool merge() {
+            for (size_t i = 0; i < files.size(); i++) {
+                auto& file = files[i];
+                if (file.record.libname.size()) {
+                    if (record.libname.size() && record.libname != file.record.libname) {
+                        error = file.path + ": libname `" + file.record.libname + "` differs from `" + record.libname + "`";
+                        return false;
+                    }
+                    record.libname = file.record.libname;
+                }
+                if (!merge_map([](Record& r) -> auto& { return r.cargos; }, "cargo", i) ||
+                    !merge_map([](Record& r) -> auto& { return r.aliases; }, "alias", i) ||
+                    !merge_map([](Record& r) -> auto& { return r.types; }, "type alias", i) ||
+                    !merge_map([](Record& r) -> auto& { return r.complexes; }, "complex", i) ||
+                    !merge_map([](Record& r) -> auto& { return r.mep.macros; }, "macro", i)) {
+                    return false;
+                }
+                result.insert(result.end(), file.result.begin(), file.result.end());
+            }
+            return true;
+        }
+
+        // load parses, merges, resolves and folds inputs into record and result
+        bool load(const std::vector<std::string>& inputs, WorkPool& pool) {
+            files = std::vector<SourceFile>(inputs.size());
+            for (size_t i = 0; i < inputs.size(); i++) {
+                files[i].path = inputs[i];
+            }
+            pool.run(files.size(), [&](size_t i) {
+                parse_file(files[i]);
+            });
+            if (!collect_error() || !merge()) {
+                return false;
+            }
+            analisis::SortElement sorted(result);
+            if (auto err = analisis::TypeResolver::resolve(sorted, record); err) {
+                error = err.errmsg;
+                return false;
+            }
+            if (!fold_record(result, record)) {
+                error = "failed to fold constant";
+                return false;
+            }
+            return true;
+        }
+
+        bool load(const std::vector<std::string>& inputs, size_t threads) {
+            WorkPool pool(threads);
+            return load(inputs, pool);
+        }
+
+        bool run(const std::vector<std::string>& inputs, size_t threads) {
+            WorkPool pool(threads);
+            if (!load(inputs, pool)) {
+                return false;
+            }
+            if (ctx.generic) {
+                pool.run(files.size(), [&](size_t i) {
+                    find_unsupported(files[i], record, ctx);
+                });
+                close_fallback();
+            }
+            pool.run(files.size(), [&](size_t i) {
+                emit_file(files[i], record, ctx, fallback);
+            });
+            if (!collect_error()) {
+                return false;
+            }
+            // aliases of every file come before cargos because cargo may use enum of other file
+            for (auto& file : files) {
+                for (auto& e : file.aliases.enum_v) {
+                    ctx.set_error_enum(e);
+                }
+                ctx.write(file.aliases.buffer);
+            }
+            for (auto& file : files) {
+                for (auto& e : file.cargos.enum_v) {
+                    ctx.set_error_enum(e);
+                }
+                ctx.merge_use(file.cargos);
+                ctx.write(file.cargos.buffer);
+                names.insert(names.end(), file.names.begin(), file.names.end());
+            }
+            return true;
+        }
+
+        std::string header() {
+            std::string ret = "// generated by binred\n#pragma once\n";
+            ret += cpp::runtime_helper(ctx);
+            ret += cpp::error_enum_class(ctx);
+            if (ctx.generic) {
+                ret += cpp::generic_engine(ctx);
+            }
+            return ret + ctx.buffer;
+        }
+    };
+}  // namespace binred::build
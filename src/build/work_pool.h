@@ -0,0 +1,81 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#pragma once
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+namespace binred::build {
+    // WorkPool runs count indexed tasks on at most threads workers
+    // tasks are dealt round robin; worker takes front of own queue
+    // and steals back of others when own queue is empty, so one large file does not stall the rest
+    // task must not throw
+    struct WorkPool {
+        struct Queue {
+            std::mutex lock;
+            std::deque<size_t> tasks;
+        };
+
+        size_t threads = 1;
+
+        WorkPool(size_t threads)
+            : threads(threads ? threads : 1) {}
+
+        template <class F>
+        void run(size_t count, F&& f) {
+            auto workers = (std::min)(threads, count);
+            if (workers <= 1) {
+                for (size_t i = 0; i < count; i++) {
+                    f(i);
+                }
+                return;
+            }
+            std::vector<Queue> queues(workers);
+            for (size_t i = 0; i < count; i++) {
+                queues[i % workers].tasks.push_back(i);
+            }
+            auto take = [&](size_t self, size_t& task) {
+                {
+                    auto& own = queues[self];
+                    std::lock_guard<std::mutex> l(own.lock);
+                    if (own.tasks.size()) {
+                        task = own.tasks.front();
+                        own.tasks.pop_front();
+                        return true;
+                    }
+                }
+                for (size_t k = 1; k < workers; k++) {
+                    auto& other = queues[(self + k) % workers];
+                    std::lock_guard<std::mutex> l(other.lock);
+                    if (other.tasks.size()) {
+                        task = other.tasks.back();
+                        other.tasks.pop_back();
+                        return true;
+                    }
+                }
+                return false;
+            };
+            auto work = [&](size_t self) {
+                size_t task;
+                while (take(self, task)) {
+                    f(task);
+                }
+            };
+            std::vector<std::thread> pool;
+            for (size_t i = 1; i < workers; i++) {
+                pool.emplace_back(work, i);
+            }
+            work(0);
+            for (auto& t : pool) {
+                t.join();
+            }
+        }
+    };
+}  // namespace binred::build
@@ -0,0 +1,363 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#pragma once
+#include "get_const.h"
+#include "cast_ptr.h"
+#include <extutil.h>
+
+namespace binred {
+
+    // fold_const folds constant sub-expression of expr in place
+    // alias reference ($Alias.name) is replaced by its value
+    // comparison result becomes boolean, arithmetic result becomes number
+    bool fold_const(std::shared_ptr<Expr>& expr, Record& rec) {
+        if (!expr) {
+            return true;
+        }
+        if (expr->kind == ExprKind::ref) {
+            auto splt = commonlib2::split(expr->v, ".");
+            if (splt.size() != 2) {
+                return true;
+            }
+            auto found = rec.aliases.find(splt[0]);
+            if (found == rec.aliases.end()) {
+                return true;
+            }
+            auto value = found->second->alias.find(splt[1]);
+            if (value == found->second->alias.end()) {
+                return false;
+            }
+            if (!fold_const(value->second->expr, rec)) {
+                return false;
+            }
+            auto got = get_const_int<std::int64_t>(value->second->expr);
+            if (!got.second) {
+                return true;
+            }
+            auto tmp = std::make_shared<Expr>();
+            tmp->kind = ExprKind::number;
+            tmp->v = std::to_string(got.first);
+            tmp->token = expr->token;
+            expr = tmp;
+            return true;
+        }
+        if (expr->kind == ExprKind::call) {
+            for (auto& arg : castptr<CallExpr>(expr)->args) {
+                if (!fold_const(arg, rec)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        if (expr->kind != ExprKind::op) {
+            return true;
+        }
+        if (!fold_const(expr->left, rec) || !fold_const(expr->right, rec)) {
+            return false;
+        }
+        auto& op = expr->v;
+        auto got = get_const_int<std::int64_t>(expr);
+        if (got.second) {
+            auto tmp = std::make_shared<Expr>();
+            tmp->token = expr->token;
+            if (op == "==" || op == "!=" || op == "<" || op == ">" || op == "<=" || op == ">=") {
+                tmp->kind = ExprKind::boolean;
+                tmp->v = got.first ? "true" : "false";
+            }
+            else {
+                tmp->kind = ExprKind::number;
+                tmp->v = std::to_string(got.first);
+            }
+            expr = tmp;
+            return true;
+        }
+        auto is_value = [](std::shared_ptr<Expr>& e, std::int64_t v) {
+            auto got = get_const_int<std::int64_t>(e);
+            return got.second && got.first == v;
+        };
+        if (((op == "+" || op == "-" || op == "|") && is_value(expr->right, 0)) ||
+            ((op == "*" || op == "/") && is_value(expr->right, 1))) {
+            expr = expr->left;
+        }
+        else if (((op == "+" || op == "|") && is_value(expr->left, 0)) ||
+                 (op == "*" && is_value(expr->left, 1))) {
+            expr = expr->right;
+        }
+        return true;
+    }
+
+    // is_const_bool reports whether condition is statically known
+    // first is condition value
+    std::pair<bool, bool> is_const_bool(std::shared_ptr<Expr>& expr) {
+        auto got = get_const_int<std::int64_t>(expr);
+        if (!got.second) {
+            return {false, false};
+        }
+        return {got.first != 0, true};
+    }
+
+    bool fold_condition(std::shared_ptr<Condition>& cond, Record& rec) {
+        if (!cond) {
+            return true;
+        }
+        if (!fold_const(cond->expr, rec)) {
+            return false;
+        }
+        if (auto got = is_const_bool(cond->expr); got.second && got.first) {
+            cond = nullptr;
+        }
+        return true;
+    }
+
+    // copy expr with reference `from` renamed to `to`
+    std::shared_ptr<Expr> rename_ref(const std::shared_ptr<Expr>& expr, const std::string& from, const std::string& to) {
+        if (!expr) {
+            return nullptr;
+        }
+        std::shared_ptr<Expr> ret;
+        if (expr->kind == ExprKind::call) {
+            auto c = std::make_shared<CallExpr>(*castptr<CallExpr>(expr));
+            for (auto& arg : c->args) {
+                arg = rename_ref(arg, from, to);
+            }
+            ret = c;
+        }
+        else {
+            ret = std::make_shared<Expr>(*expr);
+        }
+        if (ret->kind == ExprKind::ref && ret->v == from) {
+            ret->v = to;
+        }
+        ret->left = rename_ref(expr->left, from, to);
+        ret->right = rename_ref(expr->right, from, to);
+        return ret;
+    }
+
+    // type alias param (`name AliasName`) is replaced by copy of aliased builtin
+    // references to alias name in its decoration are renamed to param name
+    std::shared_ptr<Param> expand_typealias(std::shared_ptr<Param>& param, Record& rec) {
+        if (param->type != ParamType::custom) {
+            return param;
+        }
+        auto found = rec.types.find(castptr<Custom>(param)->cargoname);
+        if (found == rec.types.end()) {
+            return param;
+        }
+        auto& base = found->second->type;
+        std::shared_ptr<Param> ret;
+        switch (base->type) {
+            case ParamType::integer:
+                ret = std::make_shared<Int>(*castptr<Int>(base));
+                break;
+            case ParamType::uint:
+                ret = std::make_shared<UInt>(*castptr<UInt>(base));
+                break;
+            case ParamType::bit:
+                ret = std::make_shared<Bit>(*castptr<Bit>(base));
+                break;
+            case ParamType::byte:
+                ret = std::make_shared<Byte>(*castptr<Byte>(base));
+                break;
+            case ParamType::varint:
+                ret = std::make_shared<VarInt>(*castptr<VarInt>(base));
+                break;
+            case ParamType::leb128:
+                ret = std::make_shared<Leb128>(*castptr<Leb128>(base));
+                break;
+            case ParamType::zigzag:
+                ret = std::make_shared<ZigZag>(*castptr<ZigZag>(base));
+                break;
+            default:
+                return expand_typealias(base, rec);
+        }
+        auto rename = [&](auto& c) {
+            if (c) {
+                c = std::make_shared<std::remove_reference_t<decltype(*c)>>(*c);
+                c->expr = rename_ref(c->expr, base->name, param->name);
+            }
+        };
+        rename(ret->if_c);
+        rename(ret->bind_c);
+        rename(ret->default_v);
+        if (auto len = castptr<ExprLength>(castptr<Builtin>(ret)->length); len) {
+            auto tmp = std::make_shared<ExprLength>(*len);
+            tmp->expr = rename_ref(len->expr, base->name, param->name);
+            castptr<Builtin>(ret)->length = tmp;
+        }
+        ret->name = param->name;
+        ret->token = param->token;
+        ret->expand = param->expand;
+        ret->nilable = param->nilable;
+        if (param->if_c) {
+            ret->if_c = param->if_c;
+        }
+        if (param->bind_c) {
+            ret->bind_c = param->bind_c;
+        }
+        if (param->default_v) {
+            ret->default_v = param->default_v;
+        }
+        if (param->repeat) {
+            ret->repeat = param->repeat;
+        }
+        if (param->endian != Endian::none) {
+            ret->endian = param->endian;
+        }
+        if (param->checksum) {
+            ret->checksum = param->checksum;
+        }
+        return ret;
+    }
+
+    bool fold_param(std::shared_ptr<Param>& param, Record& rec) {
+        param = expand_typealias(param, rec);
+        if (param->type != ParamType::custom) {
+            auto b = castptr<Builtin>(param);
+            if (auto len = castptr<ExprLength>(b->length); len) {
+                auto tmp = std::make_shared<ExprLength>(*len);
+                if (!fold_const(tmp->expr, rec)) {
+                    return false;
+                }
+                b->length = tmp;
+            }
+        }
+        if (param->default_v && !fold_const(param->default_v->expr, rec)) {
+            return false;
+        }
+        if (param->repeat && !fold_const(param->repeat->expr, rec)) {
+            return false;
+        }
+        return fold_condition(param->if_c, rec) && fold_condition(param->bind_c, rec);
+    }
+
+    bool fold_commands(std::vector<std::shared_ptr<Command>>& cmds, Record& rec) {
+        std::vector<std::shared_ptr<Command>> result;
+        for (auto& c : cmds) {
+            switch (c->kind) {
+                case CommandKind::pop:
+                    if (!fold_const(castptr<PopCommand>(c)->numpop, rec)) {
+                        return false;
+                    }
+                    break;
+                case CommandKind::push:
+                    if (!fold_const(castptr<PushCommand>(c)->numpop, rec)) {
+                        return false;
+                    }
+                    break;
+                case CommandKind::call: {
+                    for (auto& arg : castptr<CallCommand>(c)->call->args) {
+                        if (!fold_const(arg, rec)) {
+                            return false;
+                        }
+                    }
+                    break;
+                }
+                case CommandKind::assign:
+                    if (!fold_const(castptr<AssignCommand>(c)->expr, rec)) {
+                        return false;
+                    }
+                    break;
+                case CommandKind::bind:
+                case CommandKind::test: {
+                    auto& expr = c->kind == CommandKind::bind ? castptr<BindCommand>(c)->expr : castptr<TestCommand>(c)->expr;
+                    if (!fold_const(expr, rec)) {
+                        return false;
+                    }
+                    if (auto got = is_const_bool(expr); got.second && got.first) {
+                        continue;
+                    }
+                    break;
+                }
+                case CommandKind::transfer_if: {
+                    auto tif = castptr<TransferIf>(c);
+                    if (!fold_const(tif->cond, rec)) {
+                        return false;
+                    }
+                    if (auto got = is_const_bool(tif->cond); got.second) {
+                        if (!got.first) {
+                            continue;
+                        }
+                        auto tmp = std::make_shared<TransferDirect>(std::shared_ptr<token_t>(tif->token));
+                        tmp->data = tif->data;
+                        result.push_back(tmp);
+                        continue;
+                    }
+                    break;
+                }
+                case CommandKind::transfer_switch: {
+                    auto tsw = castptr<TransferSwitch>(c);
+                    if (!fold_const(tsw->cond, rec)) {
+                        return false;
+                    }
+                    for (auto& t : tsw->to) {
+                        if (!fold_const(t.first, rec)) {
+                            return false;
+                        }
+                    }
+                    break;
+                }
+                case CommandKind::if_: {
+                    auto cif = castptr<IfCommand>(c);
+                    std::vector<std::shared_ptr<IfCondition>> ifs;
+                    for (auto& cond : cif->ifs) {
+                        if (!fold_const(cond->expr, rec) || !fold_commands(cond->cmds, rec)) {
+                            return false;
+                        }
+                        if (auto got = is_const_bool(cond->expr); got.second) {
+                            if (!got.first) {
+                                continue;
+                            }
+                            cond->expr = nullptr;
+                        }
+                        ifs.push_back(cond);
+                        if (!cond->expr) {
+                            break;
+                        }
+                    }
+                    if (!ifs.size()) {
+                        continue;
+                    }
+                    cif->ifs = std::move(ifs);
+                    break;
+                }
+                default:
+                    break;
+            }
+            result.push_back(c);
+        }
+        cmds = std::move(result);
+        return true;
+    }
+
+    // fold_record folds every expression reachable from result
+    // statically true if/bind decoration and bind/test command are removed
+    // statically false if/elif branch is removed
+    // statically false if decoration is left as constant (see is_absent)
+    bool fold_record(ParseResult& result, Record& rec) {
+        for (auto& e : result) {
+            switch (e->type) {
+                case ElementType::cargo:
+                    for (auto& p : castptr<Cargo>(e)->params) {
+                        if (!fold_param(p, rec)) {
+                            return false;
+                        }
+                    }
+                    break;
+                case ElementType::read:
+                case ElementType::write:
+                    if (!fold_commands(castptr<IOElement>(e)->cmds, rec)) {
+                        return false;
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+        return true;
+    }
+}  // namespace binred
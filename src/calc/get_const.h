@@ -28,6 +28,9 @@ namespace binred {
             commonlib2::Reader(expr->v) >> int_v;
             return {int_v, true};
         }
+        else if (expr->kind == ExprKind::boolean) {
+            return {expr->v == "true" ? 1 : 0, true};
+        }
         else if (expr->kind == ExprKind::op) {
             auto left = get_const_int<Int>(expr->left);
             if (!left.second) {
@@ -84,7 +87,7 @@ namespace binred {
                 return {lv >= rv, true};
             }
             else if (expr->v == "<=") {
-                return {lv >= rv, true};
+                return {lv <= rv, true};
             }
             else {
                 return {0, false};
@@ -94,4 +97,15 @@ namespace binred {
             return {0, false};
         }
     }
+
+    // is_absent reports whether if decoration of param is statically false
+    // fold_record leaves such decoration as constant, and generators skip the param
+    // so it is never on wire and keeps its default
+    bool is_absent(std::shared_ptr<Param>& param) {
+        if (!param->if_c) {
+            return false;
+        }
+        auto got = get_const_int<std::int64_t>(param->if_c->expr);
+        return got.second && got.first == 0;
+    }
 }  // namespace binred
@@ -52,20 +52,20 @@ namespace PROJECT_NAME {
         DEFINE_ENABLE_IF_EXPR_VALID(return_Ret, static_cast<Ret>(std::declval<T>()(std::declval<Args>()...)));
         DEFINE_ENABLE_IF_EXPR_VALID(has_const_call, static_cast<Ret>(std::declval<const T>()(std::declval<Args>()...)));
 
-        template <bool is_ref = std::is_reference_v<Ret>>
+        template <bool is_ref = std::is_reference_v<Ret>, class Dummy = void>
         struct throw_exception_if_Ret_is_ref {
             static Ret get_Ret() {
                 return Ret();
             }
         };
 
-        template <>
-        struct throw_exception_if_Ret_is_ref<true> {
+        template <class Dummy>
+        struct throw_exception_if_Ret_is_ref<true, Dummy> {
             static Ret get_Ret() {
                     throw std::logic_error("Ret is reference type,"
                                            " but callback returned what is not castable to Ret"
                                            " or failed to call."
-                                           " please check is_noexcept_after_call() is true before call"));
+                                           " please check is_noexcept_after_call() is true before call");
             }
         };
 
@@ -0,0 +1,101 @@
+/*
+    commonlib - common utility library
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#pragma once
+#include "project_name.h"
+#include <stddef.h>
+
+#include <vector>
+
+namespace PROJECT_NAME {
+
+    // SegmentBuffer is buffer type for Reader<Buf> over chain of segments
+    // such as iovec array filled by readv
+    // segments are not copied; caller must keep them alive while reading
+    struct SegmentBuffer {
+       private:
+        struct Segment {
+            const char* ptr = nullptr;
+            size_t len = 0;
+            size_t offset = 0;
+        };
+        std::vector<Segment> segs;
+        size_t size_cache = 0;
+        mutable size_t current = 0;
+
+        // find segment which contains p
+        // access near previous position stays in same segment without search
+        const Segment* find(size_t p) const {
+            if (size_cache <= p) return nullptr;
+            auto& cur = segs[current];
+            if (cur.offset <= p && p < cur.offset + cur.len) {
+                return &cur;
+            }
+            if (current + 1 < segs.size() && segs[current + 1].offset <= p &&
+                p < segs[current + 1].offset + segs[current + 1].len) {
+                current++;
+                return &segs[current];
+            }
+            size_t begin = 0, end = segs.size();
+            while (begin + 1 < end) {
+                auto mid = (begin + end) / 2;
+                if (segs[mid].offset <= p) {
+                    begin = mid;
+                }
+                else {
+                    end = mid;
+                }
+            }
+            current = begin;
+            return &segs[current];
+        }
+
+       public:
+        SegmentBuffer() {}
+
+        template <class Iov>
+        SegmentBuffer(const Iov* iov, size_t count) {
+            for (size_t i = 0; i < count; i++) {
+                append(iov[i].iov_base, iov[i].iov_len);
+            }
+        }
+
+        void append(const void* ptr, size_t len) {
+            if (!ptr || !len) return;
+            segs.push_back({static_cast<const char*>(ptr), len, size_cache});
+            size_cache += len;
+        }
+
+        void clear() {
+            segs.clear();
+            size_cache = 0;
+            current = 0;
+        }
+
+        size_t size() const {
+            return size_cache;
+        }
+
+        char operator[](size_t p) const {
+            auto seg = find(p);
+            if (!seg) return 0;
+            return seg->ptr[p - seg->offset];
+        }
+
+        // contiguous returns pointer to len bytes from p if they are in one segment
+        // otherwise nullptr and caller should fall back to operator[]
+        const char* contiguous(size_t p, size_t len) const {
+            auto seg = find(p);
+            if (!seg || seg->offset + seg->len - p < len) return nullptr;
+            return seg->ptr + (p - seg->offset);
+        }
+
+        size_t segment_count() const {
+            return segs.size();
+        }
+    };
+}  // namespace PROJECT_NAME
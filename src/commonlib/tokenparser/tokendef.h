@@ -574,7 +574,7 @@ namespace PROJECT_NAME {
                 if (this->get_kind() != TokenKind::keyword) {
                     return false;
                 }
-                set_kind(TokenKind::weak_keyword);
+                this->set_kind(TokenKind::weak_keyword);
                 return true;
             }
 
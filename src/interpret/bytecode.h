@@ -0,0 +1,1117 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#pragma once
+
+#include "interpreter.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define BINRED_THREADED_DISPATCH
+#endif
+
+namespace binred::interpret {
+    enum class Op : std::uint8_t {
+        end,
+        jmp,
+        jz,
+        fail,
+        transfer,
+        transfer_switch,
+        guard,
+        load,
+        u8,
+        be16,
+        le16,
+        be32,
+        le32,
+        be64,
+        le64,
+        load_check,
+        u8_check,
+        be16_check,
+        be32_check,
+        bits,
+        varint,
+        leb128,
+        zigzag,
+        bytes,
+        skip,
+        back,
+        cargo,
+        array,
+        check,
+        movi,
+        mov,
+        add,
+        sub,
+        mul,
+        div,
+        mod,
+        and_,
+        or_,
+        xor_,
+        eq,
+        lt,
+        gt,
+        le,
+        ge,
+        addi,
+        subi,
+        muli,
+        divi,
+        modi,
+        andi,
+        ori,
+        xori,
+        eqi,
+        lti,
+        gti,
+        lei,
+        gei,
+        count_,
+    };
+
+    namespace flag {
+        constexpr std::uint8_t little = 0x1;
+        constexpr std::uint8_t sign = 0x2;
+        constexpr std::uint8_t checked = 0x4;
+        constexpr std::uint8_t bytes = 0x8;
+        constexpr std::uint8_t fixed = 0x10;
+    }  // namespace flag
+
+    // Instr is one register instruction
+    // a is destination register, b is name, jump target, cargo or side table index
+    // c is source register (length register if fixed flag is not set)
+    // cmp is ExprOp of fused check or DecodeError of fail/check
+    struct Instr {
+        Op op = Op::end;
+        std::uint8_t width = 0;
+        std::uint8_t flags = 0;
+        std::uint8_t cmp = 0;
+        std::uint32_t a = 0;
+        std::uint32_t b = 0;
+        std::uint32_t c = 0;
+        std::int64_t imm = 0;
+    };
+
+    struct BitField {
+        std::uint32_t reg;
+        std::uint32_t name;
+        std::uint8_t shift;
+        std::uint8_t width;
+    };
+
+    struct ArrayCode {
+        Instr elem;
+        std::uint32_t name;
+    };
+
+    struct CargoCode {
+        std::uint32_t entry = 0;
+        size_t base = npos;
+        bool transfers = false;
+    };
+
+    // Program is Schema lowered into one code vector
+    // every cargo activation has regs registers: slots of largest frame first, then temporaries
+    // Program refers Schema for visitor callbacks, so Schema must outlive it
+    struct Program {
+        const Schema* schema = nullptr;
+        std::vector<Instr> code;
+        std::vector<std::uint32_t> where;
+        std::vector<std::string> names;
+        std::vector<CargoCode> cargos;
+        std::vector<BitField> bits;
+        std::vector<ArrayCode> arrays;
+        std::vector<std::pair<std::int64_t, std::uint32_t>> tables;
+        size_t regs = 0;
+    };
+
+    // Compiler lowers postfix expressions into three address code over registers
+    // and fuses integer load with following bind check against constant
+    struct Compiler {
+        struct Operand {
+            bool constant = false;
+            std::int64_t v = 0;
+            std::uint32_t reg = 0;
+        };
+
+        Program& prog;
+        std::map<std::string, std::uint32_t> interned;
+        size_t temp = 0;
+
+        Compiler(Program& prog)
+            : prog(prog) {}
+
+        std::uint32_t name(const std::string& s) {
+            auto found = interned.find(s);
+            if (found != interned.end()) {
+                return found->second;
+            }
+            auto id = std::uint32_t(prog.names.size());
+            prog.names.push_back(s);
+            interned[s] = id;
+            return id;
+        }
+
+        void emit(const Instr& in, const std::string& where) {
+            prog.code.push_back(in);
+            prog.where.push_back(name(where));
+        }
+
+        static bool fold(ExprOp op, std::int64_t l, std::int64_t r, std::int64_t& out) {
+            std::int64_t st[] = {0, 0};
+            ExprProgram p;
+            p.code = {{ExprOp::constant, l}, {ExprOp::constant, r}, {op}};
+            return Interpreter::eval(p, st, out);
+        }
+
+        static Op binary(ExprOp op, bool imm) {
+            auto base = imm ? Op::addi : Op::add;
+            return Op(std::uint8_t(base) + std::uint8_t(op) - std::uint8_t(ExprOp::add));
+        }
+
+        static ExprOp mirror(ExprOp op) {
+            switch (op) {
+                case ExprOp::lt:
+                    return ExprOp::gt;
+                case ExprOp::gt:
+                    return ExprOp::lt;
+                case ExprOp::le:
+                    return ExprOp::ge;
+                case ExprOp::ge:
+                    return ExprOp::le;
+                case ExprOp::sub:
+                case ExprOp::div:
+                case ExprOp::mod:
+                    return ExprOp::constant;
+                default:
+                    return op;
+            }
+        }
+
+        // expr lowers postfix program; operand on stack depth k is kept in temporary k
+        Operand expr(const ExprProgram& e, const std::string& where) {
+            Operand st[ExprProgram::max_depth];
+            size_t sp = 0;
+            auto tmp = [&](size_t k) {
+                temp = (std::max)(temp, k + 1);
+                return std::uint32_t(prog.regs + k);
+            };
+            for (auto& c : e.code) {
+                if (c.op == ExprOp::constant) {
+                    st[sp++] = {true, c.v};
+                    continue;
+                }
+                if (c.op == ExprOp::slot) {
+                    st[sp++] = {false, 0, std::uint32_t(c.v)};
+                    continue;
+                }
+                auto r = st[--sp];
+                auto l = st[sp - 1];
+                auto op = c.op;
+                std::int64_t v;
+                if (l.constant && r.constant && fold(op, l.v, r.v, v)) {
+                    st[sp - 1] = {true, v};
+                    continue;
+                }
+                auto dst = tmp(sp - 1);
+                if (l.constant) {
+                    if (auto m = mirror(op); m != ExprOp::constant && !r.constant) {
+                        std::swap(l, r);
+                        op = m;
+                    }
+                    else {
+                        // also when both are constant but not folded (division by zero), so that it fails at run time
+                        Instr mov{Op::movi};
+                        mov.a = dst;
+                        mov.imm = l.v;
+                        emit(mov, where);
+                        l = {false, 0, dst};
+                    }
+                }
+                Instr in{binary(op, r.constant)};
+                in.a = dst;
+                in.b = l.reg;
+                in.c = r.reg;
+                in.imm = r.v;
+                emit(in, where);
+                st[sp - 1] = {false, 0, dst};
+            }
+            return st[0];
+        }
+
+        void length(const Step& step, Instr& in) {
+            if (step.len != npos) {
+                in.flags |= flag::fixed;
+                in.imm = std::int64_t(step.len);
+                return;
+            }
+            auto len = expr(step.expr, step.where);
+            if (len.constant) {
+                in.flags |= flag::fixed;
+                in.imm = len.v;
+            }
+            else {
+                in.c = len.reg;
+            }
+        }
+
+        // fusable returns compare op if next is bind check of slot against constant
+        static bool fusable(const Step& step, const Step* next, ExprOp& cmp, std::int64_t& v) {
+            if (!next || next->kind != StepKind::check || next->check != CheckKind::bind || step.slot == npos) {
+                return false;
+            }
+            auto& c = next->expr.code;
+            if (c.size() != 3 || c[2].op < ExprOp::eq) {
+                return false;
+            }
+            if (c[0].op == ExprOp::slot && size_t(c[0].v) == step.slot && c[1].op == ExprOp::constant) {
+                cmp = c[2].op;
+                v = c[1].v;
+                return true;
+            }
+            if (c[1].op == ExprOp::slot && size_t(c[1].v) == step.slot && c[0].op == ExprOp::constant) {
+                cmp = mirror(c[2].op);
+                v = c[0].v;
+                return true;
+            }
+            return false;
+        }
+
+        Instr value(const Step& step) {
+            Instr in;
+            in.a = step.slot == npos ? 0 : std::uint32_t(step.slot);
+            in.b = name(step.name);
+            if (step.checked) {
+                in.flags |= flag::checked;
+            }
+            switch (step.kind) {
+                case StepKind::integer:
+                    in.op = Op::load;
+                    in.width = std::uint8_t(step.width);
+                    in.flags |= (step.little ? flag::little : 0) | (step.sign ? flag::sign : 0);
+                    if (!step.sign) {
+                        switch (step.width) {
+                            case 1:
+                                in.op = Op::u8;
+                                break;
+                            case 2:
+                                in.op = step.little ? Op::le16 : Op::be16;
+                                break;
+                            case 4:
+                                in.op = step.little ? Op::le32 : Op::be32;
+                                break;
+                            case 8:
+                                in.op = step.little ? Op::le64 : Op::be64;
+                                break;
+                        }
+                    }
+                    break;
+                case StepKind::varint:
+                    in.op = Op::varint;
+                    break;
+                case StepKind::leb128:
+                    in.op = Op::leb128;
+                    break;
+                case StepKind::zigzag:
+                    in.op = Op::zigzag;
+                    break;
+                default:
+                    in.op = Op::cargo;
+                    in.b = std::uint32_t(step.cargo);
+                    in.c = name(step.name);
+                    break;
+            }
+            return in;
+        }
+
+        void steps(const std::vector<Step>& list) {
+            for (size_t i = 0; i < list.size(); i++) {
+                auto& step = list[i];
+                auto next = i + 1 < list.size() ? &list[i + 1] : nullptr;
+                switch (step.kind) {
+                    case StepKind::guard: {
+                        Instr in{Op::guard};
+                        in.imm = std::int64_t(step.len);
+                        emit(in, step.where);
+                        break;
+                    }
+                    case StepKind::integer: {
+                        auto in = value(step);
+                        ExprOp cmp;
+                        std::int64_t v;
+                        if (fusable(step, next, cmp, v)) {
+                            switch (in.op) {
+                                case Op::u8:
+                                    in.op = Op::u8_check;
+                                    break;
+                                case Op::be16:
+                                    in.op = Op::be16_check;
+                                    break;
+                                case Op::be32:
+                                    in.op = Op::be32_check;
+                                    break;
+                                default:
+                                    in.op = Op::load_check;
+                                    break;
+                            }
+                            in.cmp = std::uint8_t(cmp);
+                            in.imm = v;
+                            emit(in, next->where);
+                            i++;
+                            break;
+                        }
+                        emit(in, step.where);
+                        break;
+                    }
+                    case StepKind::varint:
+                    case StepKind::leb128:
+                    case StepKind::zigzag:
+                    case StepKind::cargo:
+                        emit(value(step), step.where);
+                        break;
+                    case StepKind::bits: {
+                        Instr in{Op::bits};
+                        in.width = std::uint8_t(step.width);
+                        in.flags = step.checked ? flag::checked : 0;
+                        in.b = std::uint32_t(prog.bits.size());
+                        in.c = std::uint32_t(step.bits.size());
+                        for (auto& b : step.bits) {
+                            prog.bits.push_back({std::uint32_t(b.slot), name(b.name), std::uint8_t(b.shift), std::uint8_t(b.width)});
+                        }
+                        emit(in, step.where);
+                        break;
+                    }
+                    case StepKind::bytes:
+                    case StepKind::skip:
+                    case StepKind::back: {
+                        Instr in{step.kind == StepKind::bytes ? Op::bytes : step.kind == StepKind::skip ? Op::skip : Op::back};
+                        in.a = step.slot == npos ? 0 : std::uint32_t(step.slot);
+                        in.b = name(step.name);
+                        in.flags = step.checked ? flag::checked : 0;
+                        length(step, in);
+                        emit(in, step.where);
+                        break;
+                    }
+                    case StepKind::repeat: {
+                        Instr in{Op::array};
+                        in.a = std::uint32_t(step.slot);
+                        in.flags = step.bytes ? flag::bytes : 0;
+                        length(step, in);
+                        in.b = std::uint32_t(prog.arrays.size());
+                        // element of array has empty name
+                        auto elem = value(step.then[0]);
+                        (elem.op == Op::cargo ? elem.c : elem.b) = 0;
+                        prog.arrays.push_back({elem, name(step.name)});
+                        emit(in, step.where);
+                        break;
+                    }
+                    case StepKind::when: {
+                        auto cond = expr(step.expr, step.where);
+                        if (cond.constant) {
+                            steps(cond.v ? step.then : step.otherwise);
+                            break;
+                        }
+                        Instr jz{Op::jz};
+                        jz.a = cond.reg;
+                        auto at = prog.code.size();
+                        emit(jz, step.where);
+                        steps(step.then);
+                        if (step.otherwise.size()) {
+                            auto skip = prog.code.size();
+                            emit(Instr{Op::jmp}, step.where);
+                            prog.code[at].b = std::uint32_t(prog.code.size());
+                            steps(step.otherwise);
+                            prog.code[skip].b = std::uint32_t(prog.code.size());
+                        }
+                        else {
+                            prog.code[at].b = std::uint32_t(prog.code.size());
+                        }
+                        break;
+                    }
+                    case StepKind::check: {
+                        auto err = step.check == CheckKind::bind ? DecodeError::bind : DecodeError::test;
+                        auto cond = expr(step.expr, step.where);
+                        if (cond.constant && cond.v) {
+                            break;
+                        }
+                        Instr in{cond.constant ? Op::fail : Op::check};
+                        in.a = cond.reg;
+                        in.cmp = std::uint8_t(err);
+                        emit(in, step.where);
+                        break;
+                    }
+                    case StepKind::assign: {
+                        auto v = expr(step.expr, step.where);
+                        Instr in{v.constant ? Op::movi : Op::mov};
+                        in.a = std::uint32_t(step.slot);
+                        in.b = v.reg;
+                        in.imm = v.v;
+                        emit(in, step.where);
+                        break;
+                    }
+                    case StepKind::transfer: {
+                        Instr in{Op::transfer};
+                        in.b = std::uint32_t(step.cargo);
+                        emit(in, step.where);
+                        break;
+                    }
+                    case StepKind::transfer_switch: {
+                        auto cond = expr(step.expr, step.where);
+                        if (cond.constant) {
+                            auto to = step.cargo;
+                            for (auto& t : step.table) {
+                                if (t.first == cond.v) {
+                                    to = t.second;
+                                    break;
+                                }
+                            }
+                            if (to != npos) {
+                                Instr in{Op::transfer};
+                                in.b = std::uint32_t(to);
+                                emit(in, step.where);
+                            }
+                            break;
+                        }
+                        Instr in{Op::transfer_switch};
+                        in.a = cond.reg;
+                        in.b = std::uint32_t(prog.tables.size());
+                        in.c = std::uint32_t(step.table.size());
+                        in.imm = step.cargo == npos ? -1 : std::int64_t(step.cargo);
+                        for (auto& t : step.table) {
+                            prog.tables.push_back({t.first, std::uint32_t(t.second)});
+                        }
+                        emit(in, step.where);
+                        break;
+                    }
+                }
+            }
+        }
+
+        static Program compile(const Schema& schema) {
+            Program prog;
+            prog.schema = &schema;
+            for (auto& c : schema.cargos) {
+                prog.regs = (std::max)(prog.regs, c.frame_size);
+            }
+            Compiler comp{prog};
+            comp.name("");
+            for (auto& c : schema.cargos) {
+                CargoCode code;
+                code.entry = std::uint32_t(prog.code.size());
+                code.base = c.base;
+                code.transfers = c.transfers;
+                comp.steps(c.steps);
+                comp.emit(Instr{Op::end}, c.name);
+                prog.cargos.push_back(code);
+            }
+            prog.regs += comp.temp;
+            return prog;
+        }
+    };
+
+    // Machine runs Program with threaded dispatch (computed goto) where available
+    // and switch loop elsewhere; visitor is same as Interpreter
+    struct Machine {
+        const Program& program;
+        // regs only grows; top is end of frames in use
+        std::vector<std::int64_t> regs;
+        size_t top = 0;
+        std::string_view where;
+        size_t max_depth = 64;
+
+        Machine(const Program& p)
+            : program(p) {}
+
+        // index is position in Schema::cargos; lookup by name is avoided on hot path
+        template <class Visitor>
+        DecodeError decode(size_t index, const std::uint8_t* p, size_t n, size_t& pos, Visitor&& vis) {
+            if (index >= program.cargos.size()) {
+                return DecodeError::transfer;
+            }
+            Cursor cur{p, n, pos};
+            top = 0;
+            where = {};
+            auto err = call(index, cur, vis, Interpreter::empty_name(), 0);
+            if (err == DecodeError::none) {
+                pos = cur.pos;
+            }
+            return err;
+        }
+
+        template <class Visitor>
+        DecodeError decode(const std::string& cargo, const std::uint8_t* p, size_t n, size_t& pos, Visitor&& vis) {
+            auto found = program.schema->index.find(cargo);
+            if (found == program.schema->index.end()) {
+                return DecodeError::transfer;
+            }
+            return decode(found->second, p, n, pos, vis);
+        }
+
+        template <class Visitor>
+        DecodeError decode(const std::string& cargo, const std::uint8_t* p, size_t n, Visitor&& vis) {
+            size_t pos = 0;
+            return decode(cargo, p, n, pos, vis);
+        }
+
+        static bool compare(std::uint8_t op, std::int64_t l, std::int64_t r) {
+            switch (ExprOp(op)) {
+                case ExprOp::eq:
+                    return l == r;
+                case ExprOp::lt:
+                    return l < r;
+                case ExprOp::gt:
+                    return l > r;
+                case ExprOp::le:
+                    return l <= r;
+                default:
+                    return l >= r;
+            }
+        }
+
+        DecodeError fail(const Instr* ip, DecodeError err) {
+            where = program.names[program.where[ip - program.code.data()]];
+            return err;
+        }
+
+        template <class Visitor>
+        DecodeError element(const Instr& in, Cursor& cur, Visitor& vis, size_t depth, std::int64_t& v) {
+            auto rest = cur.n - cur.pos;
+            switch (in.op) {
+                case Op::cargo:
+                    v = 0;
+                    return call(in.b, cur, vis, program.names[in.c], depth + 1);
+                case Op::varint: {
+                    if (rest < 1) {
+                        return DecodeError::short_input;
+                    }
+                    size_t len = size_t(1) << (cur.p[cur.pos] >> 6);
+                    if (rest < len) {
+                        return DecodeError::short_input;
+                    }
+                    v = std::int64_t(Interpreter::load(cur.p + cur.pos, len, false) & (~std::uint64_t(0) >> (66 - len * 8)));
+                    cur.pos += len;
+                    break;
+                }
+                case Op::leb128:
+                case Op::zigzag: {
+                    std::uint64_t u = 0;
+                    size_t i = 0;
+                    for (;; i++) {
+                        if (i == rest) {
+                            return DecodeError::short_input;
+                        }
+                        if (i == 10) {
+                            return DecodeError::overflow;
+                        }
+                        auto b = cur.p[cur.pos + i];
+                        u |= std::uint64_t(b & 0x7f) << (7 * i);
+                        if (!(b & 0x80)) {
+                            break;
+                        }
+                    }
+                    cur.pos += i + 1;
+                    v = in.op == Op::zigzag ? std::int64_t(u >> 1) ^ -std::int64_t(u & 1) : std::int64_t(u);
+                    break;
+                }
+                default: {
+                    if (rest < in.width) {
+                        return DecodeError::short_input;
+                    }
+                    auto u = Interpreter::load(cur.p + cur.pos, in.width, in.flags & flag::little);
+                    if ((in.flags & flag::sign) && in.width < 8) {
+                        auto shift = 64 - in.width * 8;
+                        u = std::uint64_t(std::int64_t(u << shift) >> shift);
+                    }
+                    cur.pos += in.width;
+                    v = std::int64_t(u);
+                    break;
+                }
+            }
+            vis.number(program.names[in.b], v);
+            return DecodeError::none;
+        }
+
+        template <class Visitor>
+        DecodeError array(const Instr* ip, size_t len, Cursor& cur, Visitor& vis, size_t frame, size_t depth) {
+            auto& arr = program.arrays[ip->b];
+            vis.begin_array(program.names[arr.name]);
+            size_t count = 0;
+            std::int64_t unused;
+            if (ip->flags & flag::bytes) {
+                if (cur.n - cur.pos < len) {
+                    return fail(ip, DecodeError::short_input);
+                }
+                Cursor sub{cur.p, cur.pos + len, cur.pos};
+                while (sub.pos < sub.n) {
+                    auto prev = sub.pos;
+                    if (auto err = element(arr.elem, sub, vis, depth, unused); err != DecodeError::none) {
+                        return fail(ip, err == DecodeError::short_input ? DecodeError::length : err);
+                    }
+                    // element which takes no byte would repeat forever
+                    if (sub.pos == prev) {
+                        return fail(ip, DecodeError::length);
+                    }
+                    count++;
+                }
+                cur.pos = sub.pos;
+            }
+            else {
+                for (; count < len; count++) {
+                    auto prev = cur.pos;
+                    if (auto err = element(arr.elem, cur, vis, depth, unused); err != DecodeError::none) {
+                        return where.empty() ? fail(ip, err) : err;
+                    }
+                    if (cur.pos == prev && len > cur.n - cur.pos) {
+                        return fail(ip, DecodeError::length);
+                    }
+                }
+            }
+            regs[frame + ip->a] = std::int64_t(count);
+            vis.end_array();
+            return DecodeError::none;
+        }
+
+        template <class Visitor>
+        DecodeError exec(std::uint32_t entry, Cursor& cur, Visitor& vis, size_t frame, size_t depth, size_t& next) {
+            auto ip = program.code.data() + entry;
+            auto p = cur.p;
+            auto n = cur.n;
+            auto pos = cur.pos;
+            auto r = regs.data() + frame;
+            auto& names = program.names;
+            DecodeError err = DecodeError::none;
+            std::uint64_t u;
+            size_t len;
+            // fast load checks bounds unless preceding guard did
+#define BINRED_NEED(w)                                        \
+    if (!(ip->flags & flag::checked) && n - pos < (w)) {      \
+        return fail(ip, DecodeError::short_input);            \
+    }
+#ifdef BINRED_THREADED_DISPATCH
+            // order must follow Op
+            static void* const labels[] = {
+                &&op_end, &&op_jmp, &&op_jz, &&op_fail, &&op_transfer, &&op_transfer_switch, &&op_guard,
+                &&op_load, &&op_u8, &&op_be16, &&op_le16, &&op_be32, &&op_le32, &&op_be64, &&op_le64,
+                &&op_load_check, &&op_u8_check, &&op_be16_check, &&op_be32_check,
+                &&op_bits, &&op_varint, &&op_leb128, &&op_zigzag, &&op_bytes, &&op_skip, &&op_back,
+                &&op_cargo, &&op_array, &&op_check, &&op_movi, &&op_mov,
+                &&op_add, &&op_sub, &&op_mul, &&op_div, &&op_mod, &&op_and_, &&op_or_, &&op_xor_,
+                &&op_eq, &&op_lt, &&op_gt, &&op_le, &&op_ge,
+                &&op_addi, &&op_subi, &&op_muli, &&op_divi, &&op_modi, &&op_andi, &&op_ori, &&op_xori,
+                &&op_eqi, &&op_lti, &&op_gti, &&op_lei, &&op_gei,
+            };
+            static_assert(sizeof(labels) / sizeof(labels[0]) == size_t(Op::count_));
+#define BINRED_CASE(x) op_##x:
+#define BINRED_NEXT goto* labels[size_t(ip->op)]
+            BINRED_NEXT;
+#else
+#define BINRED_CASE(x) case Op::x:
+#define BINRED_NEXT continue
+            for (;;) {
+                switch (ip->op) {
+#endif
+            BINRED_CASE(end)
+                cur.pos = pos;
+                return DecodeError::none;
+            BINRED_CASE(jmp)
+                ip = program.code.data() + ip->b;
+                BINRED_NEXT;
+            BINRED_CASE(jz)
+                ip = r[ip->a] ? ip + 1 : program.code.data() + ip->b;
+                BINRED_NEXT;
+            BINRED_CASE(fail)
+                return fail(ip, DecodeError(ip->cmp));
+            BINRED_CASE(transfer)
+                next = ip->b;
+                cur.pos = pos;
+                return DecodeError::none;
+            BINRED_CASE(transfer_switch) {
+                auto begin = program.tables.data() + ip->b, end = begin + ip->c;
+                auto v = r[ip->a];
+                auto found = std::lower_bound(begin, end, v, [](auto& e, std::int64_t v) {
+                    return e.first < v;
+                });
+                next = found != end && found->first == v ? size_t(found->second) : size_t(ip->imm);
+                if (next != npos) {
+                    cur.pos = pos;
+                    return DecodeError::none;
+                }
+                ip++;
+                BINRED_NEXT;
+            }
+            BINRED_CASE(guard)
+                if (n - pos < size_t(ip->imm)) {
+                    return fail(ip, DecodeError::short_input);
+                }
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(load)
+                if (n - pos < ip->width) {
+                    return fail(ip, DecodeError::short_input);
+                }
+                u = Interpreter::load(p + pos, ip->width, ip->flags & flag::little);
+                if ((ip->flags & flag::sign) && ip->width < 8) {
+                    auto shift = 64 - ip->width * 8;
+                    u = std::uint64_t(std::int64_t(u << shift) >> shift);
+                }
+                pos += ip->width;
+                goto store;
+            BINRED_CASE(u8)
+                BINRED_NEED(1);
+                u = p[pos];
+                pos += 1;
+                goto store;
+            BINRED_CASE(be16)
+                BINRED_NEED(2);
+                u = (std::uint64_t(p[pos]) << 8) | p[pos + 1];
+                pos += 2;
+                goto store;
+            BINRED_CASE(le16)
+                BINRED_NEED(2);
+                u = std::uint64_t(p[pos]) | (std::uint64_t(p[pos + 1]) << 8);
+                pos += 2;
+                goto store;
+            BINRED_CASE(be32)
+                BINRED_NEED(4);
+                u = (std::uint64_t(p[pos]) << 24) | (std::uint64_t(p[pos + 1]) << 16) | (std::uint64_t(p[pos + 2]) << 8) | p[pos + 3];
+                pos += 4;
+                goto store;
+            BINRED_CASE(le32)
+                BINRED_NEED(4);
+                u = std::uint64_t(p[pos]) | (std::uint64_t(p[pos + 1]) << 8) | (std::uint64_t(p[pos + 2]) << 16) | (std::uint64_t(p[pos + 3]) << 24);
+                pos += 4;
+                goto store;
+            BINRED_CASE(be64)
+                BINRED_NEED(8);
+                u = Interpreter::load(p + pos, 8, false);
+                pos += 8;
+                goto store;
+            BINRED_CASE(le64)
+                BINRED_NEED(8);
+                u = Interpreter::load(p + pos, 8, true);
+                pos += 8;
+                goto store;
+            store:
+                r[ip->a] = std::int64_t(u);
+                vis.number(names[ip->b], std::int64_t(u));
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(load_check)
+                if (!(ip->flags & flag::checked) && n - pos < ip->width) {
+                    return fail(ip, DecodeError::short_input);
+                }
+                u = Interpreter::load(p + pos, ip->width, ip->flags & flag::little);
+                if ((ip->flags & flag::sign) && ip->width < 8) {
+                    auto shift = 64 - ip->width * 8;
+                    u = std::uint64_t(std::int64_t(u << shift) >> shift);
+                }
+                pos += ip->width;
+                goto store_check;
+            BINRED_CASE(u8_check)
+                BINRED_NEED(1);
+                u = p[pos];
+                pos += 1;
+                goto store_check;
+            BINRED_CASE(be16_check)
+                BINRED_NEED(2);
+                u = (std::uint64_t(p[pos]) << 8) | p[pos + 1];
+                pos += 2;
+                goto store_check;
+            BINRED_CASE(be32_check)
+                BINRED_NEED(4);
+                u = (std::uint64_t(p[pos]) << 24) | (std::uint64_t(p[pos + 1]) << 16) | (std::uint64_t(p[pos + 2]) << 8) | p[pos + 3];
+                pos += 4;
+                goto store_check;
+            store_check:
+                r[ip->a] = std::int64_t(u);
+                vis.number(names[ip->b], std::int64_t(u));
+                if (!compare(ip->cmp, std::int64_t(u), ip->imm)) {
+                    return fail(ip, DecodeError::bind);
+                }
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(bits) {
+                if (!(ip->flags & flag::checked) && n - pos < ip->width) {
+                    return fail(ip, DecodeError::short_input);
+                }
+                u = Interpreter::load(p + pos, ip->width, false);
+                pos += ip->width;
+                auto b = program.bits.data() + ip->b;
+                for (auto e = b + ip->c; b != e; b++) {
+                    auto v = std::int64_t((u >> b->shift) & (b->width == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << b->width) - 1));
+                    r[b->reg] = v;
+                    vis.number(names[b->name], v);
+                }
+                ip++;
+                BINRED_NEXT;
+            }
+            BINRED_CASE(varint)
+            BINRED_CASE(leb128)
+            BINRED_CASE(zigzag) {
+                std::int64_t v;
+                cur.pos = pos;
+                if (err = element(*ip, cur, vis, depth, v); err != DecodeError::none) {
+                    return fail(ip, err);
+                }
+                pos = cur.pos;
+                r[ip->a] = v;
+                ip++;
+                BINRED_NEXT;
+            }
+            BINRED_CASE(bytes)
+                len = ip->flags & flag::fixed ? size_t(ip->imm) : size_t(r[ip->c]);
+                if (!(ip->flags & flag::checked) && n - pos < len) {
+                    return fail(ip, DecodeError::short_input);
+                }
+                vis.bytes(names[ip->b], p + pos, len);
+                r[ip->a] = std::int64_t(len);
+                pos += len;
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(skip)
+                len = ip->flags & flag::fixed ? size_t(ip->imm) : size_t(r[ip->c]);
+                if (!(ip->flags & flag::checked) && n - pos < len) {
+                    return fail(ip, DecodeError::short_input);
+                }
+                pos += len;
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(back)
+                len = ip->flags & flag::fixed ? size_t(ip->imm) : size_t(r[ip->c]);
+                if (pos < len) {
+                    return fail(ip, DecodeError::read_push);
+                }
+                pos -= len;
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(cargo)
+                cur.pos = pos;
+                if (err = call(ip->b, cur, vis, names[ip->c], depth + 1); err != DecodeError::none) {
+                    return err;
+                }
+                pos = cur.pos;
+                r = regs.data() + frame;
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(array)
+                len = ip->flags & flag::fixed ? size_t(ip->imm) : size_t(r[ip->c]);
+                cur.pos = pos;
+                if (err = array(ip, len, cur, vis, frame, depth); err != DecodeError::none) {
+                    return err;
+                }
+                pos = cur.pos;
+                r = regs.data() + frame;
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(check)
+                if (!r[ip->a]) {
+                    return fail(ip, DecodeError(ip->cmp));
+                }
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(movi)
+                r[ip->a] = ip->imm;
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(mov)
+                r[ip->a] = r[ip->b];
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(add)
+                r[ip->a] = std::int64_t(std::uint64_t(r[ip->b]) + std::uint64_t(r[ip->c]));
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(sub)
+                r[ip->a] = std::int64_t(std::uint64_t(r[ip->b]) - std::uint64_t(r[ip->c]));
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(mul)
+                r[ip->a] = std::int64_t(std::uint64_t(r[ip->b]) * std::uint64_t(r[ip->c]));
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(div)
+                if (r[ip->c] == 0 || (r[ip->c] == -1 && r[ip->b] == INT64_MIN)) {
+                    return fail(ip, DecodeError::expr);
+                }
+                r[ip->a] = r[ip->b] / r[ip->c];
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(mod)
+                if (r[ip->c] == 0 || (r[ip->c] == -1 && r[ip->b] == INT64_MIN)) {
+                    return fail(ip, DecodeError::expr);
+                }
+                r[ip->a] = r[ip->b] % r[ip->c];
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(and_)
+                r[ip->a] = r[ip->b] & r[ip->c];
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(or_)
+                r[ip->a] = r[ip->b] | r[ip->c];
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(xor_)
+                r[ip->a] = r[ip->b] ^ r[ip->c];
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(eq)
+                r[ip->a] = r[ip->b] == r[ip->c];
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(lt)
+                r[ip->a] = r[ip->b] < r[ip->c];
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(gt)
+                r[ip->a] = r[ip->b] > r[ip->c];
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(le)
+                r[ip->a] = r[ip->b] <= r[ip->c];
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(ge)
+                r[ip->a] = r[ip->b] >= r[ip->c];
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(addi)
+                r[ip->a] = std::int64_t(std::uint64_t(r[ip->b]) + std::uint64_t(ip->imm));
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(subi)
+                r[ip->a] = std::int64_t(std::uint64_t(r[ip->b]) - std::uint64_t(ip->imm));
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(muli)
+                r[ip->a] = std::int64_t(std::uint64_t(r[ip->b]) * std::uint64_t(ip->imm));
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(divi)
+                if (ip->imm == 0 || (ip->imm == -1 && r[ip->b] == INT64_MIN)) {
+                    return fail(ip, DecodeError::expr);
+                }
+                r[ip->a] = r[ip->b] / ip->imm;
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(modi)
+                if (ip->imm == 0 || (ip->imm == -1 && r[ip->b] == INT64_MIN)) {
+                    return fail(ip, DecodeError::expr);
+                }
+                r[ip->a] = r[ip->b] % ip->imm;
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(andi)
+                r[ip->a] = r[ip->b] & ip->imm;
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(ori)
+                r[ip->a] = r[ip->b] | ip->imm;
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(xori)
+                r[ip->a] = r[ip->b] ^ ip->imm;
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(eqi)
+                r[ip->a] = r[ip->b] == ip->imm;
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(lti)
+                r[ip->a] = r[ip->b] < ip->imm;
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(gti)
+                r[ip->a] = r[ip->b] > ip->imm;
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(lei)
+                r[ip->a] = r[ip->b] <= ip->imm;
+                ip++;
+                BINRED_NEXT;
+            BINRED_CASE(gei)
+                r[ip->a] = r[ip->b] >= ip->imm;
+                ip++;
+                BINRED_NEXT;
+#ifndef BINRED_THREADED_DISPATCH
+                    default:
+                        return fail(ip, DecodeError::expr);
+                }
+            }
+#endif
+#undef BINRED_NEED
+#undef BINRED_CASE
+#undef BINRED_NEXT
+        }
+
+        // call runs base chain and transfers in one register frame like Interpreter::decode_cargo
+        template <class Visitor>
+        DecodeError call(size_t index, Cursor& cur, Visitor& vis, const std::string& name, size_t depth) {
+            if (depth > max_depth) {
+                return DecodeError::depth;
+            }
+            auto& schema = *program.schema;
+            size_t chain[64], count = 0;
+            for (auto i = index; i != npos; i = program.cargos[i].base) {
+                if (count == 64) {
+                    return DecodeError::depth;
+                }
+                chain[count++] = i;
+            }
+            auto frame = top;
+            top += program.regs;
+            if (regs.size() < top) {
+                regs.resize(top);
+            }
+            std::fill_n(regs.data() + frame, program.regs, 0);
+            vis.begin_cargo(name, schema.cargos[index]);
+            for (size_t i = count; i > 0; i--) {
+                auto& c = program.cargos[chain[i - 1]];
+                size_t next = npos;
+                if (auto err = exec(c.entry, cur, vis, frame, depth, next); err != DecodeError::none) {
+                    return err;
+                }
+                if (i > 1) {
+                    if (c.transfers && next != chain[i - 2]) {
+                        where = schema.cargos[chain[i - 1]].name;
+                        return DecodeError::transfer;
+                    }
+                    continue;
+                }
+                auto current = index;
+                while (next != npos) {
+                    if (program.cargos[next].base != current) {
+                        where = schema.cargos[current].name;
+                        return DecodeError::transfer;
+                    }
+                    current = next;
+                    vis.transfer(schema.cargos[current]);
+                    next = npos;
+                    if (auto err = exec(program.cargos[current].entry, cur, vis, frame, depth, next); err != DecodeError::none) {
+                        return err;
+                    }
+                }
+            }
+            top = frame;
+            vis.end_cargo();
+            return DecodeError::none;
+        }
+    };
+
+    // Discard is visitor for validation only
+    struct Discard {
+        void number(const std::string&, std::int64_t) {}
+        void bytes(const std::string&, const std::uint8_t*, size_t) {}
+        void begin_cargo(const std::string&, const CargoPlan&) {}
+        void end_cargo() {}
+        void begin_array(const std::string&) {}
+        void end_array() {}
+        void transfer(const CargoPlan&) {}
+    };
+}  // namespace binred::interpret
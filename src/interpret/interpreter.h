@@ -0,0 +1,603 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#pragma once
+
+#include "plan.h"
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace binred::interpret {
+    enum class DecodeError {
+        none,
+        short_input,
+        bind,
+        test,
+        length,
+        overflow,
+        transfer,
+        read_push,
+        expr,
+        depth,
+    };
+
+    const char* error_name(DecodeError err) {
+        switch (err) {
+            case DecodeError::none:
+                return "none";
+            case DecodeError::short_input:
+                return "short input";
+            case DecodeError::bind:
+                return "bind constraint failed";
+            case DecodeError::test:
+                return "test failed";
+            case DecodeError::length:
+                return "invalid length";
+            case DecodeError::overflow:
+                return "value overflow";
+            case DecodeError::transfer:
+                return "no cargo to transfer";
+            case DecodeError::read_push:
+                return "push in read command";
+            case DecodeError::expr:
+                return "expression can't be evaluated";
+            case DecodeError::depth:
+                return "nesting too deep";
+        }
+        return "unknown";
+    }
+
+    struct Cursor {
+        const std::uint8_t* p;
+        size_t n;
+        size_t pos;
+    };
+
+    // Interpreter decodes buffer by Schema and reports values to visitor
+    // visitor has number(name, v), bytes(name, p, len), begin_cargo(name, plan), end_cargo(),
+    // begin_array(name), end_array() and transfer(plan); element of array has empty name
+    // byte payload is reported as pointer into input
+    // one Interpreter is reused for many messages so that slot frames are not allocated again
+    struct Interpreter {
+        const Schema& schema;
+        std::vector<std::int64_t> frames;
+        std::string_view where;
+        size_t max_depth = 64;
+
+        Interpreter(const Schema& s)
+            : schema(s) {}
+
+        template <class Visitor>
+        DecodeError decode(const std::string& cargo, const std::uint8_t* p, size_t n, size_t& pos, Visitor&& vis) {
+            auto found = schema.index.find(cargo);
+            if (found == schema.index.end()) {
+                return DecodeError::transfer;
+            }
+            Cursor cur{p, n, pos};
+            frames.clear();
+            where = {};
+            auto err = decode_cargo(found->second, cur, vis, empty_name(), 0);
+            if (err == DecodeError::none) {
+                pos = cur.pos;
+            }
+            return err;
+        }
+
+        template <class Visitor>
+        DecodeError decode(const std::string& cargo, const std::uint8_t* p, size_t n, Visitor&& vis) {
+            size_t pos = 0;
+            return decode(cargo, p, n, pos, vis);
+        }
+
+        static const std::string& empty_name() {
+            static const std::string empty;
+            return empty;
+        }
+
+        static bool eval(const ExprProgram& prog, const std::int64_t* frame, std::int64_t& out) {
+            std::int64_t st[ExprProgram::max_depth];
+            size_t sp = 0;
+            for (auto& c : prog.code) {
+                switch (c.op) {
+                    case ExprOp::constant:
+                        st[sp++] = c.v;
+                        continue;
+                    case ExprOp::slot:
+                        st[sp++] = frame[c.v];
+                        continue;
+                    default:
+                        break;
+                }
+                auto r = st[--sp];
+                auto& l = st[sp - 1];
+                switch (c.op) {
+                    case ExprOp::add:
+                        l = std::int64_t(std::uint64_t(l) + std::uint64_t(r));
+                        break;
+                    case ExprOp::sub:
+                        l = std::int64_t(std::uint64_t(l) - std::uint64_t(r));
+                        break;
+                    case ExprOp::mul:
+                        l = std::int64_t(std::uint64_t(l) * std::uint64_t(r));
+                        break;
+                    case ExprOp::div:
+                    case ExprOp::mod:
+                        if (r == 0 || (r == -1 && l == INT64_MIN)) {
+                            return false;
+                        }
+                        l = c.op == ExprOp::div ? l / r : l % r;
+                        break;
+                    case ExprOp::and_:
+                        l &= r;
+                        break;
+                    case ExprOp::or_:
+                        l |= r;
+                        break;
+                    case ExprOp::xor_:
+                        l ^= r;
+                        break;
+                    case ExprOp::eq:
+                        l = l == r;
+                        break;
+                    case ExprOp::lt:
+                        l = l < r;
+                        break;
+                    case ExprOp::gt:
+                        l = l > r;
+                        break;
+                    case ExprOp::le:
+                        l = l <= r;
+                        break;
+                    case ExprOp::ge:
+                        l = l >= r;
+                        break;
+                    default:
+                        return false;
+                }
+            }
+            out = st[0];
+            return true;
+        }
+
+        DecodeError fail(const Step& step, DecodeError err) {
+            where = step.where;
+            return err;
+        }
+
+        DecodeError length(const Step& step, size_t frame, size_t& len) {
+            if (step.len != npos) {
+                len = step.len;
+                return DecodeError::none;
+            }
+            std::int64_t v;
+            if (!eval(step.expr, frames.data() + frame, v)) {
+                return fail(step, DecodeError::expr);
+            }
+            len = size_t(v);
+            return DecodeError::none;
+        }
+
+        static std::uint64_t load(const std::uint8_t* p, size_t width, bool little) {
+            std::uint64_t v = 0;
+            if (little) {
+                for (size_t i = width; i > 0; i--) {
+                    v = (v << 8) | p[i - 1];
+                }
+            }
+            else {
+                for (size_t i = 0; i < width; i++) {
+                    v = (v << 8) | p[i];
+                }
+            }
+            return v;
+        }
+
+        // value decodes one scalar or nested cargo, store receives numeric value
+        template <class Visitor>
+        DecodeError value(const Step& step, Cursor& cur, Visitor& vis, const std::string& name, size_t depth, std::int64_t& store) {
+            auto rest = cur.n - cur.pos;
+            switch (step.kind) {
+                case StepKind::integer: {
+                    if (!step.checked && rest < step.width) {
+                        return fail(step, DecodeError::short_input);
+                    }
+                    auto v = load(cur.p + cur.pos, step.width, step.little);
+                    if (step.sign && step.width < 8) {
+                        auto shift = 64 - step.width * 8;
+                        v = std::uint64_t(std::int64_t(v << shift) >> shift);
+                    }
+                    cur.pos += step.width;
+                    store = std::int64_t(v);
+                    vis.number(name, store);
+                    return DecodeError::none;
+                }
+                case StepKind::varint: {
+                    if (rest < 1) {
+                        return fail(step, DecodeError::short_input);
+                    }
+                    size_t len = size_t(1) << (cur.p[cur.pos] >> 6);
+                    if (rest < len) {
+                        return fail(step, DecodeError::short_input);
+                    }
+                    auto v = load(cur.p + cur.pos, len, false) & (~std::uint64_t(0) >> (66 - len * 8));
+                    cur.pos += len;
+                    store = std::int64_t(v);
+                    vis.number(name, store);
+                    return DecodeError::none;
+                }
+                case StepKind::leb128:
+                case StepKind::zigzag: {
+                    std::uint64_t v = 0;
+                    size_t i = 0;
+                    for (;; i++) {
+                        if (i == rest) {
+                            return fail(step, DecodeError::short_input);
+                        }
+                        if (i == 10) {
+                            return fail(step, DecodeError::overflow);
+                        }
+                        auto b = cur.p[cur.pos + i];
+                        v |= std::uint64_t(b & 0x7f) << (7 * i);
+                        if (!(b & 0x80)) {
+                            break;
+                        }
+                    }
+                    cur.pos += i + 1;
+                    store = step.kind == StepKind::zigzag ? std::int64_t(v >> 1) ^ -std::int64_t(v & 1) : std::int64_t(v);
+                    vis.number(name, store);
+                    return DecodeError::none;
+                }
+                case StepKind::cargo:
+                    store = 0;
+                    return decode_cargo(step.cargo, cur, vis, name, depth + 1);
+                default:
+                    return fail(step, DecodeError::expr);
+            }
+        }
+
+        template <class Visitor>
+        DecodeError repeat(const Step& step, Cursor& cur, Visitor& vis, size_t frame, size_t depth) {
+            size_t len;
+            if (auto err = length(step, frame, len); err != DecodeError::none) {
+                return err;
+            }
+            auto& elem = step.then[0];
+            std::int64_t unused;
+            vis.begin_array(step.name);
+            if (step.bytes) {
+                if (cur.n - cur.pos < len) {
+                    return fail(step, DecodeError::short_input);
+                }
+                // elements must fill len bytes exactly
+                Cursor sub{cur.p, cur.pos + len, cur.pos};
+                size_t count = 0;
+                while (sub.pos < sub.n) {
+                    auto prev = sub.pos;
+                    if (auto err = value(elem, sub, vis, empty_name(), depth, unused); err != DecodeError::none) {
+                        return err == DecodeError::short_input ? fail(step, DecodeError::length) : err;
+                    }
+                    // element which takes no byte would repeat forever
+                    if (sub.pos == prev) {
+                        return fail(step, DecodeError::length);
+                    }
+                    count++;
+                }
+                cur.pos = sub.pos;
+                frames[frame + step.slot] = std::int64_t(count);
+            }
+            else {
+                // count is untrusted, so nothing is reserved and empty element stops the loop
+                for (size_t i = 0; i < len; i++) {
+                    auto prev = cur.pos;
+                    if (auto err = value(elem, cur, vis, empty_name(), depth, unused); err != DecodeError::none) {
+                        return err;
+                    }
+                    if (cur.pos == prev && len > cur.n - cur.pos) {
+                        return fail(step, DecodeError::length);
+                    }
+                }
+                frames[frame + step.slot] = std::int64_t(len);
+            }
+            vis.end_array();
+            return DecodeError::none;
+        }
+
+        // run executes steps, next receives transfer target
+        template <class Visitor>
+        DecodeError run(const std::vector<Step>& steps, Cursor& cur, Visitor& vis, size_t frame, size_t depth, size_t& next) {
+            for (auto& step : steps) {
+                switch (step.kind) {
+                    case StepKind::guard:
+                        if (cur.n - cur.pos < step.len) {
+                            return fail(step, DecodeError::short_input);
+                        }
+                        break;
+                    case StepKind::bits: {
+                        if (!step.checked && cur.n - cur.pos < step.width) {
+                            return fail(step, DecodeError::short_input);
+                        }
+                        auto v = load(cur.p + cur.pos, step.width, false);
+                        for (auto& b : step.bits) {
+                            auto field = std::int64_t((v >> b.shift) & (b.width == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << b.width) - 1));
+                            frames[frame + b.slot] = field;
+                            vis.number(b.name, field);
+                        }
+                        cur.pos += step.width;
+                        break;
+                    }
+                    case StepKind::bytes: {
+                        size_t len;
+                        if (auto err = length(step, frame, len); err != DecodeError::none) {
+                            return err;
+                        }
+                        if (!step.checked && cur.n - cur.pos < len) {
+                            return fail(step, DecodeError::short_input);
+                        }
+                        vis.bytes(step.name, cur.p + cur.pos, len);
+                        frames[frame + step.slot] = std::int64_t(len);
+                        cur.pos += len;
+                        break;
+                    }
+                    case StepKind::repeat:
+                        if (auto err = repeat(step, cur, vis, frame, depth); err != DecodeError::none) {
+                            return err;
+                        }
+                        break;
+                    case StepKind::when: {
+                        std::int64_t cond;
+                        if (!eval(step.expr, frames.data() + frame, cond)) {
+                            return fail(step, DecodeError::expr);
+                        }
+                        if (auto err = run(cond ? step.then : step.otherwise, cur, vis, frame, depth, next); err != DecodeError::none) {
+                            return err;
+                        }
+                        if (next != npos) {
+                            return DecodeError::none;
+                        }
+                        break;
+                    }
+                    case StepKind::check: {
+                        std::int64_t ok;
+                        if (!eval(step.expr, frames.data() + frame, ok)) {
+                            return fail(step, DecodeError::expr);
+                        }
+                        if (!ok) {
+                            return fail(step, step.check == CheckKind::bind ? DecodeError::bind : DecodeError::test);
+                        }
+                        break;
+                    }
+                    case StepKind::skip: {
+                        size_t len;
+                        if (auto err = length(step, frame, len); err != DecodeError::none) {
+                            return err;
+                        }
+                        if (!step.checked && cur.n - cur.pos < len) {
+                            return fail(step, DecodeError::short_input);
+                        }
+                        cur.pos += len;
+                        break;
+                    }
+                    case StepKind::back: {
+                        size_t len;
+                        if (auto err = length(step, frame, len); err != DecodeError::none) {
+                            return err;
+                        }
+                        if (cur.pos < len) {
+                            return fail(step, DecodeError::read_push);
+                        }
+                        cur.pos -= len;
+                        break;
+                    }
+                    case StepKind::assign: {
+                        std::int64_t v;
+                        if (!eval(step.expr, frames.data() + frame, v)) {
+                            return fail(step, DecodeError::expr);
+                        }
+                        frames[frame + step.slot] = v;
+                        break;
+                    }
+                    case StepKind::transfer:
+                        next = step.cargo;
+                        return DecodeError::none;
+                    case StepKind::transfer_switch: {
+                        std::int64_t v;
+                        if (!eval(step.expr, frames.data() + frame, v)) {
+                            return fail(step, DecodeError::expr);
+                        }
+                        auto found = std::lower_bound(step.table.begin(), step.table.end(), v, [](auto& e, std::int64_t v) {
+                            return e.first < v;
+                        });
+                        next = found != step.table.end() && found->first == v ? found->second : step.cargo;
+                        if (next != npos) {
+                            return DecodeError::none;
+                        }
+                        break;
+                    }
+                    default: {
+                        std::int64_t v;
+                        if (auto err = value(step, cur, vis, step.name, depth, v); err != DecodeError::none) {
+                            return err;
+                        }
+                        if (step.slot != npos) {
+                            frames[frame + step.slot] = v;
+                        }
+                        break;
+                    }
+                }
+            }
+            return DecodeError::none;
+        }
+
+        // decode_cargo runs base cargo first in same frame
+        // transfer of base must select this cargo, and transfer of this cargo continues into derived cargo
+        template <class Visitor>
+        DecodeError decode_cargo(size_t index, Cursor& cur, Visitor& vis, const std::string& name, size_t depth) {
+            if (depth > max_depth) {
+                return DecodeError::depth;
+            }
+            auto* plan = &schema.cargos[index];
+            size_t chain[64], count = 0;
+            for (auto i = index; i != npos; i = schema.cargos[i].base) {
+                if (count == 64) {
+                    return DecodeError::depth;
+                }
+                chain[count++] = i;
+            }
+            auto frame = frames.size();
+            frames.resize(frame + plan->frame_size);
+            vis.begin_cargo(name, *plan);
+            for (size_t i = count; i > 0; i--) {
+                auto& p = schema.cargos[chain[i - 1]];
+                size_t next = npos;
+                if (auto err = run(p.steps, cur, vis, frame, depth, next); err != DecodeError::none) {
+                    return err;
+                }
+                if (i > 1) {
+                    if (p.transfers && next != chain[i - 2]) {
+                        where = p.name;
+                        return DecodeError::transfer;
+                    }
+                    continue;
+                }
+                while (next != npos) {
+                    // transfer target continues in frame of current cargo
+                    if (schema.cargos[next].base != size_t(plan - schema.cargos.data())) {
+                        where = plan->name;
+                        return DecodeError::transfer;
+                    }
+                    plan = &schema.cargos[next];
+                    frames.resize(frame + plan->frame_size);
+                    vis.transfer(*plan);
+                    next = npos;
+                    if (auto err = run(plan->steps, cur, vis, frame, depth, next); err != DecodeError::none) {
+                        return err;
+                    }
+                }
+            }
+            frames.resize(frame);
+            vis.end_cargo();
+            return DecodeError::none;
+        }
+    };
+
+    // Node is field tree built by TreeBuilder
+    // name points into Schema and bytes into decoded input
+    struct Node {
+        enum class Kind : std::uint8_t {
+            number,
+            bytes,
+            cargo,
+            array,
+        };
+        Kind kind = Kind::cargo;
+        std::string_view name;
+        std::int64_t number = 0;
+        std::string_view bytes;
+        const CargoPlan* cargo = nullptr;
+        std::vector<Node> children;
+
+        const Node* find(std::string_view key) const {
+            for (auto& c : children) {
+                if (c.name == key) {
+                    return &c;
+                }
+            }
+            return nullptr;
+        }
+    };
+
+    struct TreeBuilder {
+        Node root;
+        std::vector<Node*> stack;
+
+        // reset must be called before reuse after failed decode
+        void reset() {
+            root = Node{};
+            stack.clear();
+        }
+
+        Node& add(const std::string& name, Node::Kind kind) {
+            auto& c = stack.back()->children.emplace_back();
+            c.kind = kind;
+            c.name = name;
+            return c;
+        }
+
+        void number(const std::string& name, std::int64_t v) {
+            add(name, Node::Kind::number).number = v;
+        }
+
+        void bytes(const std::string& name, const std::uint8_t* p, size_t len) {
+            add(name, Node::Kind::bytes).bytes = std::string_view(reinterpret_cast<const char*>(p), len);
+        }
+
+        void begin_cargo(const std::string& name, const CargoPlan& plan) {
+            if (stack.empty()) {
+                root = Node{};
+                root.cargo = &plan;
+                stack.push_back(&root);
+                return;
+            }
+            auto& c = add(name, Node::Kind::cargo);
+            c.cargo = &plan;
+            stack.push_back(&c);
+        }
+
+        void end_cargo() {
+            stack.pop_back();
+        }
+
+        void begin_array(const std::string& name) {
+            stack.push_back(&add(name, Node::Kind::array));
+        }
+
+        void end_array() {
+            stack.pop_back();
+        }
+
+        void transfer(const CargoPlan& plan) {
+            stack.back()->cargo = &plan;
+        }
+    };
+
+    // write_tree writes Node as indented text; byte payload is written in hex
+    void write_tree(std::string& out, const Node& node, size_t depth = 0) {
+        out.append(depth * 4, ' ');
+        if (node.name.size()) {
+            out.append(node.name);
+            out += ": ";
+        }
+        switch (node.kind) {
+            case Node::Kind::number:
+                out += std::to_string(node.number) + "\n";
+                return;
+            case Node::Kind::bytes: {
+                constexpr const char* digits = "0123456789abcdef";
+                out += "<";
+                for (auto c : node.bytes) {
+                    out += digits[std::uint8_t(c) >> 4];
+                    out += digits[std::uint8_t(c) & 0xf];
+                }
+                out += ">\n";
+                return;
+            }
+            case Node::Kind::cargo:
+                out += (node.cargo ? node.cargo->name : std::string()) + " {\n";
+                break;
+            case Node::Kind::array:
+                out += "[\n";
+                break;
+        }
+        for (auto& c : node.children) {
+            write_tree(out, c, depth + 1);
+        }
+        out.append(depth * 4, ' ');
+        out += node.kind == Node::Kind::array ? "]\n" : "}\n";
+    }
+}  // namespace binred::interpret
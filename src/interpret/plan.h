@@ -0,0 +1,685 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#pragma once
+
+#include "../parse/parser/parse.h"
+#include "../calc/get_const.h"
+#include "../calc/cast_ptr.h"
+#include "../output/common/analisis/resolve_names.h"
+#include "../output/common/fixed_layout.h"
+#include <extutil.h>
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace binred::interpret {
+    using Error = analisis::Error;
+
+    constexpr size_t npos = ~size_t(0);
+
+    enum class ExprOp : std::uint8_t {
+        constant,
+        slot,
+        add,
+        sub,
+        mul,
+        div,
+        mod,
+        and_,
+        or_,
+        xor_,
+        eq,
+        lt,
+        gt,
+        le,
+        ge,
+    };
+
+    struct ExprCode {
+        ExprOp op;
+        std::int64_t v = 0;
+    };
+
+    // ExprProgram is expression flattened into postfix order
+    // evaluated on small fixed stack, so that no Expr node is visited while decoding
+    struct ExprProgram {
+        static constexpr size_t max_depth = 16;
+        std::vector<ExprCode> code;
+
+        bool constant() const {
+            return code.size() == 1 && code[0].op == ExprOp::constant;
+        }
+    };
+
+    enum class StepKind : std::uint8_t {
+        guard,
+        integer,
+        bits,
+        varint,
+        leb128,
+        zigzag,
+        bytes,
+        cargo,
+        repeat,
+        when,
+        check,
+        skip,
+        back,
+        assign,
+        transfer,
+        transfer_switch,
+    };
+
+    enum class CheckKind : std::uint8_t {
+        bind,
+        test,
+    };
+
+    struct BitSlot {
+        size_t slot;
+        size_t shift;
+        size_t width;
+        std::string name;
+    };
+
+    // Step is one decode action of cargo plan
+    // length is len if constant, otherwise expr is evaluated
+    // checked step is in range already tested by preceding guard step
+    struct Step {
+        StepKind kind{};
+        std::string name;
+        std::string where;
+        size_t slot = npos;
+        size_t width = 0;
+        size_t len = npos;
+        size_t cargo = npos;
+        bool little = false;
+        bool sign = false;
+        bool bytes = false;
+        bool checked = false;
+        CheckKind check = CheckKind::bind;
+        ExprProgram expr;
+        std::vector<BitSlot> bits;
+        std::vector<Step> then, otherwise;
+        std::vector<std::pair<std::int64_t, size_t>> table;
+
+        Step() = default;
+
+        Step(StepKind kind)
+            : kind(kind) {}
+    };
+
+    // CargoPlan is decode plan of one cargo prepared once from Record
+    // slots hold numeric value of params (byte length, element count for byte and repeat)
+    // and those of base cargo come first, so derived cargo continues in frame of its base
+    struct CargoPlan {
+        std::string name;
+        size_t base = npos;
+        size_t frame_size = 0;
+        size_t fixed_size = npos;
+        std::vector<std::string> slots;
+        std::vector<Step> steps;
+        bool transfers = false;
+        bool done = false;
+        bool building = false;
+
+        size_t find_slot(const std::string& name) const {
+            for (size_t i = 0; i < slots.size(); i++) {
+                if (slots[i] == name) {
+                    return i;
+                }
+            }
+            return npos;
+        }
+    };
+
+    struct Schema {
+        std::vector<CargoPlan> cargos;
+        std::map<std::string, size_t> index;
+
+        const CargoPlan* find(const std::string& name) const {
+            auto found = index.find(name);
+            return found == index.end() ? nullptr : &cargos[found->second];
+        }
+    };
+
+    // Planner builds Schema from Record resolved by TypeResolver and folded by fold_record
+    // checksum param is read as plain uint (not verified) and complex type is not supported
+    struct Planner {
+        static Error error(Cargo& cargo, const std::string& msg, std::shared_ptr<token_t> token = nullptr) {
+            return {"cargo `" + cargo.name + "`: " + msg, nullptr, token};
+        }
+
+        static Error compile_expr(CargoPlan& plan, Cargo& cargo, Record& rec, std::shared_ptr<Expr>& expr, ExprProgram& prog) {
+            size_t depth = 0, max = 0;
+            auto push = [&](ExprCode code) {
+                prog.code.push_back(code);
+                if (code.op == ExprOp::constant || code.op == ExprOp::slot) {
+                    depth++;
+                    max = (std::max)(max, depth);
+                }
+                else {
+                    depth--;
+                }
+            };
+            auto rec_ = [&](auto self, std::shared_ptr<Expr>& e) -> Error {
+                if (!e) {
+                    return error(cargo, "empty expression");
+                }
+                if (auto c = get_const_int<std::int64_t>(e); c.second) {
+                    push({ExprOp::constant, c.first});
+                    return {};
+                }
+                switch (e->kind) {
+                    case ExprKind::ref: {
+                        auto splt = commonlib2::split(e->v, ".");
+                        if (splt.size() == 2) {
+                            auto alias = rec.aliases.find(splt[0]);
+                            if (alias != rec.aliases.end()) {
+                                auto value = alias->second->alias.find(splt[1]);
+                                if (value == alias->second->alias.end()) {
+                                    return error(cargo, "alias `" + e->v + "` not found", e->token);
+                                }
+                                auto c = get_const_int<std::int64_t>(value->second->expr);
+                                if (!c.second) {
+                                    return error(cargo, "alias `" + e->v + "` is not constant", e->token);
+                                }
+                                push({ExprOp::constant, c.first});
+                                return {};
+                            }
+                            if (splt[0] == cargo.base.selfname) {
+                                splt.erase(splt.begin());
+                            }
+                        }
+                        if (splt.size() != 1) {
+                            return error(cargo, "reference `" + e->v + "` into nested cargo is not supported", e->token);
+                        }
+                        auto slot = plan.find_slot(splt[0]);
+                        if (slot == npos) {
+                            return error(cargo, "`" + e->v + "` not found", e->token);
+                        }
+                        push({ExprOp::slot, std::int64_t(slot)});
+                        return {};
+                    }
+                    case ExprKind::op: {
+                        static const std::pair<const char*, ExprOp> ops[] = {
+                            {"+", ExprOp::add},
+                            {"-", ExprOp::sub},
+                            {"*", ExprOp::mul},
+                            {"/", ExprOp::div},
+                            {"%", ExprOp::mod},
+                            {"&", ExprOp::and_},
+                            {"|", ExprOp::or_},
+                            {"^", ExprOp::xor_},
+                            {"==", ExprOp::eq},
+                            {"<", ExprOp::lt},
+                            {">", ExprOp::gt},
+                            {"<=", ExprOp::le},
+                            {">=", ExprOp::ge},
+                        };
+                        for (auto& op : ops) {
+                            if (e->v == op.first) {
+                                if (auto err = self(self, e->left); err) {
+                                    return err;
+                                }
+                                if (auto err = self(self, e->right); err) {
+                                    return err;
+                                }
+                                push({op.second});
+                                return {};
+                            }
+                        }
+                        return error(cargo, "operator `" + e->v + "` is not supported", e->token);
+                    }
+                    default:
+                        return error(cargo, "expression `" + e->v + "` is not supported", e->token);
+                }
+            };
+            if (auto err = rec_(rec_, expr); err) {
+                return err;
+            }
+            if (max > ExprProgram::max_depth) {
+                return error(cargo, "expression is too deep", expr->token);
+            }
+            return {};
+        }
+
+        // length sets len if expr is constant, otherwise compiles it
+        static Error length(CargoPlan& plan, Cargo& cargo, Record& rec, std::shared_ptr<Expr>& expr, Step& step) {
+            if (auto c = get_const_int<size_t>(expr); c.second) {
+                step.len = c.first;
+                return {};
+            }
+            return compile_expr(plan, cargo, rec, expr, step.expr);
+        }
+
+        static Error check(CargoPlan& plan, Cargo& cargo, Record& rec, std::shared_ptr<Expr>& expr, CheckKind kind, const std::string& where, std::vector<Step>& steps) {
+            Step step{StepKind::check};
+            step.check = kind;
+            step.where = where;
+            if (auto err = compile_expr(plan, cargo, rec, expr, step.expr); err) {
+                return err;
+            }
+            steps.push_back(std::move(step));
+            return {};
+        }
+
+        // param_step plans read of one param, len is pop length or declared length
+        static Error param_step(Schema& schema, CargoPlan& plan, Cargo& cargo, Record& rec, std::shared_ptr<Param>& param, std::shared_ptr<Expr> len, std::vector<Step>& steps) {
+            Step step{StepKind::integer};
+            step.name = param->name;
+            step.where = cargo.name + "." + param->name;
+            step.slot = plan.find_slot(param->name);
+            auto type = param->type;
+            if (type == ParamType::custom) {
+                auto sub = castptr<Custom>(param)->cargoname;
+                if (!rec.cargos.count(sub)) {
+                    return error(cargo, "complex type `" + sub + "` is not supported", param->token);
+                }
+                step.kind = StepKind::cargo;
+                step.cargo = schema.index[sub];
+            }
+            else if (type == ParamType::integer || type == ParamType::uint || type == ParamType::bit) {
+                auto size = get_const_int<size_t>(len);
+                if (!size.second || size.first == 0 || size.first > 8) {
+                    return error(cargo, "length of `" + param->name + "` must be constant 1 to 8", param->token);
+                }
+                step.width = size.first;
+                step.sign = type == ParamType::integer;
+                auto endian = param->endian != Endian::none ? param->endian : cargo.endian;
+                step.little = type != ParamType::bit && endian == Endian::little;
+            }
+            else if (type == ParamType::varint) {
+                step.kind = StepKind::varint;
+            }
+            else if (type == ParamType::leb128) {
+                step.kind = StepKind::leb128;
+            }
+            else if (type == ParamType::zigzag) {
+                step.kind = StepKind::zigzag;
+            }
+            else if (type == ParamType::byte) {
+                step.kind = StepKind::bytes;
+                if (!param->repeat) {
+                    if (auto err = length(plan, cargo, rec, len, step); err) {
+                        return err;
+                    }
+                }
+            }
+            if (param->repeat) {
+                if (type == ParamType::bit || type == ParamType::byte) {
+                    return error(cargo, "repeated `" + param->name + "` must be int, uint, varint, leb128, zigzag or cargo", param->token);
+                }
+                Step rep{StepKind::repeat};
+                rep.name = step.name;
+                rep.where = step.where;
+                rep.slot = step.slot;
+                rep.bytes = param->repeat->bytes;
+                if (auto err = length(plan, cargo, rec, param->repeat->expr, rep); err) {
+                    return err;
+                }
+                step.slot = npos;
+                rep.then.push_back(std::move(step));
+                steps.push_back(std::move(rep));
+            }
+            else {
+                steps.push_back(std::move(step));
+            }
+            if (param->bind_c) {
+                return check(plan, cargo, rec, param->bind_c->expr, CheckKind::bind, cargo.name + "." + param->name, steps);
+            }
+            return {};
+        }
+
+        static Error bit_run(CargoPlan& plan, Cargo& cargo, Record& rec, std::vector<std::shared_ptr<Param>*>& run, std::vector<Step>& steps) {
+            if (run.empty()) {
+                return {};
+            }
+            Step step{StepKind::bits};
+            size_t total = 0;
+            for (auto p : run) {
+                auto w = get_const_int<size_t>(castptr<ExprLength>(castptr<Builtin>(*p)->length)->expr);
+                if (!w.second || w.first == 0) {
+                    return error(cargo, "width of `" + (*p)->name + "` must be constant", (*p)->token);
+                }
+                step.bits.push_back({plan.find_slot((*p)->name), 0, w.first, (*p)->name});
+                total += w.first;
+            }
+            if (total % 8 != 0 || total > 64) {
+                return error(cargo, "bit run from `" + (*run[0])->name + "` must fill 1 to 8 bytes", (*run[0])->token);
+            }
+            auto shift = total;
+            for (auto& b : step.bits) {
+                shift -= b.width;
+                b.shift = shift;
+            }
+            step.width = total / 8;
+            step.where = cargo.name + "." + (*run[0])->name;
+            steps.push_back(std::move(step));
+            for (auto p : run) {
+                if ((*p)->bind_c) {
+                    if (auto err = check(plan, cargo, rec, (*p)->bind_c->expr, CheckKind::bind, cargo.name + "." + (*p)->name, steps); err) {
+                        return err;
+                    }
+                }
+            }
+            run.clear();
+            return {};
+        }
+
+        static Error implicit(Schema& schema, CargoPlan& plan, Cargo& cargo, Record& rec, std::vector<Step>& steps) {
+            std::vector<std::shared_ptr<Param>*> run;
+            for (auto& param : cargo.params) {
+                if (param->type == ParamType::bit && !param->if_c) {
+                    run.push_back(&param);
+                    continue;
+                }
+                if (auto err = bit_run(plan, cargo, rec, run, steps); err) {
+                    return err;
+                }
+                if (is_absent(param)) {
+                    continue;
+                }
+                auto* out = &steps;
+                if (param->if_c) {
+                    Step when{StepKind::when};
+                    if (auto err = compile_expr(plan, cargo, rec, param->if_c->expr, when.expr); err) {
+                        return err;
+                    }
+                    steps.push_back(std::move(when));
+                    out = &steps.back().then;
+                }
+                if (param->type == ParamType::bit) {
+                    run.push_back(&param);
+                    if (auto err = bit_run(plan, cargo, rec, run, *out); err) {
+                        return err;
+                    }
+                }
+                else {
+                    std::shared_ptr<Expr> len;
+                    if (param->type != ParamType::custom) {
+                        len = castptr<ExprLength>(castptr<Builtin>(param)->length)->expr;
+                    }
+                    if (auto err = param_step(schema, plan, cargo, rec, param, len, *out); err) {
+                        return err;
+                    }
+                }
+            }
+            return bit_run(plan, cargo, rec, run, steps);
+        }
+
+        static Error transfer_to(Schema& schema, Cargo& cargo, Record& rec, TransferData& data, size_t& to) {
+            if (!rec.cargos.count(data.cargoname)) {
+                return error(cargo, "transfer target `" + data.cargoname + "` not found");
+            }
+            to = schema.index[data.cargoname];
+            return {};
+        }
+
+        static Error commands(Schema& schema, CargoPlan& plan, Cargo& cargo, Record& rec, std::vector<std::shared_ptr<Command>>& cmds, std::vector<Step>& steps) {
+            for (auto& c : cmds) {
+                switch (c->kind) {
+                    case CommandKind::pop: {
+                        auto pop = castptr<PopCommand>(c);
+                        if (pop->refid.size()) {
+                            std::shared_ptr<Param>* param = nullptr;
+                            for (auto& p : cargo.params) {
+                                if (p->name == pop->refid) {
+                                    param = &p;
+                                }
+                            }
+                            if (!param) {
+                                return error(cargo, "`" + pop->refid + "` not found", c->token);
+                            }
+                            if (auto err = param_step(schema, plan, cargo, rec, *param, pop->numpop, steps); err) {
+                                return err;
+                            }
+                            break;
+                        }
+                        Step step{StepKind::skip};
+                        step.where = cargo.name + ".pop";
+                        if (auto err = length(plan, cargo, rec, pop->numpop, step); err) {
+                            return err;
+                        }
+                        steps.push_back(std::move(step));
+                        break;
+                    }
+                    case CommandKind::push: {
+                        Step step{StepKind::back};
+                        step.where = cargo.name + ".push";
+                        if (auto err = length(plan, cargo, rec, castptr<PushCommand>(c)->numpop, step); err) {
+                            return err;
+                        }
+                        steps.push_back(std::move(step));
+                        break;
+                    }
+                    case CommandKind::if_: {
+                        // elif and else are nested in otherwise of preceding condition
+                        auto* out = &steps;
+                        for (auto& cond : castptr<IfCommand>(c)->ifs) {
+                            if (!cond->expr) {
+                                if (auto err = commands(schema, plan, cargo, rec, cond->cmds, *out); err) {
+                                    return err;
+                                }
+                                break;
+                            }
+                            Step when{StepKind::when};
+                            if (auto err = compile_expr(plan, cargo, rec, cond->expr, when.expr); err) {
+                                return err;
+                            }
+                            if (auto err = commands(schema, plan, cargo, rec, cond->cmds, when.then); err) {
+                                return err;
+                            }
+                            out->push_back(std::move(when));
+                            out = &out->back().otherwise;
+                        }
+                        break;
+                    }
+                    case CommandKind::bind:
+                        if (auto err = check(plan, cargo, rec, castptr<BindCommand>(c)->expr, CheckKind::bind, cargo.name + ".bind", steps); err) {
+                            return err;
+                        }
+                        break;
+                    case CommandKind::test:
+                        if (auto err = check(plan, cargo, rec, castptr<TestCommand>(c)->expr, CheckKind::test, cargo.name + ".test", steps); err) {
+                            return err;
+                        }
+                        break;
+                    case CommandKind::assign: {
+                        auto assign = castptr<AssignCommand>(c);
+                        Step step{StepKind::assign};
+                        step.name = assign->target;
+                        step.slot = plan.find_slot(assign->target);
+                        if (step.slot == npos) {
+                            return error(cargo, "`" + assign->target + "` not found", c->token);
+                        }
+                        if (auto err = compile_expr(plan, cargo, rec, assign->expr, step.expr); err) {
+                            return err;
+                        }
+                        steps.push_back(std::move(step));
+                        break;
+                    }
+                    case CommandKind::transfer_direct: {
+                        plan.transfers = true;
+                        Step step{StepKind::transfer};
+                        if (auto err = transfer_to(schema, cargo, rec, castptr<TransferDirect>(c)->data, step.cargo); err) {
+                            return err;
+                        }
+                        steps.push_back(std::move(step));
+                        break;
+                    }
+                    case CommandKind::transfer_if: {
+                        auto tif = castptr<TransferIf>(c);
+                        plan.transfers = true;
+                        Step when{StepKind::when}, step{StepKind::transfer};
+                        if (auto err = compile_expr(plan, cargo, rec, tif->cond, when.expr); err) {
+                            return err;
+                        }
+                        if (auto err = transfer_to(schema, cargo, rec, tif->data, step.cargo); err) {
+                            return err;
+                        }
+                        when.then.push_back(std::move(step));
+                        steps.push_back(std::move(when));
+                        break;
+                    }
+                    case CommandKind::transfer_switch: {
+                        // cases are sorted by value and searched by binary search
+                        auto tsw = castptr<TransferSwitch>(c);
+                        plan.transfers = true;
+                        Step step{StepKind::transfer_switch};
+                        if (auto err = compile_expr(plan, cargo, rec, tsw->cond, step.expr); err) {
+                            return err;
+                        }
+                        for (auto& to : tsw->to) {
+                            auto value = get_const_int<std::int64_t>(to.first);
+                            if (!value.second) {
+                                return error(cargo, "case of transfer switch must be constant", c->token);
+                            }
+                            size_t index = npos;
+                            if (auto err = transfer_to(schema, cargo, rec, to.second, index); err) {
+                                return err;
+                            }
+                            step.table.push_back({value.first, index});
+                        }
+                        std::stable_sort(step.table.begin(), step.table.end(), [](auto& a, auto& b) {
+                            return a.first < b.first;
+                        });
+                        if (tsw->defaults.cargoname.size()) {
+                            if (auto err = transfer_to(schema, cargo, rec, tsw->defaults, step.cargo); err) {
+                                return err;
+                            }
+                        }
+                        steps.push_back(std::move(step));
+                        break;
+                    }
+                    default:
+                        return error(cargo, "command is not supported", c->token);
+                }
+            }
+            return {};
+        }
+
+        static size_t wire_size(Step& step) {
+            switch (step.kind) {
+                case StepKind::integer:
+                case StepKind::bits:
+                    return step.width;
+                case StepKind::bytes:
+                case StepKind::skip:
+                    return step.len;
+                default:
+                    return npos;
+            }
+        }
+
+        // group puts one guard before run of constant size steps and marks them checked
+        static void group(std::vector<Step>& steps) {
+            std::vector<Step> out;
+            for (size_t i = 0; i < steps.size();) {
+                size_t total = 0, j = i;
+                for (; j < steps.size(); j++) {
+                    auto size = wire_size(steps[j]);
+                    if (size == npos) {
+                        if (steps[j].kind == StepKind::check) {
+                            // check does not move position
+                            continue;
+                        }
+                        break;
+                    }
+                    total += size;
+                }
+                if (j - i >= 2 && total) {
+                    Step guard{StepKind::guard};
+                    guard.len = total;
+                    guard.where = steps[i].where;
+                    out.push_back(std::move(guard));
+                    for (; i < j; i++) {
+                        steps[i].checked = true;
+                        out.push_back(std::move(steps[i]));
+                    }
+                    continue;
+                }
+                if (i == j) {
+                    group(steps[i].then);
+                    group(steps[i].otherwise);
+                    out.push_back(std::move(steps[i]));
+                    i++;
+                    continue;
+                }
+                for (; i < j; i++) {
+                    out.push_back(std::move(steps[i]));
+                }
+            }
+            steps = std::move(out);
+        }
+
+        // base is built first because its slots begin frame
+        // nested and transfer target cargos are referred by index only
+        static Error build_cargo(Schema& schema, Record& rec, const std::string& name) {
+            auto index = schema.index[name];
+            if (schema.cargos[index].done) {
+                return {};
+            }
+            auto& cargo = *rec.cargos[name];
+            if (schema.cargos[index].building) {
+                return error(cargo, "base cargo loops");
+            }
+            schema.cargos[index].building = true;
+            CargoPlan plan;
+            plan.name = name;
+            if (cargo.base.basename.size()) {
+                if (!rec.cargos.count(cargo.base.basename)) {
+                    return error(cargo, "base cargo `" + cargo.base.basename + "` not found");
+                }
+                if (auto err = build_cargo(schema, rec, cargo.base.basename); err) {
+                    return err;
+                }
+                plan.base = schema.index[cargo.base.basename];
+                plan.slots = schema.cargos[plan.base].slots;
+            }
+            for (auto& p : cargo.params) {
+                plan.slots.push_back(p->name);
+            }
+            plan.frame_size = plan.slots.size();
+            if (auto fixed = get_fixed_size(cargo, rec); fixed.second) {
+                plan.fixed_size = fixed.first;
+            }
+            Error err;
+            if (auto read = cargo.read.lock()) {
+                err = commands(schema, plan, cargo, rec, read->cmds, plan.steps);
+            }
+            else {
+                err = implicit(schema, plan, cargo, rec, plan.steps);
+            }
+            if (err) {
+                return err;
+            }
+            group(plan.steps);
+            plan.done = true;
+            schema.cargos[index] = std::move(plan);
+            return {};
+        }
+
+        static Error build(Record& rec, Schema& schema) {
+            schema.cargos.clear();
+            schema.index.clear();
+            for (auto& c : rec.cargos) {
+                schema.index[c.first] = schema.cargos.size();
+                schema.cargos.emplace_back();
+            }
+            for (auto& c : rec.cargos) {
+                if (auto err = build_cargo(schema, rec, c.first); err) {
+                    return err;
+                }
+            }
+            return {};
+        }
+    };
+}  // namespace binred::interpret
@@ -7,9 +7,14 @@
 
 
 #include "parse/parser/parse.h"
+#include "output/common/analisis/resolve_names.h"
+#include "calc/fold_const.h"
 #include "output/cpp/cargo_to_struct.h"
 #include "output/cpp/alias_to_enum.h"
 #include "output/cpp/add_error_enum.h"
+#include "output/cpp/runtime_helper.h"
+#include "build/build_files.h"
+#include "interpret/bytecode.h"
 #include <iostream>
 #include <fstream>
 #include <optmap.h>
@@ -30,6 +35,15 @@ void binred_test() {
         commonlib2::Reader fin(commonlib2::FileReader("D:/MiniTools/binred/http2_frame.brd"));
         binred::parse_binred(fin, red, record, result);
     }
+    binred::analisis::SortElement sorted(result);
+    if (auto err = binred::analisis::TypeResolver::resolve(sorted, record); err) {
+        cout << err.errmsg << "\n";
+        return;
+    }
+    if (!binred::fold_record(result, record)) {
+        cout << "failed to fold constant\n";
+        return;
+    }
     binred::cpp::CppOutContext ctx;
     for (auto& a : record.aliases) {
         binred::cpp::AliasToCppEnum::convert(ctx, *a.second);
@@ -43,7 +57,8 @@ void binred_test() {
     {
         std::ofstream fs("D:/MiniTools/binred/generated/test.hpp");
         cout << ctx.buffer;
-        fs << "/*license*/\n#pragma once\n#include<cstdint>\n#include<string>\n";
+        fs << "/*license*/\n#pragma once\n#include<cstdint>\n#include<cstring>\n#include<string>\n";
+        fs << binred::cpp::runtime_helper(ctx);
         fs << binred::cpp::error_enum_class(ctx);
         fs << ctx.buffer;
     }
@@ -85,6 +100,161 @@ void test_syntax(cl2::SubCmdDispatch<>::result_t&) {
     */
 }
 
+int build_command(cl2::SubCmdDispatch<>::result_t& r) {
+    auto layer = r.get_layer("build");
+    auto inputs = layer->has_("input");
+    if (!inputs) {
+        cout << r.fmtln("need input file");
+        return 1;
+    }
+    if (auto lang = layer->has_("language"); lang && lang->arg()->at(0) != "cpp") {
+        cout << r.fmtln("language " + lang->arg()->at(0) + " is not supported");
+        return 1;
+    }
+    size_t maxthread = std::thread::hardware_concurrency();
+    if (maxthread == 0) {
+        maxthread = 1;
+    }
+    size_t threads = maxthread;
+    if (auto process = r.get_layer(0)->has_("process")) {
+        int count = 0;
+        cl2::Reader(process->arg()->at(0)) >> count;
+        if (count < 1) {
+            cout << r.fmtln("process must be 1 or more");
+            return 1;
+        }
+        // more threads than cores only adds switching, so same script runs on smaller machine
+        threads = (std::min)(size_t(count), maxthread);
+    }
+    binred::build::Build b;
+    b.ctx.byte_view = layer->has_("byte-view") != nullptr;
+    b.ctx.pmr = layer->has_("pmr") != nullptr;
+    b.ctx.compare = layer->has_("compare") != nullptr;
+    b.ctx.harness = layer->has_("harness") != nullptr;
+    b.ctx.generic = layer->has_("generic") != nullptr;
+    auto output = layer->has_("output");
+    if (b.ctx.harness) {
+        if (b.ctx.byte_view || b.ctx.generic) {
+            cout << r.fmtln("harness can't be used with byte-view or generic");
+            return 1;
+        }
+        if (!output) {
+            cout << r.fmtln("harness needs output file");
+            return 1;
+        }
+    }
+    if (!b.run(*inputs->arg(), threads)) {
+        cout << r.fmtln(b.error);
+        return -1;
+    }
+    if (!output) {
+        cout << b.header();
+        return 0;
+    }
+    auto& path = output->arg()->at(0);
+    {
+        std::ofstream fs(cl2::ToPath(path).c_str());
+        if (!fs.is_open()) {
+            cout << r.fmtln("file " + path + " couldn't open");
+            return -1;
+        }
+        fs << b.header();
+    }
+    if (b.ctx.harness) {
+        // x/y.hpp -> x/y.bench.cpp and x/y.fuzz.cpp which include "y.hpp"
+        auto dir = path.find_last_of("/\\");
+        auto header = dir == std::string::npos ? path : path.substr(dir + 1);
+        auto stem = path.substr(0, path.size() - header.size()) + header.substr(0, header.find_last_of('.'));
+        std::ofstream(cl2::ToPath(stem + ".bench.cpp").c_str()) << binred::cpp::bench_source(b.ctx, header, b.names);
+        std::ofstream(cl2::ToPath(stem + ".fuzz.cpp").c_str()) << binred::cpp::fuzz_source(b.ctx, header, b.names, b.record);
+    }
+    cout << r.fmtln("operation succeeded. result saved to " + path);
+    return 0;
+}
+
+// hex digits may be separated by space
+bool from_hex(const std::string& hex, std::string& out) {
+    int half = -1;
+    for (auto c : hex) {
+        int v = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+        if (v < 0) {
+            if (c == ' ' && half < 0) {
+                continue;
+            }
+            return false;
+        }
+        if (half < 0) {
+            half = v;
+            continue;
+        }
+        out.push_back(char((half << 4) | v));
+        half = -1;
+    }
+    return half < 0;
+}
+
+int interpret_command(cl2::SubCmdDispatch<>::result_t& r) {
+    auto layer = r.get_layer("interpret");
+    auto inputs = layer->has_("input");
+    auto cargo = layer->has_("cargo");
+    if (!inputs || !cargo) {
+        cout << r.fmtln("need input file and cargo");
+        return 1;
+    }
+    std::string data;
+    if (auto hex = layer->has_("hex")) {
+        if (!from_hex(hex->arg()->at(0), data)) {
+            cout << r.fmtln("invalid hex");
+            return 1;
+        }
+    }
+    else if (auto file = layer->has_("file")) {
+        std::ifstream fs(cl2::ToPath(file->arg()->at(0)).c_str(), std::ios::binary);
+        if (!fs.is_open()) {
+            cout << r.fmtln("file " + file->arg()->at(0) + " couldn't open");
+            return -1;
+        }
+        data.assign(std::istreambuf_iterator<char>(fs), std::istreambuf_iterator<char>());
+    }
+    else {
+        cout << r.fmtln("need hex or file to decode");
+        return 1;
+    }
+    binred::build::Build b;
+    if (!b.load(*inputs->arg(), 1)) {
+        cout << r.fmtln(b.error);
+        return -1;
+    }
+    binred::interpret::Schema schema;
+    if (auto err = binred::interpret::Planner::build(b.record, schema); err) {
+        cout << r.fmtln(err.errmsg);
+        return -1;
+    }
+    binred::interpret::Interpreter in(schema);
+    auto prog = binred::interpret::Compiler::compile(schema);
+    binred::interpret::Machine vm(prog);
+    binred::interpret::TreeBuilder tree;
+    size_t pos = 0;
+    auto p = reinterpret_cast<const std::uint8_t*>(data.data());
+    auto use_vm = layer->has_("vm") != nullptr;
+    auto err = use_vm ? vm.decode(cargo->arg()->at(0), p, data.size(), pos, tree)
+                      : in.decode(cargo->arg()->at(0), p, data.size(), pos, tree);
+    if (err != binred::interpret::DecodeError::none) {
+        std::string msg = binred::interpret::error_name(err);
+        auto where = use_vm ? vm.where : in.where;
+        if (where.size()) {
+            msg += " at " + std::string(where);
+        }
+        cout << r.fmtln(msg);
+        return -1;
+    }
+    std::string out;
+    binred::interpret::write_tree(out, tree.root);
+    cout << out;
+    cout << r.fmtln("decoded " + std::to_string(pos) + " of " + std::to_string(data.size()) + " bytes");
+    return 0;
+}
+
 int main(int argc, char** argv) {
     commonlib2::IOWrapper::Init();
     commonlib2::ArgChange _(argc, argv);
@@ -107,7 +277,7 @@ int main(int argc, char** argv) {
         return 0;
     });
     disp.set_option({
-        {"process", {'p'}, "set maximum thread count (1-" + std::to_string(std::thread::hardware_concurrency()) + ")", 1, true},
+        {"process", {'p'}, "set maximum thread count (clamped to core count)", 1, true},
     });
     disp.set_subcommand(
             "help", "show command help",
@@ -148,8 +318,25 @@ int main(int argc, char** argv) {
                 {"input", {'i'}, "set input files", 1, false, true},
                 {"language", {'l'}, "set output language (cpp)", 1, false, true},
                 {"output", {'o'}, "set output file", 1, false, true},
-            })
-        ->set_usage("binred build [<options>]");
+                {"byte-view", {'v'}, "map variable length byte to std::string_view (cpp)", 0, true},
+                {"pmr", {'m'}, "allocate owned byte from std::pmr::memory_resource (cpp)", 0, true},
+                {"compare", {'c'}, "generate operator==, operator<=> and hash for cargo (cpp)", 0, true},
+                {"harness", {'b'}, "also write benchmark and libFuzzer source next to output (cpp)", 0, true},
+                {"generic", {'g'}, "write constexpr field table for template engine instead of member functions (cpp)", 0, true},
+            },
+            build_command)
+        ->set_usage("binred [-p <count>] build [<options>]");
+    disp.set_subcommand(
+            "interpret", "decode binary by schema without generating code",
+            {
+                {"input", {'i'}, "set schema files", 1, false, true},
+                {"cargo", {'c'}, "set cargo to decode", 1, true},
+                {"hex", {'x'}, "decode hex string", 1, true},
+                {"file", {'f'}, "decode content of file", 1, true},
+                {"vm", {'m'}, "decode by bytecode machine instead of tree walking interpreter", 0, true},
+            },
+            interpret_command)
+        ->set_usage("binred interpret [-m] -i <schema> -c <cargo> (-x <hex> | -f <file>)");
     disp.set_subcommand(
             "get", "get package from the Internet",
             {
@@ -22,10 +22,10 @@ namespace binred::analisis {
     };
 
     struct TypeResolver {
-        static Error resolve_command(auto& e, auto& found, SortElement& sorted, Record& rec) {
+        static Error resolve_command(auto& e, auto& cmds, auto& found, SortElement& sorted, Record& rec) {
             auto resolve_transfer_and_cargo = [&](TransferData& data, std::shared_ptr<token_t>& token) -> Error {
                 auto cargo = rec.cargos.find(data.cargoname);
-                if (cargo != rec.cargos.end()) {
+                if (cargo == rec.cargos.end()) {
                     return {
                         "cargo `" + data.cargoname + "` not found; need exist cargo name",
                         e,
@@ -40,19 +40,20 @@ namespace binred::analisis {
                     };
                 }
                 data.cargo = cargo->second;
+                return {};
             };
-            for (auto& c : e->cmds) {
+            for (auto& c : cmds) {
                 switch (c->kind) {
                     case CommandKind::transfer_direct: {
                         auto direct = castptr<TransferDirect>(c);
-                        if (auto err = resolve_transfer_and_cargo(direct->data, direct->token); !err) {
+                        if (auto err = resolve_transfer_and_cargo(direct->data, direct->token); err) {
                             return err;
                         }
                         break;
                     }
                     case CommandKind::transfer_if: {
                         auto tif = castptr<TransferIf>(c);
-                        if (auto err = resolve_transfer_and_cargo(tif->data, tif->token); !err) {
+                        if (auto err = resolve_transfer_and_cargo(tif->data, tif->token); err) {
                             return err;
                         }
                         break;
@@ -60,42 +61,64 @@ namespace binred::analisis {
                     case CommandKind::transfer_switch: {
                         auto tsw = castptr<TransferSwitch>(c);
                         for (auto& t : tsw->to) {
-                            if (auto err = resolve_transfer_and_cargo(t.second, tsw->token); !err) {
+                            if (auto err = resolve_transfer_and_cargo(t.second, tsw->token); err) {
                                 return err;
                             }
                         }
                         if (tsw->defaults.cargoname.size()) {
-                            if (auto err = resolve_transfer_and_cargo(tsw->defaults, tsw->token); !err) {
+                            if (auto err = resolve_transfer_and_cargo(tsw->defaults, tsw->token); err) {
                                 return err;
                             }
                         }
                         break;
                     }
+                    case CommandKind::if_: {
+                        auto cif = castptr<IfCommand>(c);
+                        for (auto& cond : cif->ifs) {
+                            if (auto err = resolve_command(e, cond->cmds, found, sorted, rec); err) {
+                                return err;
+                            }
+                        }
+                        break;
+                    }
+                    default:
+                        break;
                 }
             }
+            return {};
         }
 
-        static Error resolve_read(SortElement& sorted, Record& rec) {
-            for (auto& e : sorted.read) {
+        template <class IOType>
+        static Error resolve_io(std::vector<std::shared_ptr<IOType>>& io, std::weak_ptr<IOType> Cargo::*member, const char* kind, SortElement& sorted, Record& rec) {
+            for (auto& e : io) {
                 auto found = rec.cargos.find(e->name);
                 if (found == rec.cargos.end()) {
                     return {
-                        "cargo `" + e->name + "` not found; need exists cargo name for read cargo",
+                        "cargo `" + e->name + "` not found; need exists cargo name for " + kind + " cargo",
                         e,
                     };
                 }
-                if (!found->second->read.expired()) {
+                if (!((*found->second).*member).expired()) {
                     return {
-                        "cargo `" + e->name + "` already has read statment; need one read for one cargo",
+                        "cargo `" + e->name + "` already has " + kind + " statment; need one " + kind + " for one cargo",
                         e,
                     };
                 }
-                found->second->read = e;
+                (*found->second).*member = e;
                 e->cargo = found->second;
-                if (auto err = resolve_command(e, found, sorted, rec); !err) {
+                if (auto err = resolve_command(e, e->cmds, found, sorted, rec); err) {
                     return err;
                 }
             }
+            return {};
+        }
+
+        static Error resolve_read(SortElement& sorted, Record& rec) {
+            return resolve_io(sorted.read, &Cargo::read, "read", sorted, rec);
+        }
+
+        static Error resolve_write(SortElement& sorted, Record& rec) {
+            return resolve_io(sorted.write, &Cargo::write, "write", sorted, rec);
         }
 
         static Error resolve_cargo(SortElement& sorted, Record& rec) {
@@ -109,13 +132,13 @@ namespace binred::analisis {
                         };
                     }
                     c->base.cargo = found->second;
-                    found->second->derived[c->name] = c->base.cargo;
+                    found->second->derived[c->name] = c;
                 }
                 for (auto& p : c->params) {
                     if (p->type == ParamType::custom) {
                         auto custom = castptr<Custom>(p);
                         auto found = rec.cargos.find(custom->cargoname);
-                        if (found != rec.cargos.end()) {
+                        if (found == rec.cargos.end()) {
                             sorted.unresolved_param.emplace(p);
                             continue;
                         }
@@ -126,6 +149,16 @@ namespace binred::analisis {
             }
             return {};
         }
+
+        static Error resolve(SortElement& sorted, Record& rec) {
+            if (auto err = resolve_cargo(sorted, rec); err) {
+                return err;
+            }
+            if (auto err = resolve_read(sorted, rec); err) {
+                return err;
+            }
+            return resolve_write(sorted, rec);
+        }
     };
 
 }  // namespace binred::analisis
@@ -18,7 +18,7 @@ namespace binred::analisis {
         Sorted<TypeAlias> typealias;
         Sorted<Read> read;
         Sorted<Write> write;
-        std::set<std::weak_ptr<Param>> unresolved_param;
+        std::set<std::weak_ptr<Param>, std::owner_less<std::weak_ptr<Param>>> unresolved_param;
         SortElement(ParseResult& result) {
             for (auto& e : result) {
                 switch (e->type) {
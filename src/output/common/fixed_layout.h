@@ -0,0 +1,62 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#pragma once
+
+#include "../../parse/parser/parse.h"
+#include "../../calc/get_const.h"
+#include "../../calc/cast_ptr.h"
+
+namespace binred {
+    // get_fixed_size reports wire size of cargo whose layout never depends on decoded value
+    // cargo must have no base, no read/write block, no if/repeat/checksum decoration and only constant length params
+    std::pair<size_t, bool> get_fixed_size(Cargo& cargo, Record& rec) {
+        if (cargo.base.basename.size() || !cargo.read.expired() || !cargo.write.expired()) {
+            return {0, false};
+        }
+        size_t bytes = 0, bits = 0;
+        for (auto& p : cargo.params) {
+            if (p->if_c || p->repeat || p->checksum) {
+                return {0, false};
+            }
+            if (p->type == ParamType::custom) {
+                if (bits % 8) {
+                    return {0, false};
+                }
+                bytes += bits / 8;
+                bits = 0;
+                auto found = rec.cargos.find(castptr<Custom>(p)->cargoname);
+                if (found == rec.cargos.end()) {
+                    return {0, false};
+                }
+                auto sub = get_fixed_size(*found->second, rec);
+                if (!sub.second) {
+                    return {0, false};
+                }
+                bytes += sub.first;
+                continue;
+            }
+            auto len = get_const_int<size_t>(castptr<ExprLength>(castptr<Builtin>(p)->length)->expr);
+            if (!len.second) {
+                return {0, false};
+            }
+            if (p->type == ParamType::bit) {
+                bits += len.first;
+                continue;
+            }
+            if (bits % 8) {
+                return {0, false};
+            }
+            bytes += bits / 8 + len.first;
+            bits = 0;
+        }
+        if (bits % 8) {
+            return {0, false};
+        }
+        return {bytes + bits / 8, true};
+    }
+}  // namespace binred
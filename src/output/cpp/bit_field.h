@@ -0,0 +1,90 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#pragma once
+
+#include "../../parse/parser/parse.h"
+#include "../../calc/get_const.h"
+#include "../../calc/cast_ptr.h"
+
+namespace binred {
+    namespace cpp {
+        struct BitField {
+            std::string storage;
+            size_t storage_bits = 0;
+            size_t total = 0;
+            size_t shift = 0;
+            size_t width = 0;
+            bool first = false;
+        };
+
+        std::string storage_type(size_t bits) {
+            return "std::uint" + std::to_string(bits) + "_t";
+        }
+
+        // consecutive bit params without if decoration are packed into one word
+        // if they fill whole bytes up to 64 bit
+        bool get_bitfield(Cargo& cargo, const std::string& name, BitField& field) {
+            std::vector<std::pair<std::shared_ptr<Param>*, size_t>> run;
+            size_t total = 0;
+            auto find_in_run = [&]() {
+                if (total == 0 || total % 8 != 0 || total > 64) {
+                    return false;
+                }
+                size_t shift = total;
+                for (size_t i = 0; i < run.size(); i++) {
+                    shift -= run[i].second;
+                    if ((*run[i].first)->name == name) {
+                        field.storage = "__bits_" + (*run[0].first)->name;
+                        field.storage_bits = total <= 8 ? 8 : total <= 16 ? 16 : total <= 32 ? 32 : 64;
+                        field.total = total;
+                        field.shift = shift;
+                        field.width = run[i].second;
+                        field.first = i == 0;
+                        return true;
+                    }
+                }
+                return false;
+            };
+            for (auto& param : cargo.params) {
+                if (param->type == ParamType::bit && !param->if_c) {
+                    auto w = get_const_int<size_t>(castptr<ExprLength>(castptr<Builtin>(param)->length)->expr);
+                    if (w.second && w.first != 0) {
+                        run.push_back({&param, w.first});
+                        total += w.first;
+                        continue;
+                    }
+                }
+                if (find_in_run()) {
+                    return true;
+                }
+                run.clear();
+                total = 0;
+            }
+            return find_in_run();
+        }
+
+        std::string bitfield_mask(size_t width) {
+            if (width == 64) {
+                return "~std::uint64_t(0)";
+            }
+            return "((std::uint64_t(1) << " + std::to_string(width) + ") - 1)";
+        }
+
+        // expression extracting field from packed storage
+        std::string bitfield_get(const BitField& field) {
+            return "((std::uint64_t(" + field.storage + ") >> " + std::to_string(field.shift) + ") & " + bitfield_mask(field.width) + ")";
+        }
+
+        // statement storing value into packed storage
+        std::string bitfield_set(const BitField& field, const std::string& value) {
+            auto mask = bitfield_mask(field.width);
+            auto shift = std::to_string(field.shift);
+            return field.storage + " = " + storage_type(field.storage_bits) + "((std::uint64_t(" + field.storage + ") & ~(" + mask + " << " + shift + ")) | ((std::uint64_t(" + value + ") & " + mask + ") << " + shift + "));\n";
+        }
+    }  // namespace cpp
+}  // namespace binred
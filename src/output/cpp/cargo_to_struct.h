@@ -13,6 +13,12 @@
 #include "../../calc/trace_expr.h"
 #include "format_alias_and_cargo.h"
 #include "code_element.h"
+#include "read_to_decode.h"
+#include "write_to_encode.h"
+#include "lazy_accessor.h"
+#include "compare_hash.h"
+#include "random_fill.h"
+#include "../common/fixed_layout.h"
 
 namespace binred {
     namespace cpp {
@@ -74,6 +80,12 @@ namespace binred {
                         }
                     }
                 }
+                else if (type == ParamType::varint || type == ParamType::leb128) {
+                    tyname = "std::uint64_t";
+                }
+                else if (type == ParamType::zigzag) {
+                    tyname = "std::int64_t";
+                }
                 else if (type == ParamType::byte) {
                     auto lenp = get_exprlength(param);
                     if (ctx.allow_fixed()) {
@@ -107,6 +119,9 @@ namespace binred {
                 else {
                     return false;
                 }
+                if (param->repeat) {
+                    tyname = (ctx.pmr ? "std::pmr::vector<" : "std::vector<") + tyname + ">";
+                }
                 return true;
             }
 
@@ -114,6 +129,30 @@ namespace binred {
                 if (param->default_v) {
                     def += " = {" + trace_expr(param->default_v->expr, formatter) + "}";
                 }
+                else {
+                    // field skipped by if decoration must not be read indeterminate
+                    def += "{}";
+                }
+                return true;
+            }
+
+            // packed bit params share one storage word, defaults are merged into its initializer
+            static bool set_packed_default(std::string& def, BitField& bits, Cargo& cargo, auto& formatter) {
+                std::string init;
+                for (auto& p : cargo.params) {
+                    BitField other;
+                    if (p->type != ParamType::bit || !p->default_v || !get_bitfield(cargo, p->name, other) || other.storage != bits.storage) {
+                        continue;
+                    }
+                    if (init.size()) {
+                        init += " | ";
+                    }
+                    init += "((std::uint64_t(" + trace_expr(p->default_v->expr, formatter) + ") & " + bitfield_mask(other.width) + ") << " + std::to_string(other.shift) + ")";
+                }
+                if (!init.size()) {
+                    init = "0";
+                }
+                def += storage_type(bits.storage_bits) + " " + bits.storage + " = " + storage_type(bits.storage_bits) + "(" + init + ");\n\n";
                 return true;
             }
 
@@ -126,27 +165,43 @@ namespace binred {
                     return false;
                 }
                 auto& name = param->name;
-                def += tyname + " " + name;
-                if (bylen != 0) {
-                    def += "[" + std::to_string(bylen) + "]";
+                BitField bits;
+                bool packed = param->type == ParamType::bit && get_bitfield(cargo, name, bits);
+                if (packed) {
+                    if (bits.first && !set_packed_default(def, bits, cargo, formatter)) {
+                        return false;
+                    }
                 }
-                if (!set_default(def, param, formatter)) {
-                    return false;
+                else {
+                    def += tyname + " " + name;
+                    if (bylen != 0) {
+                        def += "[" + std::to_string(bylen) + "]";
+                    }
+                    if (!set_default(def, param, formatter)) {
+                        return false;
+                    }
+                    def += ";\n\n";
                 }
-                def += ";\n\n";
                 //ctx.write("public:\n");
-                if (param->type == ParamType::byte || param->type == ParamType::custom) {
+                bool byref = param->type == ParamType::byte || param->type == ParamType::custom || param->repeat;
+                if (byref) {
                     getter += "const ";
                 }
                 getter += tyname;
                 if (bylen != 0) {
                     getter += "*";
                 }
-                else if (param->type == ParamType::byte || param->type == ParamType::custom) {
+                else if (byref) {
                     getter += "&";
                 }
-                getter += (" get_" + name + "() const {\nreturn " +
-                           name + ";\n}\n\n");
+                if (packed) {
+                    getter += (" get_" + name + "() const {\nreturn " +
+                               tyname + "(" + bitfield_get(bits) + ");\n}\n\n");
+                }
+                else {
+                    getter += (" get_" + name + "() const {\nreturn " +
+                               name + ";\n}\n\n");
+                }
                 setter += "\n";
                 setter += ctx.error_enum();
                 setter += " set_" + name + "(const " + tyname;
@@ -175,6 +230,20 @@ namespace binred {
                     write_return(setter, ctx.error_enum() + "::" + err + "_length");
                     write_endblock(setter);
                 }
+                if (param->repeat && !param->repeat->bytes) {
+                    ctx.set_error_enum(err + "_length");
+                    write_if(setter, "__v_input.size() != std::size_t(" + trace_expr(param->repeat->expr, formatter) + ")");
+                    write_beginblock(setter);
+                    write_return(setter, ctx.error_enum() + "::" + err + "_length");
+                    write_endblock(setter);
+                }
+                else if (param->type == ParamType::varint && !param->repeat) {
+                    ctx.set_error_enum(err + "_range");
+                    write_if(setter, "__v_input > " + ctx.helper_namespace() + "::varint_max");
+                    write_beginblock(setter);
+                    write_return(setter, ctx.error_enum() + "::" + err + "_range");
+                    write_endblock(setter);
+                }
                 current = name;
                 if (param->if_c) {
                     ctx.set_error_enum(err + "_if");
@@ -186,6 +255,9 @@ namespace binred {
                 if (bylen != 0) {
                     write_call(setter, "::memcpy", "this->" + name, "__v_input", std::to_string(bylen)) += ";\n";
                 }
+                else if (packed) {
+                    setter += bitfield_set(bits, "__v_input");
+                }
                 else {
                     setter += "this->" + name +
                               "=__v_input;\n";
@@ -195,12 +267,129 @@ namespace binred {
                 return true;
             }
 
+            // in byte_view mode, generates view_size/rebind_view/to_owned
+            // to_owned copies all viewed bytes (including base and nested cargo) into one storage
+            // kept by returned value, so that it does not depend on input any more
+            static bool get_owned(CppOutContext& ctx, std::string& owned, Cargo& cargo, Record& record) {
+                if (!ctx.byte_view) {
+                    return true;
+                }
+                std::string size, rebind;
+                if (cargo.base.basename.size()) {
+                    size += "std::size_t __size = " + cargo.base.basename + "::view_size();\n";
+                    rebind += cargo.base.basename + "::rebind_view(__dst);\n";
+                }
+                else {
+                    size += "std::size_t __size = 0;\n";
+                }
+                for (auto& param : cargo.params) {
+                    auto& name = param->name;
+                    if (param->type == ParamType::byte) {
+                        std::string tyname;
+                        size_t bylen = 0;
+                        if (!get_typename(tyname, ctx, param, bylen, record)) {
+                            return false;
+                        }
+                        if (bylen != 0) {
+                            continue;
+                        }
+                        size += "__size += " + name + ".size();\n";
+                        write_call(rebind, "std::copy", name + ".begin()", name + ".end()", "__dst") += ";\n";
+                        rebind += name + " = std::string_view(__dst, " + name + ".size());\n";
+                        rebind += "__dst += " + name + ".size();\n";
+                    }
+                    else if (param->type == ParamType::custom && record.cargos.count(castptr<Custom>(param)->cargoname)) {
+                        if (param->repeat) {
+                            size += "for (auto& __v : " + name + ") {\n__size += __v.view_size();\n}\n";
+                            rebind += "for (auto& __v : " + name + ") {\n__v.rebind_view(__dst);\n}\n";
+                            continue;
+                        }
+                        size += "__size += " + name + ".view_size();\n";
+                        rebind += name + ".rebind_view(__dst);\n";
+                    }
+                }
+                owned += "\nstd::size_t view_size() const {\n";
+                owned += size;
+                write_return(owned, "__size");
+                write_endblock(owned);
+                // cargo without viewed bytes has nothing to rebind
+                owned += std::string("\nvoid rebind_view(") + (rebind.size() ? "" : "[[maybe_unused]] ") + "char*& __dst) {\n";
+                owned += rebind;
+                write_endblock(owned);
+                auto type = ctx.helper_namespace() + "::owned<" + cargo.name + ">";
+                owned += "\n" + type + " to_owned() const {\n";
+                owned += type + " __ret{std::make_unique<char[]>(view_size()), *this};\n";
+                owned += "char* __dst = __ret.storage.get();\n";
+                owned += "__ret.value.rebind_view(__dst);\n";
+                write_return(owned, "__ret");
+                write_endblock(owned);
+                return true;
+            }
+
+            // in pmr mode, generates allocator_type constructor
+            // which passes allocator to owned byte, nested cargo and base cargo
+            static bool get_allocator_ctor(CppOutContext& ctx, std::string& ctor, Cargo& cargo, Record& record) {
+                if (!ctx.pmr || ctx.byte_view) {
+                    return true;
+                }
+                std::string init;
+                auto add = [&](const std::string& name) {
+                    init += init.size() ? ", " : "\n: ";
+                    init += name + "(__alloc)";
+                };
+                if (cargo.base.basename.size()) {
+                    add(cargo.base.basename);
+                }
+                for (auto& param : cargo.params) {
+                    std::string tyname;
+                    size_t bylen = 0;
+                    if (!get_typename(tyname, ctx, param, bylen, record)) {
+                        return false;
+                    }
+                    if ((param->type == ParamType::byte && bylen == 0) || param->repeat ||
+                        (param->type == ParamType::custom && record.cargos.count(castptr<Custom>(param)->cargoname))) {
+                        add(param->name);
+                    }
+                }
+                ctor += "using allocator_type = std::pmr::polymorphic_allocator<char>;\n\n";
+                ctor += cargo.name + "() {}\n\n";
+                ctor += "explicit " + cargo.name + (init.size() ? "(allocator_type __alloc)" : "(allocator_type)") + init + " {}\n\n";
+                // uses-allocator construction (element of pmr::vector) copies or moves with allocator
+                ctor += cargo.name + "(const " + cargo.name + "& __other, allocator_type __alloc)\n: " + cargo.name + "(__alloc) {\n*this = __other;\n}\n\n";
+                ctor += cargo.name + "(" + cargo.name + "&& __other, allocator_type __alloc)\n: " + cargo.name + "(__alloc) {\n*this = std::move(__other);\n}\n\n";
+                return true;
+            }
+
             static bool convert(CppOutContext& ctx, Cargo& cargo, Record& record) {
-                std::string def, getter, setter;
+                std::string def, ctor, getter, setter, decode, encode, owned, lazy, compare, hashspec, random;
+                std::map<std::string, std::string> types;
                 for (auto i = 0; i < cargo.params.size(); i++) {
                     if (!get_definitions(ctx, def, getter, setter, cargo.params[i], cargo, record)) {
                         return false;
                     }
+                    size_t bylen = 0;
+                    get_typename(types[cargo.params[i]->name], ctx, cargo.params[i], bylen, record);
+                }
+                if (!ReadToCppDecode::convert(ctx, decode, cargo, record)) {
+                    return false;
+                }
+                if (!WriteToCppEncode::convert(ctx, encode, cargo, record)) {
+                    return false;
+                }
+                if (!get_owned(ctx, owned, cargo, record)) {
+                    return false;
+                }
+                if (!get_allocator_ctor(ctx, ctor, cargo, record)) {
+                    return false;
+                }
+                if (!CargoToLazy::convert(ctx, lazy, cargo, record, types)) {
+                    return false;
+                }
+                if (!CargoToCompare::convert(ctx, compare, hashspec, cargo, record)) {
+                    return false;
+                }
+                if (!CargoToRandom::convert(ctx, random, cargo, record)) {
+                    return false;
                 }
                 ctx.write("\nstruct ");
                 ctx.write(cargo.name);
@@ -211,9 +400,21 @@ namespace binred {
                 ctx.write(" {\nprivate:\n\n");
                 ctx.write(def);
                 ctx.write("\npublic:\n\n");
+                if (auto fixed = get_fixed_size(cargo, record); fixed.second) {
+                    ctx.write("static constexpr std::size_t fixed_size = " + std::to_string(fixed.first) + ";\n\n");
+                }
+                ctx.write("struct Lazy;\n\n");
+                ctx.write(ctor);
                 ctx.write(getter);
                 ctx.write(setter);
+                ctx.write(decode);
+                ctx.write(encode);
+                ctx.write(owned);
+                ctx.write(compare);
+                ctx.write(random);
                 ctx.write("};\n");
+                ctx.write(lazy);
+                ctx.write(hashspec);
                 return true;
             }
         };
@@ -0,0 +1,98 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#pragma once
+
+#include "../../parse/parser/parse.h"
+#include "output_context.h"
+#include "io_common.h"
+
+namespace binred {
+    namespace cpp {
+        // ChecksumField generates checksum of param with checksum decoration
+        // decoder verifies it and encoder writes computed value instead of member
+        // start of covered range is kept in __sum_<param>, which is offset in buffer
+        // or index of first segment in iov mode
+        struct ChecksumField : IOCommon {
+            static std::string function(CppOutContext& ctx, std::shared_ptr<Param>& param) {
+                ctx.use_checksum = true;
+                return ctx.helper_namespace() + "::" + param->checksum->algo;
+            }
+
+            static std::string initial(std::shared_ptr<Param>& param) {
+                return param->checksum->algo == "adler32" ? "1" : "0";
+            }
+
+            static std::string start(std::shared_ptr<Param>& param) {
+                return "__sum_" + param->name;
+            }
+
+            static bool has_checksum(Cargo& cargo) {
+                for (auto& p : cargo.params) {
+                    if (p->checksum) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            // in iov mode, scratch is flushed so that covered range begins at segment boundary
+            static std::string current(CppOutContext& ctx, std::string& buf, Cargo& cargo, bool iov) {
+                if (!iov) {
+                    return "__pos";
+                }
+                write_check(ctx, buf, "!__o.flush(__pos)", cargo.name + "_iov_count");
+                return "__o.count";
+            }
+
+            // write_begin declares range start of every checksum at start of cargo
+            static void write_begin(CppOutContext& ctx, std::string& buf, Cargo& cargo, bool iov = false) {
+                if (!has_checksum(cargo)) {
+                    return;
+                }
+                auto pos = current(ctx, buf, cargo, iov);
+                for (auto& p : cargo.params) {
+                    if (p->checksum) {
+                        buf += "std::size_t " + start(p) + " = " + pos + ";\n";
+                    }
+                }
+            }
+
+            // write_mark moves range start of checksum which covers from param name
+            static void write_mark(CppOutContext& ctx, std::string& buf, Cargo& cargo, const std::string& name, bool iov = false) {
+                std::string pos;
+                for (auto& p : cargo.params) {
+                    if (p->checksum && p->checksum->from == name) {
+                        if (pos.empty()) {
+                            pos = current(ctx, buf, cargo, iov);
+                        }
+                        buf += start(p) + " = " + pos + ";\n";
+                    }
+                }
+            }
+
+            // write_verify is called after checksum param is read
+            static void write_verify(CppOutContext& ctx, std::string& buf, std::shared_ptr<Param>& param, Cargo& cargo, const std::string& sum) {
+                write_check(ctx, buf, param->name + " != " + sum, cargo.name + "_" + param->name + "_checksum");
+            }
+
+            static std::string decoded_sum(CppOutContext& ctx, std::shared_ptr<Param>& param, size_t len) {
+                auto from = start(param);
+                return function(ctx, param) + "(" + initial(param) + ", __p + " + from + ", __pos - " + std::to_string(len) + " - " + from + ")";
+            }
+
+            static std::string encoded_sum(CppOutContext& ctx, std::string& buf, std::shared_ptr<Param>& param, Cargo& cargo, bool iov) {
+                auto from = start(param);
+                if (iov) {
+                    current(ctx, buf, cargo, iov);
+                    return ctx.helper_namespace() + "::iov_checksum(__o, " + from + ", " + initial(param) + ", " + function(ctx, param) + ")";
+                }
+                return function(ctx, param) + "(" + initial(param) + ", __out + " + from + ", __pos - " + from + ")";
+            }
+        };
+    }  // namespace cpp
+}  // namespace binred
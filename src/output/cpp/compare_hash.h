@@ -0,0 +1,198 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#pragma once
+
+#include "../../parse/parser/parse.h"
+#include "output_context.h"
+#include "../../calc/get_const.h"
+#include "../common/fixed_layout.h"
+#include "io_common.h"
+#include "fixed_codec.h"
+
+namespace binred {
+    namespace cpp {
+        // CargoToCompare generates operator==, operator<=> and hash() in compare mode
+        // operator== checks cheap fields first so that unequal values fail early
+        // operator<=> orders by declared fields (base cargo first)
+        // hash of fixed layout cargo is taken over packed bytes written by encode_fixed
+        // complex type must have ==, <=> (std::strong_ordering) and std::hash
+        struct CargoToCompare : IOCommon {
+            struct Field {
+                std::string name;
+                int cost = 0;
+                std::string eq, cmp, hash;
+            };
+
+            static bool get_field(CppOutContext& ctx, Field& f, std::shared_ptr<Param>& param, Cargo& cargo, Record& record) {
+                auto& name = param->name;
+                auto rt = ctx.helper_namespace();
+                auto other = "__o." + name;
+                f.name = name;
+                f.eq = name + " == " + other;
+                f.cmp = name + " <=> " + other;
+                auto bytes = [&](const std::string& data, const std::string& size) {
+                    return "__h = " + rt + "::hash_bytes(reinterpret_cast<const std::uint8_t*>(" + data + "), " + size + ", __h);\n";
+                };
+                if (param->repeat) {
+                    f.cost = 3;
+                    if (param->type == ParamType::custom) {
+                        f.hash = "__h = " + rt + "::hash_word(__h, " + name + ".size());\n";
+                        f.hash += "for (auto& __v : " + name + ") {\n__h = __v.hash(__h);\n}\n";
+                    }
+                    else {
+                        f.hash = bytes(name + ".data()", name + ".size() * sizeof(" + name + "[0])");
+                    }
+                    return true;
+                }
+                switch (param->type) {
+                    case ParamType::integer:
+                    case ParamType::uint:
+                    case ParamType::varint:
+                    case ParamType::leb128:
+                    case ParamType::zigzag:
+                        f.hash = "__h = " + rt + "::hash_word(__h, std::uint64_t(" + name + "));\n";
+                        return true;
+                    case ParamType::bit: {
+                        BitField bits;
+                        if (!get_bitfield(cargo, name, bits)) {
+                            f.hash = "__h = " + rt + "::hash_word(__h, std::uint64_t(" + name + "));\n";
+                            return true;
+                        }
+                        // packed word is compared once by param which owns it
+                        f.cmp = "get_" + name + "() <=> __o.get_" + name + "()";
+                        if (bits.first) {
+                            f.eq = bits.storage + " == __o." + bits.storage;
+                            f.hash = "__h = " + rt + "::hash_word(__h, std::uint64_t(" + bits.storage + "));\n";
+                        }
+                        else {
+                            f.eq.clear();
+                        }
+                        return true;
+                    }
+                    case ParamType::byte: {
+                        auto len = get_const_int<size_t>(length_expr(param));
+                        if (ctx.allow_fixed() && len.second && len.first != 0) {
+                            auto size = std::to_string(len.first);
+                            f.cost = 1;
+                            f.eq = "::memcmp(" + name + ", " + other + ", " + size + ") == 0";
+                            f.cmp = "::memcmp(" + name + ", " + other + ", " + size + ") <=> 0";
+                            f.hash = bytes(name, size);
+                        }
+                        else {
+                            f.cost = 2;
+                            f.hash = bytes("std::data(" + name + ")", "std::size(" + name + ")");
+                        }
+                        return true;
+                    }
+                    case ParamType::custom: {
+                        auto found = record.cargos.find(castptr<Custom>(param)->cargoname);
+                        if (found == record.cargos.end()) {
+                            // complex type
+                            f.cost = 2;
+                            f.hash = "__h = " + rt + "::hash_word(__h, std::uint64_t(std::hash<std::remove_cvref_t<decltype(" + name + ")>>{}(" + name + ")));\n";
+                            return true;
+                        }
+                        f.cost = get_fixed_size(*found->second, record).second ? 1 : 2;
+                        f.hash = "__h = " + name + ".hash(__h);\n";
+                        return true;
+                    }
+                    default:
+                        return false;
+                }
+            }
+
+            // after receives std::hash specialization written outside of struct
+            static bool convert(CppOutContext& ctx, std::string& buf, std::string& after, Cargo& cargo, Record& record) {
+                if (!ctx.compare) {
+                    return true;
+                }
+                std::vector<Field> fields;
+                for (auto& param : cargo.params) {
+                    Field f;
+                    if (!get_field(ctx, f, param, cargo, record)) {
+                        return false;
+                    }
+                    fields.push_back(std::move(f));
+                }
+                auto& basename = cargo.base.basename;
+                buf += "\nbool operator==(const " + cargo.name + "& __o) const {\n";
+                std::vector<Field*> order;
+                for (auto& f : fields) {
+                    order.push_back(&f);
+                }
+                std::stable_sort(order.begin(), order.end(), [](Field* a, Field* b) {
+                    return a->cost < b->cost;
+                });
+                bool base_done = basename.empty();
+                for (auto f : order) {
+                    if (!base_done && f->cost >= 2) {
+                        // base part is compared before variable length fields of this cargo
+                        write_check_false(buf, basename + "::operator==(__o)");
+                        base_done = true;
+                    }
+                    if (f->eq.size()) {
+                        write_check_false(buf, f->eq);
+                    }
+                }
+                if (!base_done) {
+                    write_check_false(buf, basename + "::operator==(__o)");
+                }
+                write_return(buf, "true");
+                write_endblock(buf);
+                buf += "\nstd::strong_ordering operator<=>(const " + cargo.name + "& __o) const {\n";
+                auto write_cmp = [&](const std::string& cmp) {
+                    write_if(buf, "auto __c = " + cmp + "; __c != 0");
+                    write_beginblock(buf);
+                    write_return(buf, "__c");
+                    write_endblock(buf);
+                };
+                if (basename.size()) {
+                    write_cmp(basename + "::operator<=>(__o)");
+                }
+                for (auto& f : fields) {
+                    write_cmp(f.cmp);
+                }
+                write_return(buf, "std::strong_ordering::equal");
+                write_endblock(buf);
+                buf += "\nstd::uint64_t hash(std::uint64_t __seed = 0) const {\n";
+                std::string unused;
+                if (get_fixed_size(cargo, record).second && FixedCodec::convert(ctx, unused, unused, cargo, record)) {
+                    buf += "std::uint8_t __b[fixed_size]{};\n";
+                    buf += "(void)encode_fixed(__b);\n";
+                    write_return(buf, ctx.helper_namespace() + "::hash_bytes(__b, fixed_size, __seed)");
+                }
+                else {
+                    if (basename.size()) {
+                        buf += "std::uint64_t __h = " + basename + "::hash(__seed);\n";
+                    }
+                    else {
+                        buf += "std::uint64_t __h = __seed;\n";
+                    }
+                    for (auto& f : fields) {
+                        buf += f.hash;
+                    }
+                    write_return(buf, "__h");
+                }
+                write_endblock(buf);
+                after += "\nnamespace std {\ntemplate <>\nstruct hash<" + cargo.name + "> {\n";
+                after += "std::size_t operator()(const " + cargo.name + "& __v) const noexcept {\n";
+                write_return(after, "std::size_t(__v.hash())");
+                write_endblock(after);
+                after += "};\n}  // namespace std\n";
+                return true;
+            }
+
+            static void write_check_false(std::string& buf, const std::string& eq) {
+                write_if(buf, write_not(eq));
+                write_beginblock(buf);
+                write_return(buf, "false");
+                write_endblock(buf);
+            }
+        };
+    }  // namespace cpp
+}  // namespace binred
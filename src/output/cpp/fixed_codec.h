@@ -0,0 +1,221 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#pragma once
+
+#include "../../parse/parser/parse.h"
+#include "output_context.h"
+#include "../../calc/get_const.h"
+#include "../../calc/trace_expr.h"
+#include "../common/fixed_layout.h"
+#include "io_common.h"
+
+namespace binred {
+    namespace cpp {
+        // FixedCodec generates decode_fixed/encode_fixed for cargo which has fixed_size
+        // caller guarantees fixed_size bytes are available so every field is
+        // accessed at constant offset without per-field length check
+        struct FixedCodec : IOCommon {
+            static bool is_word(size_t len) {
+                return len == 1 || len == 2 || len == 4 || len == 8;
+            }
+
+            // native load reads word already byte-swapped by swap_mask
+            // little endian word is left as is by swap_mask so it is also read by load_ne
+            static std::string load(CppOutContext& ctx, size_t len, size_t offset, bool native, bool little = false) {
+                auto off = std::to_string(offset);
+                if (is_word(len)) {
+                    auto fn = native ? "::load_ne<" : little ? "::load_le<" : "::load_be<";
+                    return ctx.helper_namespace() + fn + storage_type(len * 8) + ">(__p + " + off + ")";
+                }
+                std::string ret;
+                for (size_t i = 0; i < len; i++) {
+                    if (i != 0) {
+                        ret += " | ";
+                    }
+                    auto shift = little ? i : len - i - 1;
+                    ret += "(std::uint64_t(__p[" + std::to_string(offset + i) + "]) << " + std::to_string(shift * 8) + ")";
+                }
+                return ret;
+            }
+
+            static std::string store(CppOutContext& ctx, size_t len, size_t offset, const std::string& value, bool little = false) {
+                auto off = std::to_string(offset);
+                if (is_word(len)) {
+                    auto type = storage_type(len * 8);
+                    auto fn = little ? "::store_le<" : "::store_be<";
+                    return ctx.helper_namespace() + fn + type + ">(__out + " + off + ", " + type + "(" + value + "));\n";
+                }
+                std::string ret;
+                for (size_t i = 0; i < len; i++) {
+                    auto shift = little ? i : len - i - 1;
+                    ret += "__out[" + std::to_string(offset + i) + "] = std::uint8_t(std::uint64_t(" + value + ") >> " + std::to_string(shift * 8) + ");\n";
+                }
+                return ret;
+            }
+
+            // swap_mask sets shuffle index which reverses every word loaded by load_be
+            // other bytes (including little endian word) are left in place
+            static void swap_mask(Cargo& cargo, Record& record, size_t base, std::vector<size_t>& mask) {
+                size_t offset = base;
+                auto reverse = [&](size_t len) {
+                    if (is_word(len)) {
+                        std::reverse(mask.begin() + offset, mask.begin() + offset + len);
+                    }
+                    offset += len;
+                };
+                for (auto& param : cargo.params) {
+                    if (param->type == ParamType::custom) {
+                        auto& sub = *record.cargos.at(castptr<Custom>(param)->cargoname);
+                        swap_mask(sub, record, offset, mask);
+                        offset += get_fixed_size(sub, record).first;
+                        continue;
+                    }
+                    auto len = get_const_int<size_t>(length_expr(param)).first;
+                    if (param->type == ParamType::bit) {
+                        BitField bits;
+                        if (get_bitfield(cargo, param->name, bits) && bits.first) {
+                            reverse(bits.total / 8);
+                        }
+                        continue;
+                    }
+                    if (param->type == ParamType::byte || little_endian(cargo, param)) {
+                        offset += len;
+                        continue;
+                    }
+                    reverse(len);
+                }
+            }
+
+            // decode_many decodes array of cargo at once
+            // records fitting in 16 byte are byte-swapped by one shuffle per record
+            static void write_decode_many(CppOutContext& ctx, std::string& buf, Cargo& cargo, Record& record) {
+                auto size = get_fixed_size(cargo, record).first;
+                if (size == 0 || size > 16) {
+                    return;
+                }
+                ctx.use_decode_many = true;
+                std::vector<size_t> mask;
+                for (size_t i = 0; i < 16; i++) {
+                    mask.push_back(i < size ? i : 0x80);
+                }
+                swap_mask(cargo, record, 0, mask);
+                buf += "\nstatic constexpr std::uint8_t swap_mask[16] = {";
+                for (size_t i = 0; i < 16; i++) {
+                    if (i != 0) {
+                        buf += ", ";
+                    }
+                    buf += std::to_string(mask[i]);
+                }
+                buf += "};\n";
+                buf += "\nstatic " + ctx.error_enum() + " decode_many(const std::uint8_t* __p, std::size_t __count, " + cargo.name + "* __out) {\n";
+                write_return(buf, ctx.helper_namespace() + "::decode_many(__p, __count, __out)");
+                write_endblock(buf);
+            }
+
+            // convert writes decode_fixed to decbuf and encode_fixed to encbuf
+            // if native is true decode_native which reads input swapped by swap_mask is written instead
+            // returns false if layout can not be accessed at constant offset
+            static bool convert(CppOutContext& ctx, std::string& decbuf, std::string& encbuf, Cargo& cargo, Record& record, bool native = false) {
+                if (!get_fixed_size(cargo, record).second) {
+                    return false;
+                }
+                std::string current;
+                auto formatter = format_alias_and_cargo(record, current, cargo);
+                std::string dec, enc;
+                size_t offset = 0;
+                for (auto& param : cargo.params) {
+                    auto& name = param->name;
+                    if (param->type == ParamType::custom) {
+                        auto found = record.cargos.find(castptr<Custom>(param)->cargoname);
+                        if (found == record.cargos.end()) {
+                            return false;
+                        }
+                        std::string subdec, subenc;
+                        if (!convert(ctx, subdec, subenc, *found->second, record, native)) {
+                            return false;
+                        }
+                        auto sub = get_fixed_size(*found->second, record);
+                        auto off = std::to_string(offset);
+                        auto fn = native ? ".decode_native(__p + " : ".decode_fixed(__p + ";
+                        write_if(dec, "auto __e = " + name + fn + off + "); __e != " + ctx.error_enum() + "::none");
+                        write_beginblock(dec);
+                        write_return(dec, "__e");
+                        write_endblock(dec);
+                        write_if(enc, "auto __e = " + name + ".encode_fixed(__out + " + off + "); __e != " + ctx.error_enum() + "::none");
+                        write_beginblock(enc);
+                        write_return(enc, "__e");
+                        write_endblock(enc);
+                        offset += sub.first;
+                        continue;
+                    }
+                    auto len = get_const_int<size_t>(length_expr(param));
+                    if (!len.second) {
+                        return false;
+                    }
+                    if (param->type == ParamType::bit) {
+                        BitField bits;
+                        if (!get_bitfield(cargo, name, bits)) {
+                            return false;
+                        }
+                        write_param_check(ctx, enc, param, cargo, formatter);
+                        if (bits.first) {
+                            auto bytes = bits.total / 8;
+                            dec += bits.storage + " = " + storage_type(bits.storage_bits) + "(" + load(ctx, bytes, offset, native) + ");\n";
+                            enc += store(ctx, bytes, offset, bits.storage);
+                            offset += bytes;
+                        }
+                        continue;
+                    }
+                    if (param->type == ParamType::byte) {
+                        auto off = std::to_string(offset);
+                        auto lenstr = std::to_string(len.first);
+                        if (ctx.allow_fixed() && len.first != 0) {
+                            write_call(dec, "::memcpy", name, "__p + " + off, lenstr) += ";\n";
+                            write_call(enc, "::memcpy", "__out + " + off, name, lenstr) += ";\n";
+                        }
+                        else {
+                            dec += ctx.set_byte_from_input(name, "__p + " + off, lenstr);
+                            write_check(ctx, enc, ctx.length_of_byte(name) + " != " + lenstr, cargo.name + "_" + name + "_length");
+                            write_call(enc, "::memcpy", "__out + " + off, "std::data(" + name + ")", lenstr) += ";\n";
+                        }
+                        offset += len.first;
+                        continue;
+                    }
+                    if (len.first == 0 || len.first > 8) {
+                        return false;
+                    }
+                    auto little = little_endian(cargo, param);
+                    auto value = load(ctx, len.first, offset, native, little);
+                    if (param->type == ParamType::integer && !is_word(len.first)) {
+                        auto shift = std::to_string(64 - len.first * 8);
+                        value = "std::int64_t(std::uint64_t(" + value + ") << " + shift + ") >> " + shift;
+                    }
+                    dec += name + " = decltype(" + name + ")(" + value + ");\n";
+                    write_param_check(ctx, enc, param, cargo, formatter);
+                    enc += store(ctx, len.first, offset, name, little);
+                    offset += len.first;
+                }
+                // bind is checked after all fields are loaded
+                std::string check;
+                for (auto& param : cargo.params) {
+                    write_param_check(ctx, check, param, cargo, formatter);
+                }
+                decbuf += "\n" + ctx.error_enum() + (native ? " decode_native" : " decode_fixed") + "(const std::uint8_t* __p) {\n";
+                decbuf += dec;
+                decbuf += check;
+                write_return(decbuf, ctx.error_enum() + "::none");
+                write_endblock(decbuf);
+                encbuf += "\n" + ctx.error_enum() + " encode_fixed(std::uint8_t* __out) const {\n";
+                encbuf += enc;
+                write_return(encbuf, ctx.error_enum() + "::none");
+                write_endblock(encbuf);
+                return true;
+            }
+        };
+    }  // namespace cpp
+}  // namespace binred
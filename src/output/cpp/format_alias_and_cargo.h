@@ -12,6 +12,7 @@
 #include "../../calc/trace_expr.h"
 #include "../../calc/cast_ptr.h"
 #include "../common/make_lambda.h"
+#include "bit_field.h"
 
 namespace binred {
     namespace cpp {
@@ -38,6 +39,11 @@ namespace binred {
                                 return true;
                             }
                         }
+                        BitField bits;
+                        if (get_bitfield(cargo, p->v, bits)) {
+                            ret += "get_" + p->v + "()";
+                            return true;
+                        }
                     }
                     else {
                         if (splt.size() == 2) {
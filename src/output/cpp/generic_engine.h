@@ -0,0 +1,569 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#pragma once
+#include "output_context.h"
+
+namespace binred {
+    namespace cpp {
+        // template engine used by generic mode (CargoToGeneric)
+        // output once after runtime helper and error enum
+        // each cargo has schema<T> specialization with constexpr tuple of field descriptors,
+        // decode/encode walk the tuple by fold expression so compiler inlines every field
+        std::string generic_engine(CppOutContext& ctx) {
+            auto err = ctx.error_enum();
+            auto rt = ctx.helper_namespace();
+            std::string ret = R"(
+#ifndef BINRED_GENERIC_ENGINE
+#define BINRED_GENERIC_ENGINE
+#include <string_view>
+#include <tuple>
+namespace )" + ctx.generic_namespace() +
+                              R"( {
+template <class T>
+struct schema;
+
+// reader reports short_input of cargo being decoded
+struct reader {
+const std::uint8_t* p;
+std::size_t n;
+std::size_t pos;
+)" + err + R"( short_input;
+};
+
+struct writer {
+std::uint8_t* p;
+std::size_t pos;
+};
+
+constexpr std::uint64_t bit_mask(std::size_t width) {
+return width == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << width) - 1;
+}
+
+template <std::size_t N>
+using word_t = std::conditional_t<N == 1, std::uint8_t, std::conditional_t<N == 2, std::uint16_t, std::conditional_t<N == 4, std::uint32_t, std::uint64_t>>>;
+
+// codec reads and writes one value, also used for element of repeated field
+template <std::size_t N, bool Little, bool Signed>
+struct integer_codec {
+static constexpr std::size_t width = N;
+static constexpr bool word = N == 1 || N == 2 || N == 4 || N == 8;
+
+template <class U>
+static )" + err + R"( decode(U& out, reader& r) {
+if (r.n - r.pos < N) {
+return r.short_input;
+}
+if constexpr (word) {
+using W = word_t<N>;
+out = U(Little ? )" + rt + R"(::load_le<W>(r.p + r.pos) : )" + rt + R"(::load_be<W>(r.p + r.pos));
+}
+else {
+auto v = Little ? )" + rt + R"(::load_le_bytes(r.p + r.pos, N) : )" + rt + R"(::load_be_bytes(r.p + r.pos, N);
+if constexpr (Signed) {
+v = std::uint64_t(std::int64_t(v << (64 - N * 8)) >> (64 - N * 8));
+}
+out = U(v);
+}
+r.pos += N;
+return )" + err + R"(::none;
+}
+
+// load_array decodes count words at once if element has same size
+template <class U>
+static void load_array(U* out, const std::uint8_t* p, std::size_t count) {
+if constexpr (Little) {
+)" + rt + R"(::load_le_array(out, p, count);
+}
+else {
+)" + rt + R"(::load_be_array(out, p, count);
+}
+}
+
+template <class U>
+static std::size_t size(const U&) {
+return N;
+}
+
+template <class U>
+static )" + err + R"( encode(const U& v, writer& w) {
+if constexpr (word) {
+using W = word_t<N>;
+if constexpr (Little) {
+)" + rt + R"(::store_le(w.p + w.pos, W(v));
+}
+else {
+)" + rt + R"(::store_be(w.p + w.pos, W(v));
+}
+}
+else if constexpr (Little) {
+)" + rt + R"(::store_le_bytes(w.p + w.pos, std::uint64_t(v), N);
+}
+else {
+)" + rt + R"(::store_be_bytes(w.p + w.pos, std::uint64_t(v), N);
+}
+w.pos += N;
+return )" + err + R"(::none;
+}
+};
+
+template <)" + err + R"( Range>
+struct varint_codec {
+template <class U>
+static )" + err + R"( decode(U& out, reader& r) {
+if (r.n - r.pos < 1) {
+return r.short_input;
+}
+auto len = )" + rt + R"(::varint_length(r.p[r.pos]);
+if (r.n - r.pos < len) {
+return r.short_input;
+}
+out = U()" + rt + R"(::load_varint(r.p + r.pos, r.n - r.pos));
+r.pos += len;
+return )" + err + R"(::none;
+}
+
+template <class U>
+static std::size_t size(const U& v) {
+return )" + rt + R"(::varint_size(v);
+}
+
+template <class U>
+static )" + err + R"( encode(const U& v, writer& w) {
+if (v > )" + rt + R"(::varint_max) {
+return Range;
+}
+w.pos += )" + rt + R"(::store_varint(w.p + w.pos, v);
+return )" + err + R"(::none;
+}
+};
+
+template <)" + err + R"( Overflow, bool Zigzag>
+struct leb128_codec {
+template <class U>
+static )" + err + R"( decode(U& out, reader& r) {
+auto len = )" + rt + R"(::leb128_length(r.p + r.pos, r.n - r.pos);
+if (len == 0) {
+return Overflow;
+}
+if (r.n - r.pos < len) {
+return r.short_input;
+}
+auto v = )" + rt + R"(::load_leb128(r.p + r.pos, len);
+if constexpr (Zigzag) {
+out = U()" + rt + R"(::zigzag_decode(v));
+}
+else {
+out = U(v);
+}
+r.pos += len;
+return )" + err + R"(::none;
+}
+
+static std::uint64_t raw(std::uint64_t v) {
+if constexpr (Zigzag) {
+return )" + rt + R"(::zigzag_encode(std::int64_t(v));
+}
+return v;
+}
+
+template <class U>
+static std::size_t size(const U& v) {
+return )" + rt + R"(::leb128_size(raw(std::uint64_t(v)));
+}
+
+template <class U>
+static )" + err + R"( encode(const U& v, writer& w) {
+w.pos += )" + rt + R"(::store_leb128(w.p + w.pos, raw(std::uint64_t(v)));
+return )" + err + R"(::none;
+}
+};
+
+template <class T>
+)" + err + R"( decode_fields(T& v, reader& r);
+
+template <class T>
+std::size_t size_fields(const T& v);
+
+template <class T>
+)" + err + R"( encode_fields(const T& v, writer& w);
+
+struct cargo_codec {
+template <class U>
+static )" + err + R"( decode(U& out, reader& r) {
+return decode_fields(out, r);
+}
+
+template <class U>
+static std::size_t size(const U& v) {
+return size_fields(v);
+}
+
+template <class U>
+static )" + err + R"( encode(const U& v, writer& w) {
+return encode_fields(v, w);
+}
+};
+
+// field descriptors take cargo object and access member by pointer
+template <auto M, class Codec>
+struct value {
+template <class T>
+)" + err + R"( decode(T& v, reader& r) const {
+return Codec::decode(v.*M, r);
+}
+
+template <class T>
+std::size_t size(const T& v) const {
+return Codec::size(v.*M);
+}
+
+template <class T>
+)" + err + R"( encode(const T& v, writer& w) const {
+return Codec::encode(v.*M, w);
+}
+};
+
+template <auto M, std::size_t W>
+struct bit {
+static constexpr auto member = M;
+static constexpr std::size_t width = W;
+};
+
+// bits is run of bit params stored in Bytes big endian bytes from most significant bit
+template <std::size_t Bytes, class... B>
+struct bits {
+template <class T>
+)" + err + R"( decode(T& v, reader& r) const {
+if (r.n - r.pos < Bytes) {
+return r.short_input;
+}
+auto word = )" + rt + R"(::load_be_bytes(r.p + r.pos, Bytes);
+std::size_t shift = Bytes * 8;
+((shift -= B::width, v.*B::member = std::remove_reference_t<decltype(v.*B::member)>((word >> shift) & bit_mask(B::width))), ...);
+r.pos += Bytes;
+return )" + err + R"(::none;
+}
+
+template <class T>
+std::size_t size(const T&) const {
+return Bytes;
+}
+
+template <class T>
+)" + err + R"( encode(const T& v, writer& w) const {
+std::uint64_t word = 0;
+std::size_t shift = Bytes * 8;
+((shift -= B::width, word |= (std::uint64_t(v.*B::member) & bit_mask(B::width)) << shift), ...);
+)" + rt + R"(::store_be_bytes(w.p + w.pos, word, Bytes);
+w.pos += Bytes;
+return )" + err + R"(::none;
+}
+};
+
+template <auto M, std::size_t N>
+struct fixed_bytes {
+template <class T>
+)" + err + R"( decode(T& v, reader& r) const {
+if (r.n - r.pos < N) {
+return r.short_input;
+}
+::memcpy(v.*M, r.p + r.pos, N);
+r.pos += N;
+return )" + err + R"(::none;
+}
+
+template <class T>
+std::size_t size(const T&) const {
+return N;
+}
+
+template <class T>
+)" + err + R"( encode(const T& v, writer& w) const {
+::memcpy(w.p + w.pos, v.*M, N);
+w.pos += N;
+return )" + err + R"(::none;
+}
+};
+
+template <auto M, )" + err + R"( Length, class Len>
+struct bytes_field {
+Len len;
+
+template <class T>
+)" + err + R"( decode(T& v, reader& r) const {
+std::size_t l = len(v);
+if (r.n - r.pos < l) {
+return r.short_input;
+}
+using B = std::remove_reference_t<decltype(v.*M)>;
+if constexpr (std::is_same_v<B, std::string_view>) {
+v.*M = B(reinterpret_cast<const char*>(r.p + r.pos), l);
+}
+else {
+(v.*M).assign(reinterpret_cast<const char*>(r.p + r.pos), l);
+}
+r.pos += l;
+return )" + err + R"(::none;
+}
+
+template <class T>
+std::size_t size(const T& v) const {
+return std::size(v.*M);
+}
+
+template <class T>
+)" + err + R"( encode(const T& v, writer& w) const {
+auto l = std::size(v.*M);
+if (l != len(v)) {
+return Length;
+}
+if (l) {
+::memcpy(w.p + w.pos, std::data(v.*M), l);
+}
+w.pos += l;
+return )" + err + R"(::none;
+}
+};
+
+template <auto M, )" + err + R"( Length, class Len>
+constexpr bytes_field<M, Length, Len> bytes(Len len) {
+return {len};
+}
+
+// repeated field has count of elements, or byte length if Bytes is true
+template <auto M, class Codec, bool Bytes, )" + err + R"( Length, class Len>
+struct repeat_field {
+Len len;
+
+template <class T>
+)" + err + R"( decode(T& v, reader& r) const {
+auto& vec = v.*M;
+using E = typename std::remove_reference_t<decltype(vec)>::value_type;
+std::size_t l = len(v);
+vec.clear();
+if constexpr (Bytes) {
+if (r.n - r.pos < l) {
+return r.short_input;
+}
+// elements must fill l bytes exactly
+reader sub{r.p, r.pos + l, r.pos, Length};
+while (sub.pos < sub.n) {
+auto prev = sub.pos;
+if (auto e = Codec::decode(vec.emplace_back(), sub); e != )" + err + R"(::none) {
+return e;
+}
+// element which takes no byte would repeat forever
+if (sub.pos == prev) {
+return Length;
+}
+}
+r.pos = sub.pos;
+}
+else {
+if constexpr (requires { Codec::width; }) {
+if constexpr (Codec::word && sizeof(E) == Codec::width) {
+if ((r.n - r.pos) / sizeof(E) < l) {
+return r.short_input;
+}
+vec.resize(l);
+Codec::load_array(vec.data(), r.p + r.pos, l);
+r.pos += l * sizeof(E);
+return )" + err + R"(::none;
+}
+}
+// count is not trusted, so that reservation is limited by remaining bytes
+vec.reserve((std::min)(l, r.n - r.pos));
+for (std::size_t i = 0; i < l; i++) {
+if (auto e = Codec::decode(vec.emplace_back(), r); e != )" + err + R"(::none) {
+return e;
+}
+}
+}
+return )" + err + R"(::none;
+}
+
+template <class T>
+std::size_t size(const T& v) const {
+std::size_t s = 0;
+for (auto& e : v.*M) {
+s += Codec::size(e);
+}
+return s;
+}
+
+template <class T>
+)" + err + R"( encode(const T& v, writer& w) const {
+if ((Bytes ? size(v) : (v.*M).size()) != len(v)) {
+return Length;
+}
+for (auto& e : v.*M) {
+if (auto r = Codec::encode(e, w); r != )" + err + R"(::none) {
+return r;
+}
+}
+return )" + err + R"(::none;
+}
+};
+
+template <auto M, class Codec, bool Bytes, )" + err + R"( Length, class Len>
+constexpr repeat_field<M, Codec, Bytes, Length, Len> repeat(Len len) {
+return {len};
+}
+
+// when_field reads and writes field only if condition holds (if decoration)
+template <class Cond, class F>
+struct when_field {
+Cond cond;
+F field;
+
+template <class T>
+)" + err + R"( decode(T& v, reader& r) const {
+return cond(v) ? field.decode(v, r) : )" + err + R"(::none;
+}
+
+template <class T>
+std::size_t size(const T& v) const {
+return cond(v) ? field.size(v) : 0;
+}
+
+template <class T>
+)" + err + R"( encode(const T& v, writer& w) const {
+return cond(v) ? field.encode(v, w) : )" + err + R"(::none;
+}
+};
+
+template <class Cond, class F>
+constexpr when_field<Cond, F> when(Cond cond, F field) {
+return {cond, field};
+}
+
+// check_field tests bind decoration after decode and before encode
+template <)" + err + R"( Bind, class Pred, class F>
+struct check_field {
+Pred pred;
+F field;
+
+template <class T>
+)" + err + R"( decode(T& v, reader& r) const {
+if (auto e = field.decode(v, r); e != )" + err + R"(::none) {
+return e;
+}
+return pred(v) ? )" + err + R"(::none : Bind;
+}
+
+template <class T>
+std::size_t size(const T& v) const {
+return field.size(v);
+}
+
+template <class T>
+)" + err + R"( encode(const T& v, writer& w) const {
+return pred(v) ? field.encode(v, w) : Bind;
+}
+};
+
+template <)" + err + R"( Bind, class Pred, class F>
+constexpr check_field<Bind, Pred, F> check(Pred pred, F field) {
+return {pred, field};
+}
+
+// base cargo is decoded and encoded before own fields
+template <class T>
+)" + err + R"( decode_fields(T& v, reader& r) {
+using S = schema<T>;
+auto outer = r.short_input;
+r.short_input = S::short_input;
+)" + err + R"( e = )" + err + R"(::none;
+if constexpr (!std::is_void_v<typename S::base>) {
+e = decode_fields(static_cast<typename S::base&>(v), r);
+}
+if (e == )" + err + R"(::none) {
+std::apply([&](const auto&... f) {
+(void)(((e = f.decode(v, r)) == )" + err + R"(::none) && ...);
+},
+S::fields);
+}
+r.short_input = outer;
+return e;
+}
+
+template <class T>
+std::size_t size_fields(const T& v) {
+using S = schema<T>;
+std::size_t s = 0;
+if constexpr (!std::is_void_v<typename S::base>) {
+s = size_fields(static_cast<const typename S::base&>(v));
+}
+std::apply([&](const auto&... f) {
+((s += f.size(v)), ...);
+},
+S::fields);
+return s;
+}
+
+template <class T>
+)" + err + R"( encode_fields(const T& v, writer& w) {
+using S = schema<T>;
+)" + err + R"( e = )" + err + R"(::none;
+if constexpr (!std::is_void_v<typename S::base>) {
+e = encode_fields(static_cast<const typename S::base&>(v), w);
+}
+if (e == )" + err + R"(::none) {
+std::apply([&](const auto&... f) {
+(void)(((e = f.encode(v, w)) == )" + err + R"(::none) && ...);
+},
+S::fields);
+}
+return e;
+}
+
+template <class T>
+)" + err + R"( decode(T& v, const std::uint8_t* p, std::size_t n, std::size_t& pos) {
+reader r{p, n, pos, schema<T>::short_input};
+auto e = decode_fields(v, r);
+if (e == )" + err + R"(::none) {
+pos = r.pos;
+}
+return e;
+}
+
+template <class T>
+)" + err + R"( decode(T& v, const std::uint8_t* p, std::size_t n) {
+std::size_t pos = 0;
+return decode(v, p, n, pos);
+}
+
+template <class T>
+std::size_t encoded_size(const T& v) {
+return size_fields(v);
+}
+
+// out must have encoded_size(v) bytes from pos
+template <class T>
+)" + err + R"( encode_to(const T& v, std::uint8_t* out, std::size_t& pos) {
+writer w{out, pos};
+auto e = encode_fields(v, w);
+if (e == )" + err + R"(::none) {
+pos = w.pos;
+}
+return e;
+}
+
+template <class T>
+)" + err + R"( encode_to(const T& v, std::uint8_t* out) {
+std::size_t pos = 0;
+return encode_to(v, out, pos);
+}
+}  // namespace )" + ctx.generic_namespace() +
+                   R"(
+#endif
+)";
+            return ret;
+        }
+    }  // namespace cpp
+}  // namespace binred
@@ -0,0 +1,266 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#pragma once
+
+#include "../../parse/parser/parse.h"
+#include "output_context.h"
+#include "../../calc/get_const.h"
+#include "../../calc/trace_expr.h"
+#include "cargo_to_struct.h"
+#include "io_common.h"
+
+namespace binred {
+    namespace cpp {
+        // format_generic formats expression for generic mode
+        // member is accessed through prefix (e.g. "__v.") because expression is written in lambda
+        auto format_generic(Record& rec, Cargo& cargo, const std::string& prefix) {
+            auto f = [&, prefix](auto self, std::string& ret, std::shared_ptr<Expr> p, TraceMode m) {
+                if (p->kind == ExprKind::call) {
+                    auto c = castptr<CallExpr>(p);
+                    ret += c->v;
+                    ret += "(";
+                    for (size_t i = 0; i < c->args.size(); i++) {
+                        if (i != 0) {
+                            ret += ",";
+                        }
+                        ret += trace_expr(c->args[i], self, m);
+                    }
+                    ret += ")";
+                    return true;
+                }
+                if (p->kind != ExprKind::ref) {
+                    return false;
+                }
+                auto splt = commonlib2::split(p->v, ".");
+                if (splt.size() == 2) {
+                    auto found = rec.aliases.find(splt[0]);
+                    if (found != rec.aliases.end()) {
+                        ret += found->second->baseclass.size() ? found->second->baseclass : "std::uint64_t";
+                        ret += "(" + splt[0] + "::" + splt[1] + ")";
+                        return true;
+                    }
+                }
+                // members of base cargo are public in generic mode
+                ret += prefix;
+                for (size_t i = 0; i < splt.size(); i++) {
+                    if (i == 0 && splt.size() > 1 && splt[0] == cargo.base.selfname) {
+                        continue;
+                    }
+                    ret += splt[i];
+                    if (i + 1 != splt.size()) {
+                        ret += ".";
+                    }
+                }
+                return true;
+            };
+            return make_lambda(f);
+        }
+
+        // CargoToGeneric writes cargo as plain struct and schema<T> specialization
+        // whose fields tuple describes layout for generic_engine
+        // checksum, read/write command and complex type are not supported
+        struct CargoToGeneric : IOCommon {
+            static std::string error(CppOutContext& ctx, Cargo& cargo, std::shared_ptr<Param>& param, const char* suffix) {
+                auto err = cargo.name + "_" + param->name + suffix;
+                ctx.set_error_enum(err);
+                return ctx.error_enum() + "::" + err;
+            }
+
+            // constant expression does not refer __v
+            static std::string lambda(Cargo& cargo, const std::string& body) {
+                return "[]([[maybe_unused]] const " + cargo.name + "& __v) {\nreturn " + body + ";\n}";
+            }
+
+            static bool get_codec(CppOutContext& ctx, std::string& codec, std::shared_ptr<Param>& param, Cargo& cargo, Record& record) {
+                auto ns = ctx.generic_namespace() + "::";
+                switch (param->type) {
+                    case ParamType::integer:
+                    case ParamType::uint: {
+                        auto size = get_const_int<size_t>(length_expr(param));
+                        if (!size.second || size.first == 0 || size.first > 8) {
+                            return false;
+                        }
+                        codec = ns + "integer_codec<" + std::to_string(size.first) + ", " +
+                                (little_endian(cargo, param) ? "true" : "false") + ", " +
+                                (param->type == ParamType::integer ? "true" : "false") + ">";
+                        return true;
+                    }
+                    case ParamType::varint:
+                        codec = ns + "varint_codec<" + error(ctx, cargo, param, "_range") + ">";
+                        return true;
+                    case ParamType::leb128:
+                    case ParamType::zigzag:
+                        codec = ns + "leb128_codec<" + error(ctx, cargo, param, "_overflow") + ", " +
+                                (param->type == ParamType::zigzag ? "true" : "false") + ">";
+                        return true;
+                    case ParamType::custom:
+                        if (!record.cargos.count(castptr<Custom>(param)->cargoname)) {
+                            return false;
+                        }
+                        codec = ns + "cargo_codec";
+                        return true;
+                    default:
+                        return false;
+                }
+            }
+
+            static bool get_field(CppOutContext& ctx, std::string& field, std::shared_ptr<Param>& param, Cargo& cargo, Record& record, auto& formatter) {
+                auto ns = ctx.generic_namespace() + "::";
+                auto member = "&" + cargo.name + "::" + param->name;
+                if (param->checksum) {
+                    return false;
+                }
+                if (param->repeat) {
+                    std::string codec;
+                    if (!get_codec(ctx, codec, param, cargo, record)) {
+                        return false;
+                    }
+                    field = ns + "repeat<" + member + ", " + codec + ", " + (param->repeat->bytes ? "true" : "false") + ", " +
+                            error(ctx, cargo, param, "_length") + ">(" +
+                            lambda(cargo, "std::size_t(" + trace_expr(param->repeat->expr, formatter) + ")") + ")";
+                }
+                else if (param->type == ParamType::byte) {
+                    auto len = get_const_int<size_t>(length_expr(param));
+                    if (ctx.allow_fixed() && len.second && len.first != 0) {
+                        field = ns + "fixed_bytes<" + member + ", " + std::to_string(len.first) + ">{}";
+                    }
+                    else {
+                        field = ns + "bytes<" + member + ", " + error(ctx, cargo, param, "_length") + ">(" +
+                                lambda(cargo, "std::size_t(" + trace_expr(length_expr(param), formatter) + ")") + ")";
+                    }
+                }
+                else {
+                    std::string codec;
+                    if (!get_codec(ctx, codec, param, cargo, record)) {
+                        return false;
+                    }
+                    field = ns + "value<" + member + ", " + codec + ">{}";
+                }
+                return true;
+            }
+
+            static std::string add_check(CppOutContext& ctx, const std::string& field, std::shared_ptr<Param>& param, Cargo& cargo, auto& formatter) {
+                if (!param->bind_c) {
+                    return field;
+                }
+                return ctx.generic_namespace() + "::check<" + error(ctx, cargo, param, "_bind") + ">(" +
+                       lambda(cargo, trace_expr(param->bind_c->expr, formatter)) + ",\n" + field + ")";
+            }
+
+            // consecutive bit params without if decoration are one bits descriptor
+            static bool write_bit_run(CppOutContext& ctx, std::vector<std::string>& fields, std::vector<std::shared_ptr<Param>*>& run, Cargo& cargo, auto& formatter) {
+                if (run.empty()) {
+                    return true;
+                }
+                size_t total = 0;
+                std::string field = ctx.generic_namespace() + "::bits<";
+                std::string each;
+                for (auto p : run) {
+                    auto w = get_const_int<size_t>(length_expr(*p));
+                    if (!w.second || w.first == 0) {
+                        return false;
+                    }
+                    total += w.first;
+                    each += ", " + ctx.generic_namespace() + "::bit<&" + cargo.name + "::" + (*p)->name + ", " + std::to_string(w.first) + ">";
+                }
+                if (total % 8 != 0 || total > 64) {
+                    return false;
+                }
+                field += std::to_string(total / 8) + each + ">{}";
+                for (auto p : run) {
+                    field = add_check(ctx, field, *p, cargo, formatter);
+                }
+                fields.push_back(std::move(field));
+                run.clear();
+                return true;
+            }
+
+            static bool get_member(CppOutContext& ctx, std::string& def, std::shared_ptr<Param>& param, Record& record, auto& formatter) {
+                std::string tyname;
+                size_t bylen = 0;
+                if (!CargoToCppStruct::get_typename(tyname, ctx, param, bylen, record)) {
+                    return false;
+                }
+                def += tyname + " " + param->name;
+                if (bylen != 0) {
+                    def += "[" + std::to_string(bylen) + "]";
+                }
+                if (param->default_v) {
+                    def += " = {" + trace_expr(param->default_v->expr, formatter) + "}";
+                }
+                else {
+                    def += "{}";
+                }
+                def += ";\n";
+                return true;
+            }
+
+            static bool convert(CppOutContext& ctx, Cargo& cargo, Record& record) {
+                if (!cargo.read.expired() || !cargo.write.expired()) {
+                    return false;
+                }
+                auto formatter = format_generic(record, cargo, "__v.");
+                auto member = format_generic(record, cargo, "");
+                std::string def;
+                std::vector<std::string> fields;
+                std::vector<std::shared_ptr<Param>*> run;
+                for (auto& param : cargo.params) {
+                    if (!get_member(ctx, def, param, record, member)) {
+                        return false;
+                    }
+                    if (param->type == ParamType::bit && !param->if_c) {
+                        run.push_back(&param);
+                        continue;
+                    }
+                    if (!write_bit_run(ctx, fields, run, cargo, formatter)) {
+                        return false;
+                    }
+                    if (is_absent(param)) {
+                        continue;
+                    }
+                    if (param->type == ParamType::bit) {
+                        run.push_back(&param);
+                        if (!write_bit_run(ctx, fields, run, cargo, formatter)) {
+                            return false;
+                        }
+                    }
+                    else {
+                        std::string field;
+                        if (!get_field(ctx, field, param, cargo, record, formatter)) {
+                            return false;
+                        }
+                        fields.push_back(add_check(ctx, field, param, cargo, formatter));
+                    }
+                    if (param->if_c) {
+                        fields.back() = ctx.generic_namespace() + "::when(" + lambda(cargo, trace_expr(param->if_c->expr, formatter)) + ",\n" + fields.back() + ")";
+                    }
+                }
+                if (!write_bit_run(ctx, fields, run, cargo, formatter)) {
+                    return false;
+                }
+                auto& basename = cargo.base.basename;
+                ctx.set_error_enum(cargo.name + "_short_input");
+                ctx.write("\nstruct " + cargo.name);
+                if (basename.size()) {
+                    ctx.write(" : " + basename);
+                }
+                ctx.write(" {\n" + def + "};\n");
+                ctx.write("\nnamespace " + ctx.generic_namespace() + " {\ntemplate <>\nstruct schema<" + cargo.name + "> {\n");
+                ctx.write("using base = " + (basename.size() ? basename : std::string("void")) + ";\n");
+                ctx.write("static constexpr auto short_input = " + ctx.error_enum() + "::" + cargo.name + "_short_input;\n");
+                ctx.write("static constexpr auto fields = std::make_tuple(");
+                for (size_t i = 0; i < fields.size(); i++) {
+                    ctx.write(i == 0 ? "\n" : ",\n");
+                    ctx.write(fields[i]);
+                }
+                ctx.write(");\n};\n}  // namespace " + ctx.generic_namespace() + "\n");
+                return true;
+            }
+        };
+    }  // namespace cpp
+}  // namespace binred
@@ -0,0 +1,169 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#pragma once
+#include "output_context.h"
+#include "code_element.h"
+#include "../../parse/parser/parse.h"
+#include <string>
+#include <vector>
+
+namespace binred {
+    namespace cpp {
+        // harness sources are written next to generated header by `build --harness`
+        // bench_source measures decode/encode of corpus made by randomize (needs owned byte)
+        // fuzz_source is libFuzzer entry which checks decode->encode->decode round trip
+        // first input byte selects cargo
+        // cargo with read/write command (also of its base) is only decoded because layout may differ
+
+        std::string bench_source(CppOutContext& ctx, const std::string& header, const std::vector<std::string>& cargos) {
+            auto err = ctx.error_enum();
+            std::string ret = "// benchmark generated by binred\n#include \"" + header + "\"\n";
+            ret += R"(#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// corpus entry is kept only if its encoding decodes again
+template <class T>
+static void bench(const char* name, std::size_t count) {
+std::uint64_t seed = 1;
+std::vector<T> src;
+std::vector<std::string> wire;
+std::size_t bytes = 0;
+for (std::size_t i = 0; i < count * 4 && src.size() < count; i++) {
+T v;
+if (v.randomize(seed) != )" + err + R"(::none) {
+continue;
+}
+std::string buf(v.encoded_size(), '\0');
+if (v.encode_to(reinterpret_cast<std::uint8_t*>(buf.data())) != )" + err + R"(::none) {
+continue;
+}
+T check;
+if (check.decode(reinterpret_cast<const std::uint8_t*>(buf.data()), buf.size()) != )" + err + R"(::none) {
+continue;
+}
+bytes += buf.size();
+src.push_back(std::move(v));
+wire.push_back(std::move(buf));
+}
+if (src.empty()) {
+std::printf("%-24s no corpus\n", name);
+return;
+}
+using clock = std::chrono::steady_clock;
+// each side repeats whole corpus until 200ms elapsed
+auto run = [&](auto&& once) {
+std::size_t rounds = 0;
+auto begin = clock::now();
+auto end = begin;
+do {
+for (std::size_t i = 0; i < src.size(); i++) {
+once(i);
+}
+rounds++;
+end = clock::now();
+} while (end - begin < std::chrono::milliseconds(200));
+return std::pair<double, std::size_t>{std::chrono::duration<double, std::nano>(end - begin).count(), rounds};
+};
+std::vector<T> dst(src.size());
+std::size_t failed = 0;
+auto dec = run([&](std::size_t i) {
+failed += dst[i].decode(reinterpret_cast<const std::uint8_t*>(wire[i].data()), wire[i].size()) != )" + err + R"(::none;
+});
+std::string out;
+auto enc = run([&](std::size_t i) {
+out.resize(src[i].encoded_size());
+failed += src[i].encode_to(reinterpret_cast<std::uint8_t*>(out.data())) != )" + err + R"(::none;
+});
+auto report = [&](std::pair<double, std::size_t> r) {
+auto msgs = double(src.size() * r.second);
+std::printf(" %10.1f ns/msg %10.1f MB/s", r.first / msgs, double(bytes * r.second) * 1e3 / r.first);
+};
+std::printf("%-24s %6zu msg %8.1f B/msg decode", name, src.size(), double(bytes) / double(src.size()));
+report(dec);
+std::printf(" encode");
+report(enc);
+std::printf("%s\n", failed ? " [failed]" : "");
+}
+
+int main(int argc, char** argv) {
+std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000;
+)";
+            for (auto& c : cargos) {
+                ret += "bench<" + c + ">(\"" + c + "\", count);\n";
+            }
+            ret += "}\n";
+            return ret;
+        }
+
+        bool has_command(Cargo& cargo, Record& record) {
+            if (!cargo.read.expired() || !cargo.write.expired()) {
+                return true;
+            }
+            if (cargo.base.basename.size()) {
+                auto found = record.cargos.find(cargo.base.basename);
+                if (found != record.cargos.end()) {
+                    return has_command(*found->second, record);
+                }
+            }
+            return false;
+        }
+
+        std::string fuzz_source(CppOutContext& ctx, const std::string& header, const std::vector<std::string>& cargos, Record& record) {
+            auto err = ctx.error_enum();
+            std::string ret = "// libFuzzer entry generated by binred\n#include \"" + header + "\"\n";
+            ret += R"(#include <cstdlib>
+#include <string>
+
+// decoded value must encode, and its encoding must decode and encode to same bytes
+template <class T>
+static void decode_only(const std::uint8_t* p, std::size_t n) {
+T first;
+(void)first.decode(p, n);
+}
+
+template <class T>
+static void round_trip(const std::uint8_t* p, std::size_t n) {
+T first;
+if (first.decode(p, n) != )" + err + R"(::none) {
+return;
+}
+std::string once(first.encoded_size(), '\0');
+if (first.encode_to(reinterpret_cast<std::uint8_t*>(once.data())) != )" + err + R"(::none) {
+std::abort();
+}
+T second;
+std::size_t pos = 0;
+if (second.decode(reinterpret_cast<const std::uint8_t*>(once.data()), once.size(), pos) != )" + err + R"(::none || pos != once.size()) {
+std::abort();
+}
+std::string twice(second.encoded_size(), '\0');
+if (second.encode_to(reinterpret_cast<std::uint8_t*>(twice.data())) != )" + err + R"(::none || once != twice) {
+std::abort();
+}
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size) {
+if (size == 0) {
+return 0;
+}
+switch (data[0] % )" + std::to_string(cargos.size() ? cargos.size() : 1) + R"() {
+)";
+            for (size_t i = 0; i < cargos.size(); i++) {
+                ret += "case " + std::to_string(i) + ":\n";
+                auto found = record.cargos.find(cargos[i]);
+                auto check = found != record.cargos.end() && has_command(*found->second, record) ? "decode_only<" : "round_trip<";
+                ret += check + cargos[i] + ">(data + 1, size - 1);\nbreak;\n";
+            }
+            ret += "default:\nbreak;\n}\nreturn 0;\n}\n";
+            return ret;
+        }
+    }  // namespace cpp
+}  // namespace binred
@@ -0,0 +1,111 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#pragma once
+
+#include "../../parse/parser/parse.h"
+#include "output_context.h"
+#include "../../calc/get_const.h"
+#include "../../calc/trace_expr.h"
+#include "format_alias_and_cargo.h"
+#include "code_element.h"
+#include "bit_field.h"
+#include <algorithm>
+
+namespace binred {
+    namespace cpp {
+        // IOCommon is shared by decode/encode generator
+        struct IOCommon {
+            static std::shared_ptr<Param>* find_param(Cargo& cargo, const std::string& name) {
+                for (auto& p : cargo.params) {
+                    if (p->name == name) {
+                        return &p;
+                    }
+                }
+                return nullptr;
+            }
+
+            // little_endian reports byte order of int/uint param
+            // le/be of param overrides that of cargo and big endian is default
+            static bool little_endian(Cargo& cargo, std::shared_ptr<Param>& param) {
+                if (param->type != ParamType::integer && param->type != ParamType::uint) {
+                    return false;
+                }
+                auto endian = param->endian != Endian::none ? param->endian : cargo.endian;
+                return endian == Endian::little;
+            }
+
+            // cargo without base, command and param on wire never touches buffer,
+            // so buffer arguments of its functions are marked unused
+            static std::string unused_attr(Cargo& cargo) {
+                if (cargo.base.basename.size() || !cargo.read.expired() || !cargo.write.expired()) {
+                    return "";
+                }
+                for (auto& p : cargo.params) {
+                    if (!is_absent(p)) {
+                        return "";
+                    }
+                }
+                return "[[maybe_unused]] ";
+            }
+
+            static std::shared_ptr<Expr>& length_expr(std::shared_ptr<Param>& param) {
+                return castptr<ExprLength>(castptr<Builtin>(param)->length)->expr;
+            }
+
+            static void collect_transfer(std::vector<std::shared_ptr<Command>>& cmds, std::vector<std::string>& to) {
+                auto add = [&](TransferData& data) {
+                    if (std::find(to.begin(), to.end(), data.cargoname) == to.end()) {
+                        to.push_back(data.cargoname);
+                    }
+                };
+                for (auto& c : cmds) {
+                    switch (c->kind) {
+                        case CommandKind::transfer_direct:
+                            add(castptr<TransferDirect>(c)->data);
+                            break;
+                        case CommandKind::transfer_if:
+                            add(castptr<TransferIf>(c)->data);
+                            break;
+                        case CommandKind::transfer_switch: {
+                            auto tsw = castptr<TransferSwitch>(c);
+                            for (auto& t : tsw->to) {
+                                add(t.second);
+                            }
+                            if (tsw->defaults.cargoname.size()) {
+                                add(tsw->defaults);
+                            }
+                            break;
+                        }
+                        case CommandKind::if_:
+                            for (auto& cond : castptr<IfCommand>(c)->ifs) {
+                                collect_transfer(cond->cmds, to);
+                            }
+                            break;
+                        default:
+                            break;
+                    }
+                }
+            }
+
+            static void write_check(CppOutContext& ctx, std::string& buf, const std::string& cond, const std::string& err) {
+                ctx.set_error_enum(err);
+                write_if(buf, cond);
+                write_beginblock(buf);
+                write_return(buf, ctx.error_enum() + "::" + err);
+                write_endblock(buf);
+            }
+
+            static bool write_param_check(CppOutContext& ctx, std::string& buf, std::shared_ptr<Param>& param, Cargo& cargo, auto& formatter) {
+                if (param->bind_c) {
+                    write_check(ctx, buf, write_not(trace_expr(param->bind_c->expr, formatter)), cargo.name + "_" + param->name + "_bind");
+                }
+                return true;
+            }
+        };
+    }  // namespace cpp
+}  // namespace binred
@@ -0,0 +1,196 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#pragma once
+
+#include "../../parse/parser/parse.h"
+#include "output_context.h"
+#include "../../calc/get_const.h"
+#include "../common/fixed_layout.h"
+#include "io_common.h"
+#include "fixed_codec.h"
+#include "read_to_decode.h"
+#include <map>
+
+namespace binred {
+    namespace cpp {
+        // CargoToLazy generates Cargo::Lazy which wraps raw input and decodes a field on demand
+        // field at constant offset is read directly
+        // other fields need lazy_scan once, which validates input and records offsets of byte and nested cargo
+        // getter of field at constant offset does not validate; call error() to check whole input
+        // Lazy of derived cargo has getters of its own params only; base fields are read by Lazy of base on same input
+        struct CargoToLazy : IOCommon {
+            struct Offset {
+                size_t offset = 0;
+                size_t length = 0;
+            };
+
+            // offsets of leading params whose position never depends on decoded value
+            static void constant_offsets(CppOutContext& ctx, Cargo& cargo, Record& record, std::map<std::string, Offset>& offs) {
+                if (cargo.base.basename.size() || !cargo.read.expired()) {
+                    return;
+                }
+                size_t offset = 0;
+                for (auto& param : cargo.params) {
+                    if (param->if_c || param->repeat) {
+                        return;
+                    }
+                    if (param->type == ParamType::custom) {
+                        auto found = record.cargos.find(castptr<Custom>(param)->cargoname);
+                        if (found == record.cargos.end()) {
+                            return;
+                        }
+                        auto sub = get_fixed_size(*found->second, record);
+                        std::string unused;
+                        if (!sub.second || !FixedCodec::convert(ctx, unused, unused, *found->second, record)) {
+                            return;
+                        }
+                        offs[param->name] = {offset, sub.first};
+                        offset += sub.first;
+                        continue;
+                    }
+                    auto len = get_const_int<size_t>(length_expr(param));
+                    if (!len.second) {
+                        return;
+                    }
+                    if (param->type == ParamType::bit) {
+                        BitField bits;
+                        if (!get_bitfield(cargo, param->name, bits)) {
+                            return;
+                        }
+                        if (bits.first) {
+                            offset += bits.total / 8;
+                        }
+                        offs[param->name] = {offset - bits.total / 8, bits.total / 8};
+                        continue;
+                    }
+                    if (len.first == 0 || (param->type != ParamType::byte && len.first > 8)) {
+                        return;
+                    }
+                    offs[param->name] = {offset, len.first};
+                    offset += len.first;
+                }
+            }
+
+            static bool convert(CppOutContext& ctx, std::string& buf, Cargo& cargo, Record& record, std::map<std::string, std::string>& types) {
+                std::map<std::string, Offset> offs;
+                constant_offsets(ctx, cargo, record, offs);
+                size_t slots = 0;
+                for (auto& p : cargo.params) {
+                    if (p->type == ParamType::byte || p->type == ParamType::custom) {
+                        slots++;
+                    }
+                }
+                auto none = ctx.error_enum() + "::none";
+                std::string getter;
+                for (auto& param : cargo.params) {
+                    auto& name = param->name;
+                    auto type = param->type;
+                    auto found = offs.find(name);
+                    std::string outtype;
+                    if (type == ParamType::byte) {
+                        outtype = "std::string_view";
+                    }
+                    else {
+                        outtype = types[name];
+                    }
+                    getter += "\n" + ctx.error_enum() + " get_" + name + "(" + outtype + "& __out) const {\n";
+                    if (found != offs.end()) {
+                        auto& o = found->second;
+                        auto off = std::to_string(o.offset);
+                        write_check(ctx, getter, "__n < " + std::to_string(o.offset + o.length), cargo.name + "_short_input");
+                        if (type == ParamType::custom) {
+                            write_return(getter, "__out.decode_fixed(__p + " + off + ")");
+                            write_endblock(getter);
+                            continue;
+                        }
+                        if (type == ParamType::byte) {
+                            getter += "__out = std::string_view(reinterpret_cast<const char*>(__p + " + off + "), " + std::to_string(o.length) + ");\n";
+                        }
+                        else if (BitField bits; type == ParamType::bit && get_bitfield(cargo, name, bits)) {
+                            bits.storage = FixedCodec::load(ctx, o.length, o.offset, false);
+                            getter += "__out = " + outtype + "(" + bitfield_get(bits) + ");\n";
+                        }
+                        else {
+                            auto value = FixedCodec::load(ctx, o.length, o.offset, false, little_endian(cargo, param));
+                            if (type == ParamType::integer && !FixedCodec::is_word(o.length)) {
+                                auto shift = std::to_string(64 - o.length * 8);
+                                value = "std::int64_t(std::uint64_t(" + value + ") << " + shift + ") >> " + shift;
+                            }
+                            getter += "__out = " + outtype + "(" + value + ");\n";
+                        }
+                        write_return(getter, none);
+                        write_endblock(getter);
+                        continue;
+                    }
+                    write_if(getter, "auto __e = scan(); __e != " + none);
+                    write_beginblock(getter);
+                    write_return(getter, "__e");
+                    write_endblock(getter);
+                    if ((type == ParamType::byte || type == ParamType::custom) && !param->repeat) {
+                        auto slot = "[" + std::to_string(ReadToCppDecode::offset_slot(cargo, name)) + "]";
+                        write_check(ctx, getter, "__lens" + slot + " == std::size_t(-1)", cargo.name + "_" + name + "_if");
+                        if (type == ParamType::byte) {
+                            getter += "__out = std::string_view(reinterpret_cast<const char*>(__p + __offs" + slot + "), __lens" + slot + ");\n";
+                        }
+                        else {
+                            getter += "std::size_t __pos = __offs" + slot + ";\n";
+                            write_return(getter, "__out.decode(__p, __offs" + slot + " + __lens" + slot + ", __pos)");
+                            write_endblock(getter);
+                            continue;
+                        }
+                    }
+                    else if (type == ParamType::custom && !RepeatedField::element_size(ctx, param, record)) {
+                        // elements in scratch object are only validated, so they are decoded again from recorded range
+                        // count is taken from scratch object because element may take no byte
+                        auto slot = "[" + std::to_string(ReadToCppDecode::offset_slot(cargo, name)) + "]";
+                        getter += "__out.resize(__v.get_" + name + "().size());\n";
+                        getter += "std::size_t __pos = __offs" + slot + ";\n";
+                        getter += "for (auto& __x : __out) {\n";
+                        write_if(getter, "auto __e = __x.decode(__p, __offs" + slot + " + __lens" + slot + ", __pos); __e != " + none);
+                        write_beginblock(getter);
+                        write_return(getter, "__e");
+                        write_endblock(getter);
+                        write_endblock(getter);
+                    }
+                    else {
+                        getter += "__out = __v.get_" + name + "();\n";
+                    }
+                    write_return(getter, none);
+                    write_endblock(getter);
+                }
+                auto count = std::to_string(slots ? slots : 1);
+                buf += "\nstruct " + cargo.name + "::Lazy {\nprivate:\n\n";
+                buf += "const std::uint8_t* __p = nullptr;\n\n";
+                buf += "std::size_t __n = 0;\n\n";
+                buf += "mutable " + cargo.name + " __v;\n\n";
+                buf += "mutable std::size_t __offs[" + count + "]{};\n\n";
+                buf += "mutable std::size_t __lens[" + count + "]{};\n\n";
+                buf += "mutable bool __scanned = false;\n\n";
+                buf += "mutable " + ctx.error_enum() + " __err = " + none + ";\n\n";
+                buf += ctx.error_enum() + " scan() const {\n";
+                write_if(buf, "!__scanned");
+                write_beginblock(buf);
+                buf += "for (auto& __l : __lens) {\n__l = std::size_t(-1);\n}\n";
+                buf += "std::size_t __pos = 0;\n";
+                buf += "__err = __v.lazy_scan(__p, __n, __pos, __offs, __lens);\n";
+                buf += "__scanned = true;";
+                write_endblock(buf);
+                write_return(buf, "__err");
+                write_endblock(buf);
+                buf += "\npublic:\n\n";
+                buf += "Lazy(const std::uint8_t* __p, std::size_t __n)\n: __p(__p), __n(__n) {}\n\n";
+                buf += ctx.error_enum() + " error() const {\n";
+                write_return(buf, "scan()");
+                write_endblock(buf);
+                buf += getter;
+                buf += "};\n";
+                return true;
+            }
+        };
+    }  // namespace cpp
+}  // namespace binred
@@ -8,26 +8,63 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <algorithm>
 namespace binred {
     namespace cpp {
         struct CppOutContext {
             std::string buffer;
             std::vector<std::string> enum_v;
+            // map variable length byte to view into decoded input instead of owning buffer
+            bool byte_view = false;
+            // map owned byte to std::pmr::string and generate allocator_type constructor
+            // so that one message can be decoded into single arena (memory_resource)
+            bool pmr = false;
+            // generate operator==, operator<=> and hash() for each cargo and std::hash specialization
+            bool compare = false;
+            // generate randomize() used by bench harness (not in byte_view mode)
+            bool harness = false;
+            // emit plain struct and constexpr field table (schema) decoded by template engine
+            // instead of member functions (see generic_engine.h)
+            bool generic = false;
+            // runtime blocks called by generated code; set while converting
+            // so that runtime_helper writes only what is used
+            bool use_checksum = false;
+            bool use_decode_many = false;
+            bool use_bulk = false;
 
             void write(const std::string& w) {
                 buffer += w;
             }
 
             void set_error_enum(const std::string& v) {
+                if (std::find(enum_v.begin(), enum_v.end(), v) != enum_v.end()) {
+                    return;
+                }
                 enum_v.push_back(v);
             }
 
+            void merge_use(const CppOutContext& other) {
+                use_checksum |= other.use_checksum;
+                use_decode_many |= other.use_decode_many;
+                use_bulk |= other.use_bulk;
+            }
+
             std::string length_of_byte(const std::string& var) {
                 return "std::size(" + var + ")";
             }
 
             const char* buffer_type() {
-                return "std::string";
+                if (byte_view) {
+                    return "std::string_view";
+                }
+                return pmr ? "std::pmr::string" : "std::string";
+            }
+
+            std::string set_byte_from_input(const std::string& var, const std::string& ptr, const std::string& len) {
+                if (byte_view) {
+                    return var + " = std::string_view(reinterpret_cast<const char*>(" + ptr + "), " + len + ");\n";
+                }
+                return var + ".assign(reinterpret_cast<const char*>(" + ptr + "), " + len + ");\n";
             }
 
             bool allow_fixed() {
@@ -37,6 +74,14 @@ namespace binred {
             std::string error_enum() {
                 return "FrameError";
             }
+
+            std::string helper_namespace() {
+                return "binred_rt";
+            }
+
+            std::string generic_namespace() {
+                return "binred_gen";
+            }
         };
     }  // namespace cpp
 }  // namespace binred
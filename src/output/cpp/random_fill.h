@@ -0,0 +1,216 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#pragma once
+
+#include "../../parse/parser/parse.h"
+#include "output_context.h"
+#include "../../calc/get_const.h"
+#include "../../calc/trace_expr.h"
+#include "format_alias_and_cargo.h"
+#include "io_common.h"
+#include "repeated_field.h"
+
+namespace binred {
+    namespace cpp {
+        // CargoToRandom generates randomize which fills cargo with random value for bench corpus
+        // every field is set through its setter so bind/length/if constraints hold,
+        // scalar with bind is retried with default value first and then wider random values
+        // byte and array length is taken from length expression and limited to 4096
+        struct CargoToRandom : IOCommon {
+            static constexpr const char* limit = "4096";
+
+            static void write_set(CppOutContext& ctx, std::string& buf, const std::string& name, const std::string& value) {
+                write_if(buf, "(__e = set_" + name + "(" + value + ")) != " + ctx.error_enum() + "::none");
+                write_beginblock(buf);
+                write_return(buf, "__e");
+                write_endblock(buf);
+            }
+
+            static void write_limit(CppOutContext& ctx, std::string& buf, const std::string& var, const std::string& err) {
+                write_check(ctx, buf, var + " > " + limit, err);
+            }
+
+            // length_ref returns param of cargo if repeat length is plain reference to it
+            static std::shared_ptr<Param> length_ref(std::shared_ptr<Param>& param, Cargo& cargo) {
+                auto& expr = param->repeat->expr;
+                if (!expr || expr->kind != ExprKind::ref) {
+                    return nullptr;
+                }
+                for (auto& p : cargo.params) {
+                    if (p->name == expr->v) {
+                        return p;
+                    }
+                }
+                return nullptr;
+            }
+
+            static bool write_param(CppOutContext& ctx, std::string& buf, std::shared_ptr<Param>& param, Cargo& cargo, Record& record, auto& formatter) {
+                auto& name = param->name;
+                auto type = param->type;
+                auto rt = ctx.helper_namespace();
+                auto none = ctx.error_enum() + "::none";
+                auto err = cargo.name + "_" + name + "_length";
+                auto tyname = "std::remove_cvref_t<decltype(get_" + name + "())>";
+                if (param->repeat) {
+                    auto elem = RepeatedField::element_size(ctx, param, record);
+                    auto expr = "std::size_t(" + trace_expr(param->repeat->expr, formatter) + ")";
+                    write_beginblock(buf);
+                    if (!param->repeat->bytes) {
+                        buf += "std::size_t __cnt = " + expr + ";\n";
+                    }
+                    else if (elem) {
+                        buf += "std::size_t __len = " + expr + ";\n";
+                        write_check(ctx, buf, "__len % " + std::to_string(elem) + " != 0", err);
+                        buf += "std::size_t __cnt = __len / " + std::to_string(elem) + ";\n";
+                    }
+                    else if (RepeatedField::varlen_kind(type)) {
+                        // first attempt of random_value always encodes in one byte
+                        buf += "std::size_t __cnt = " + expr + ";\n";
+                    }
+                    else if (auto ref = length_ref(param, cargo)) {
+                        // variable size element: count is random and length field is set to their total size
+                        buf += "std::size_t __cnt = std::size_t(" + rt + "::random_value(__r, 0));\n";
+                        buf += tyname + " __a(__cnt);\n";
+                        buf += "std::size_t __len = 0;\n";
+                        buf += "for (auto& __v : __a) {\n";
+                        write_if(buf, "(__e = __v.randomize(__r)) != " + none);
+                        write_beginblock(buf);
+                        write_return(buf, "__e");
+                        write_endblock(buf);
+                        buf += "__len += __v.encoded_size();\n";
+                        buf += "}\n";
+                        write_set(ctx, buf, ref->name, "std::remove_cvref_t<decltype(get_" + ref->name + "())>(__len)");
+                        write_set(ctx, buf, name, "__a");
+                        write_endblock(buf);
+                        return true;
+                    }
+                    else {
+                        ctx.set_error_enum(err);
+                        write_return(buf, ctx.error_enum() + "::" + err);
+                        write_endblock(buf);
+                        return true;
+                    }
+                    write_limit(ctx, buf, "__cnt", err);
+                    buf += tyname + " __a(__cnt);\n";
+                    buf += "for (auto& __v : __a) {\n";
+                    if (type == ParamType::custom) {
+                        write_if(buf, "(__e = __v.randomize(__r)) != " + none);
+                        write_beginblock(buf);
+                        write_return(buf, "__e");
+                        write_endblock(buf);
+                    }
+                    else {
+                        buf += "__v = std::remove_reference_t<decltype(__v)>(" + rt + "::random_value(__r, 0));\n";
+                    }
+                    buf += "}\n";
+                    write_set(ctx, buf, name, "__a");
+                    write_endblock(buf);
+                    return true;
+                }
+                switch (type) {
+                    case ParamType::integer:
+                    case ParamType::uint:
+                    case ParamType::bit:
+                    case ParamType::varint:
+                    case ParamType::leb128:
+                    case ParamType::zigzag: {
+                        write_beginblock(buf);
+                        buf += "using __t = " + tyname + ";\n";
+                        if (param->bind_c) {
+                            buf += "__e = set_" + name + "(get_" + name + "());\n";
+                        }
+                        else {
+                            buf += "__e = set_" + name + "(__t(" + rt + "::random_value(__r, 0)));\n";
+                        }
+                        buf += "for (std::size_t __i = 1; __i < 32 && __e != " + none + "; __i++) {\n";
+                        buf += "__e = set_" + name + "(__t(" + rt + "::random_value(__r, __i)));\n";
+                        buf += "}\n";
+                        write_if(buf, "__e != " + none);
+                        write_beginblock(buf);
+                        write_return(buf, "__e");
+                        write_endblock(buf);
+                        write_endblock(buf);
+                        return true;
+                    }
+                    case ParamType::byte: {
+                        write_beginblock(buf);
+                        auto len = get_const_int<size_t>(length_expr(param));
+                        if (ctx.allow_fixed() && len.second && len.first != 0) {
+                            auto size = std::to_string(len.first);
+                            buf += "std::uint8_t __b[" + size + "];\n";
+                            buf += rt + "::random_fill(__r, __b, " + size + ");\n";
+                        }
+                        else {
+                            buf += "std::size_t __len = std::size_t(" + trace_expr(length_expr(param), formatter) + ");\n";
+                            write_limit(ctx, buf, "__len", err);
+                            buf += tyname + " __b(__len, '\\0');\n";
+                            buf += rt + "::random_fill(__r, __b.data(), __len);\n";
+                        }
+                        write_set(ctx, buf, name, "__b");
+                        write_endblock(buf);
+                        return true;
+                    }
+                    case ParamType::custom: {
+                        if (!record.cargos.count(castptr<Custom>(param)->cargoname)) {
+                            // complex type is left default constructed
+                            return true;
+                        }
+                        write_beginblock(buf);
+                        buf += tyname + " __v;\n";
+                        write_if(buf, "(__e = __v.randomize(__r)) != " + none);
+                        write_beginblock(buf);
+                        write_return(buf, "__e");
+                        write_endblock(buf);
+                        write_set(ctx, buf, name, "__v");
+                        write_endblock(buf);
+                        return true;
+                    }
+                    default:
+                        return false;
+                }
+            }
+
+            static bool convert(CppOutContext& ctx, std::string& buf, Cargo& cargo, Record& record) {
+                if (!ctx.harness || ctx.byte_view) {
+                    return true;
+                }
+                std::string current;
+                auto formatter = format_alias_and_cargo(record, current, cargo);
+                auto u = unused_attr(cargo);
+                std::string body;
+                body += u + ctx.error_enum() + " __e = " + ctx.error_enum() + "::none;\n";
+                if (cargo.base.basename.size()) {
+                    write_if(body, "(__e = " + cargo.base.basename + "::randomize(__r)) != " + ctx.error_enum() + "::none");
+                    write_beginblock(body);
+                    write_return(body, "__e");
+                    write_endblock(body);
+                }
+                for (auto& param : cargo.params) {
+                    if (is_absent(param)) {
+                        continue;
+                    }
+                    if (param->if_c) {
+                        write_if(body, trace_expr(param->if_c->expr, formatter));
+                        write_beginblock(body);
+                    }
+                    if (!write_param(ctx, body, param, cargo, record, formatter)) {
+                        return false;
+                    }
+                    if (param->if_c) {
+                        write_endblock(body);
+                    }
+                }
+                write_return(body, ctx.error_enum() + "::none");
+                buf += "\n" + ctx.error_enum() + " randomize(" + u + "std::uint64_t& __r) {\n";
+                buf += body;
+                write_endblock(buf);
+                return true;
+            }
+        };
+    }  // namespace cpp
+}  // namespace binred
@@ -0,0 +1,1068 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#pragma once
+
+#include "../../parse/parser/parse.h"
+#include "output_context.h"
+#include "../../calc/get_const.h"
+#include "../../calc/trace_expr.h"
+#include "io_common.h"
+#include "fixed_codec.h"
+#include "repeated_field.h"
+#include "checksum_field.h"
+
+namespace binred {
+    namespace cpp {
+        // ReadToCppDecode lowers `read` block of cargo into decode member function
+        // generated code reads input with __p (buffer) __n (size) __pos (current offset)
+        // if cargo has no read block, params are read in declared order
+        // variant of generated body is selected by DecodeMode
+        // resume: each pop is numbered step and generated code skips
+        // steps already done so that decode_resume can continue on next input chunk
+        // validate: constraints are checked but byte payload is not copied
+        // offsets: with validate, offset and length of byte and nested cargo are recorded for Lazy
+        // sum: with resume, checksum function which every step adds its bytes to (empty if none)
+        struct DecodeMode {
+            bool resume = false;
+            bool validate = false;
+            bool offsets = false;
+            size_t step = 0;
+            std::string sum;
+        };
+
+        struct ReadToCppDecode : IOCommon {
+            static std::vector<std::string> transfer_targets(Cargo& cargo) {
+                std::vector<std::string> ret;
+                if (auto read = cargo.read.lock()) {
+                    collect_transfer(read->cmds, ret);
+                }
+                return ret;
+            }
+
+            static std::string read_be(size_t len, const std::string& offset, bool little = false) {
+                const char* cast = len <= 4 ? "std::uint32_t(" : "std::uint64_t(";
+                std::string ret;
+                for (size_t i = 0; i < len; i++) {
+                    if (i != 0) {
+                        ret += " | ";
+                    }
+                    auto shift = (little ? i : len - i - 1) * 8;
+                    if (shift) {
+                        ret += "(";
+                    }
+                    ret += cast;
+                    ret += "__p[" + offset + " + " + std::to_string(i) + "])";
+                    if (shift) {
+                        ret += " << " + std::to_string(shift) + ")";
+                    }
+                }
+                return ret;
+            }
+
+            static void write_short_check(CppOutContext& ctx, std::string& buf, Cargo& cargo, const std::string& len, DecodeMode* mode = nullptr) {
+                if (!mode || !mode->resume) {
+                    write_check(ctx, buf, "__n - __pos < " + len, cargo.name + "_short_input");
+                    return;
+                }
+                ctx.set_error_enum("need_more");
+                write_if(buf, "__n - __pos < " + len);
+                write_beginblock(buf);
+                buf += "__st.need = " + len + " - (__n - __pos);\n";
+                write_return(buf, ctx.error_enum() + "::need_more");
+                write_endblock(buf);
+            }
+
+            static void begin_step(std::string& buf, DecodeMode* mode) {
+                if (mode && mode->resume) {
+                    write_if(buf, "__st.at(__depth) < " + std::to_string(++mode->step));
+                    write_beginblock(buf);
+                    if (mode->sum.size()) {
+                        buf += "std::size_t __b = __pos;\n";
+                    }
+                }
+            }
+
+            // step is done at once in one chunk, so bytes of step are added to running checksum at end of step
+            static void end_step(std::string& buf, DecodeMode* mode) {
+                if (mode && mode->resume) {
+                    if (mode->sum.size()) {
+                        buf += "__st.sum(__depth) = " + mode->sum + "(__st.sum(__depth), __p + __b, __pos - __b);\n";
+                    }
+                    buf += "__st.at(__depth) = " + std::to_string(mode->step) + ";";
+                    write_endblock(buf);
+                }
+            }
+
+            // write_sum_start starts range of checksum which covers from param name ("" is start of cargo)
+            // in resume mode running checksum is reset until first step of range is done
+            static void write_sum_start(CppOutContext& ctx, std::string& buf, Cargo& cargo, const std::string& name, DecodeMode* mode) {
+                if (!mode || !mode->resume) {
+                    if (name.size()) {
+                        ChecksumField::write_mark(ctx, buf, cargo, name);
+                    }
+                    return;
+                }
+                for (auto& p : cargo.params) {
+                    if (p->checksum && p->checksum->from == name) {
+                        write_if(buf, "__st.at(__depth) == " + std::to_string(mode->step));
+                        write_beginblock(buf);
+                        buf += "__st.sum(__depth) = " + ChecksumField::initial(p) + ";";
+                        write_endblock(buf);
+                        mode->sum = ChecksumField::function(ctx, p);
+                    }
+                }
+            }
+
+            // offset_slot is index of byte/nested cargo param in __offs/__lens of lazy_scan
+            static size_t offset_slot(Cargo& cargo, const std::string& name) {
+                size_t slot = 0;
+                for (auto& p : cargo.params) {
+                    if (p->name == name) {
+                        break;
+                    }
+                    if (p->type == ParamType::byte || p->type == ParamType::custom) {
+                        slot++;
+                    }
+                }
+                return slot;
+            }
+
+            // write_fixed_offsets records offset and length of byte and nested cargo of fixed layout cargo
+            // they are at constant offset from start
+            static void write_fixed_offsets(std::string& buf, Cargo& cargo, Record& record) {
+                size_t offset = 0, bits = 0, slot = 0;
+                for (auto& p : cargo.params) {
+                    size_t len = 0;
+                    if (p->type == ParamType::custom) {
+                        len = get_fixed_size(*record.cargos.at(castptr<Custom>(p)->cargoname), record).first;
+                    }
+                    else {
+                        len = get_const_int<size_t>(length_expr(p)).first;
+                        if (p->type == ParamType::bit) {
+                            bits += len;
+                            continue;
+                        }
+                    }
+                    offset += bits / 8;
+                    bits = 0;
+                    if (p->type == ParamType::byte || p->type == ParamType::custom) {
+                        auto index = "[" + std::to_string(slot++) + "]";
+                        buf += "__offs" + index + " = __pos + " + std::to_string(offset) + ";\n";
+                        buf += "__lens" + index + " = " + std::to_string(len) + ";\n";
+                    }
+                    offset += len;
+                }
+            }
+
+            static bool write_pop_param(CppOutContext& ctx, std::string& buf, std::shared_ptr<Param>& param, std::shared_ptr<Expr>& len, Cargo& cargo, Record& record, auto& formatter, DecodeMode* mode = nullptr) {
+                auto& name = param->name;
+                auto type = param->type;
+                write_sum_start(ctx, buf, cargo, name, mode);
+                if (param->checksum && mode && mode->resume) {
+                    // checksum itself is not covered
+                    mode->sum.clear();
+                }
+                begin_step(buf, mode);
+                std::string slot;
+                if (mode && mode->offsets && (type == ParamType::byte || type == ParamType::custom)) {
+                    slot = "[" + std::to_string(offset_slot(cargo, name)) + "]";
+                    buf += "__offs" + slot + " = __pos;\n";
+                }
+                if (param->repeat) {
+                    // length of pop is ignored, repeat decoration gives it
+                    auto short_check = [&](std::string& out, const std::string& len) {
+                        write_short_check(ctx, out, cargo, len, mode);
+                    };
+                    if (!RepeatedField::write_decode(ctx, buf, param, cargo, record, formatter, short_check, mode && mode->resume, mode && mode->validate)) {
+                        return false;
+                    }
+                    if (slot.size()) {
+                        buf += "__lens" + slot + " = __pos - __offs" + slot + ";\n";
+                    }
+                }
+                else if (type == ParamType::integer || type == ParamType::uint || type == ParamType::bit) {
+                    auto size = get_const_int<size_t>(len);
+                    if (!size.second || size.first == 0 || size.first > 8) {
+                        return false;
+                    }
+                    write_short_check(ctx, buf, cargo, std::to_string(size.first), mode);
+                    auto value = read_be(size.first, "__pos", little_endian(cargo, param));
+                    if (type == ParamType::integer && size.first != 1 && size.first != 2 && size.first != 4 && size.first != 8) {
+                        auto shift = std::to_string(64 - size.first * 8);
+                        value = "std::int64_t(std::uint64_t(" + value + ") << " + shift + ") >> " + shift;
+                    }
+                    if (BitField bits; type == ParamType::bit && get_bitfield(cargo, name, bits)) {
+                        buf += bitfield_set(bits, value);
+                    }
+                    else {
+                        buf += name + " = decltype(" + name + ")(" + value + ");\n";
+                    }
+                    buf += "__pos += " + std::to_string(size.first) + ";\n";
+                    if (param->checksum) {
+                        if (size.first != 4) {
+                            return false;
+                        }
+                        auto sum = mode && mode->resume ? std::string("__st.sum(__depth)") : ChecksumField::decoded_sum(ctx, param, size.first);
+                        ChecksumField::write_verify(ctx, buf, param, cargo, sum);
+                    }
+                }
+                else if (type == ParamType::varint) {
+                    // length of pop is ignored, prefix of first byte gives it
+                    write_short_check(ctx, buf, cargo, "1", mode);
+                    write_beginblock(buf);
+                    buf += "std::size_t __len = " + ctx.helper_namespace() + "::varint_length(__p[__pos]);\n";
+                    write_short_check(ctx, buf, cargo, "__len", mode);
+                    buf += name + " = " + ctx.helper_namespace() + "::load_varint(__p + __pos, __n - __pos);\n";
+                    buf += "__pos += __len;";
+                    write_endblock(buf);
+                }
+                else if (type == ParamType::leb128 || type == ParamType::zigzag) {
+                    write_beginblock(buf);
+                    buf += "std::size_t __len = " + ctx.helper_namespace() + "::leb128_length(__p + __pos, __n - __pos);\n";
+                    write_check(ctx, buf, "__len == 0", cargo.name + "_" + name + "_overflow");
+                    write_short_check(ctx, buf, cargo, "__len", mode);
+                    auto value = ctx.helper_namespace() + "::load_leb128(__p + __pos, __len)";
+                    if (type == ParamType::zigzag) {
+                        value = ctx.helper_namespace() + "::zigzag_decode(" + value + ")";
+                    }
+                    buf += name + " = " + value + ";\n";
+                    buf += "__pos += __len;";
+                    write_endblock(buf);
+                }
+                else if (type == ParamType::byte) {
+                    // payload is needed in validate mode only if bind refers it
+                    bool skip = mode && mode->validate && !param->bind_c;
+                    auto declared = get_const_int<size_t>(length_expr(param));
+                    if (ctx.allow_fixed() && declared.second && declared.first != 0) {
+                        auto size = get_const_int<size_t>(len);
+                        if (!size.second || declared.first != size.first) {
+                            return false;
+                        }
+                        auto lenstr = std::to_string(size.first);
+                        write_short_check(ctx, buf, cargo, lenstr, mode);
+                        if (!skip) {
+                            write_call(buf, "::memcpy", name, "__p + __pos", lenstr) += ";\n";
+                        }
+                        if (slot.size()) {
+                            buf += "__lens" + slot + " = " + lenstr + ";\n";
+                        }
+                        buf += "__pos += " + lenstr + ";\n";
+                    }
+                    else {
+                        write_beginblock(buf);
+                        buf += "std::size_t __len = std::size_t(" + trace_expr(len, formatter) + ");\n";
+                        write_short_check(ctx, buf, cargo, "__len", mode);
+                        if (!skip) {
+                            buf += ctx.set_byte_from_input(name, "__p + __pos", "__len");
+                        }
+                        if (slot.size()) {
+                            buf += "__lens" + slot + " = __len;\n";
+                        }
+                        buf += "__pos += __len;";
+                        write_endblock(buf);
+                    }
+                }
+                else if (type == ParamType::custom) {
+                    if (!record.cargos.count(castptr<Custom>(param)->cargoname)) {
+                        return false;
+                    }
+                    if (mode && mode->resume) {
+                        std::string unused;
+                        auto& sub = *record.cargos.at(castptr<Custom>(param)->cargoname);
+                        if (!write_resume(ctx, unused, sub, record)) {
+                            return false;
+                        }
+                        if (mode->sum.size() && !(get_fixed_size(sub, record).second && FixedCodec::convert(ctx, unused, unused, sub, record))) {
+                            // nested steps spread over chunks are not summed by this step
+                            return false;
+                        }
+                        write_if(buf, "auto __e = " + name + ".decode_resume(__st, __depth + 1, __p, __n, __pos); __e != " + ctx.error_enum() + "::none");
+                    }
+                    else if (mode && mode->validate) {
+                        write_if(buf, "auto __e = " + name + ".validate_into(__p, __n, __pos); __e != " + ctx.error_enum() + "::none");
+                    }
+                    else {
+                        write_if(buf, "auto __e = " + name + ".decode(__p, __n, __pos); __e != " + ctx.error_enum() + "::none");
+                    }
+                    write_beginblock(buf);
+                    write_return(buf, "__e");
+                    write_endblock(buf);
+                    if (mode && mode->resume) {
+                        buf += "__st.reset(__depth + 1);\n";
+                    }
+                    if (slot.size()) {
+                        buf += "__lens" + slot + " = __pos - __offs" + slot + ";\n";
+                    }
+                }
+                else {
+                    return false;
+                }
+                if (!write_param_check(ctx, buf, param, cargo, formatter)) {
+                    return false;
+                }
+                end_step(buf, mode);
+                return true;
+            }
+
+            // packed bit run is read by one big endian load into its storage word
+            static bool write_packed_run(CppOutContext& ctx, std::string& buf, BitField& bits, std::vector<std::shared_ptr<Param>*>& run, Cargo& cargo, auto& formatter, DecodeMode* mode) {
+                auto bytes = bits.total / 8;
+                write_short_check(ctx, buf, cargo, std::to_string(bytes), mode);
+                auto type = storage_type(bits.storage_bits);
+                if (bits.total == bits.storage_bits) {
+                    buf += bits.storage + " = " + ctx.helper_namespace() + "::load_be<" + type + ">(__p + __pos);\n";
+                }
+                else {
+                    buf += bits.storage + " = " + type + "(" + read_be(bytes, "__pos") + ");\n";
+                }
+                buf += "__pos += " + std::to_string(bytes) + ";\n";
+                for (auto p : run) {
+                    write_param_check(ctx, buf, *p, cargo, formatter);
+                }
+                run.clear();
+                return true;
+            }
+
+            static bool write_bit_run(CppOutContext& ctx, std::string& buf, std::vector<std::shared_ptr<Param>*>& run, Cargo& cargo, auto& formatter, DecodeMode* mode = nullptr) {
+                for (auto p : run) {
+                    write_sum_start(ctx, buf, cargo, (*p)->name, mode);
+                }
+                begin_step(buf, mode);
+                if (BitField bits; get_bitfield(cargo, (*run[0])->name, bits)) {
+                    if (!write_packed_run(ctx, buf, bits, run, cargo, formatter, mode)) {
+                        return false;
+                    }
+                    end_step(buf, mode);
+                    return true;
+                }
+                size_t total = 0;
+                std::vector<size_t> width;
+                for (auto p : run) {
+                    auto w = get_const_int<size_t>(length_expr(*p));
+                    if (!w.second || w.first == 0) {
+                        return false;
+                    }
+                    width.push_back(w.first);
+                    total += w.first;
+                }
+                if (total % 8 != 0 || total > 64) {
+                    return false;
+                }
+                auto bytes = total / 8;
+                write_short_check(ctx, buf, cargo, std::to_string(bytes), mode);
+                write_beginblock(buf);
+                buf += "std::uint64_t __bits = " + read_be(bytes, "__pos") + ";\n";
+                auto shift = total;
+                for (size_t i = 0; i < run.size(); i++) {
+                    auto& name = (*run[i])->name;
+                    shift -= width[i];
+                    auto mask = bitfield_mask(width[i]);
+                    buf += name + " = decltype(" + name + ")((__bits >> " + std::to_string(shift) + ") & " + mask + ");\n";
+                }
+                buf += "__pos += " + std::to_string(bytes) + ";";
+                write_endblock(buf);
+                for (auto p : run) {
+                    write_param_check(ctx, buf, *p, cargo, formatter);
+                }
+                run.clear();
+                end_step(buf, mode);
+                return true;
+            }
+
+            // write_reset restores param not read because of false condition to its default
+            // so that value decoded before into reused object does not remain
+            static void write_reset(CppOutContext& ctx, std::string& buf, std::shared_ptr<Param>& param, auto& formatter) {
+                auto& name = param->name;
+                if (param->repeat) {
+                    buf += name + ".clear();\n";
+                }
+                else if (param->type == ParamType::byte) {
+                    auto declared = get_const_int<size_t>(length_expr(param));
+                    if (ctx.allow_fixed() && declared.second && declared.first != 0) {
+                        write_call(buf, "::memset", name, "0", "sizeof(" + name + ")") += ";\n";
+                    }
+                    else if (ctx.byte_view) {
+                        buf += name + " = {};\n";
+                    }
+                    else {
+                        buf += name + ".clear();\n";
+                    }
+                }
+                else if (param->default_v && param->type != ParamType::custom) {
+                    buf += name + " = decltype(" + name + ")(" + trace_expr(param->default_v->expr, formatter) + ");\n";
+                }
+                else {
+                    buf += name + " = {};\n";
+                }
+            }
+
+            static bool write_implicit(CppOutContext& ctx, std::string& buf, Cargo& cargo, Record& record, auto& formatter, DecodeMode* mode = nullptr) {
+                std::vector<std::shared_ptr<Param>*> run;
+                for (auto& param : cargo.params) {
+                    if (param->type == ParamType::bit && !param->if_c) {
+                        run.push_back(&param);
+                        continue;
+                    }
+                    if (run.size() && !write_bit_run(ctx, buf, run, cargo, formatter, mode)) {
+                        return false;
+                    }
+                    if (is_absent(param)) {
+                        write_reset(ctx, buf, param, formatter);
+                        continue;
+                    }
+                    if (param->if_c) {
+                        write_if(buf, trace_expr(param->if_c->expr, formatter));
+                        write_beginblock(buf);
+                    }
+                    if (param->type == ParamType::bit) {
+                        run.push_back(&param);
+                        if (!write_bit_run(ctx, buf, run, cargo, formatter, mode)) {
+                            return false;
+                        }
+                    }
+                    else if (param->type == ParamType::custom) {
+                        std::shared_ptr<Expr> nolen;
+                        if (!write_pop_param(ctx, buf, param, nolen, cargo, record, formatter, mode)) {
+                            return false;
+                        }
+                    }
+                    else if (!write_pop_param(ctx, buf, param, length_expr(param), cargo, record, formatter, mode)) {
+                        return false;
+                    }
+                    if (param->if_c) {
+                        write_endblock(buf);
+                        buf += "else ";
+                        write_beginblock(buf);
+                        write_reset(ctx, buf, param, formatter);
+                        write_endblock(buf);
+                    }
+                }
+                if (run.size() && !write_bit_run(ctx, buf, run, cargo, formatter, mode)) {
+                    return false;
+                }
+                return true;
+            }
+
+            static void write_transfer(CppOutContext& ctx, std::string& buf, TransferData& data) {
+                write_if(buf, "__next");
+                write_beginblock(buf);
+                buf += "*__next = transfer_t::" + data.cargoname + ";";
+                write_endblock(buf);
+                write_return(buf, ctx.error_enum() + "::none");
+            }
+
+            // perfect_hash finds multiplier and table bits so that
+            // (key * mul) >> (64 - bits) is distinct for each key
+            static bool perfect_hash(const std::vector<std::uint64_t>& keys, std::uint64_t& mul, size_t& bits) {
+                constexpr std::uint64_t muls[] = {
+                    0x9E3779B97F4A7C15, 0xBF58476D1CE4E5B9, 0x94D049BB133111EB, 0xD6E8FEB86659FD93,
+                    0xFF51AFD7ED558CCD, 0xC4CEB9FE1A85EC53, 0x2545F4914F6CDD1D, 0x5851F42D4C957F2D};
+                bits = 1;
+                while ((size_t(1) << bits) < keys.size()) {
+                    bits++;
+                }
+                for (auto limit = bits + 3; bits <= limit; bits++) {
+                    for (auto m : muls) {
+                        std::vector<bool> used(size_t(1) << bits);
+                        bool ok = true;
+                        for (auto k : keys) {
+                            auto h = (k * m) >> (64 - bits);
+                            if (used[h]) {
+                                ok = false;
+                                break;
+                            }
+                            used[h] = true;
+                        }
+                        if (ok) {
+                            mul = m;
+                            return true;
+                        }
+                    }
+                }
+                return false;
+            }
+
+            // transfer switch with distinct constant cases is lowered to switch statement
+            // dense values are left to compiler (jump table)
+            // sparse values are mapped to dense slot by perfect hash before switch
+            static bool write_transfer_table(CppOutContext& ctx, std::string& buf, TransferSwitch& tsw, auto& formatter) {
+                std::vector<std::uint64_t> keys;
+                std::int64_t min = 0, max = 0;
+                for (auto& t : tsw.to) {
+                    auto v = get_const_int<std::int64_t>(t.first);
+                    if (!v.second || std::find(keys.begin(), keys.end(), std::uint64_t(v.first)) != keys.end()) {
+                        return false;
+                    }
+                    if (keys.empty() || v.first < min) {
+                        min = v.first;
+                    }
+                    if (keys.empty() || v.first > max) {
+                        max = v.first;
+                    }
+                    keys.push_back(std::uint64_t(v.first));
+                }
+                if (keys.empty()) {
+                    return false;
+                }
+                std::uint64_t mul = 0;
+                size_t bits = 0;
+                bool sparse = keys.size() >= 4 && std::uint64_t(max - min) >= keys.size() * 3 && perfect_hash(keys, mul, bits);
+                std::vector<std::string> label;
+                write_beginblock(buf);
+                if (sparse) {
+                    auto slots = size_t(1) << bits;
+                    auto hash = [&](std::uint64_t k) {
+                        return size_t((k * mul) >> (64 - bits));
+                    };
+                    // empty slot holds a key which hashes elsewhere so it never matches
+                    std::vector<std::uint64_t> table(slots, keys[0]);
+                    for (auto k : keys) {
+                        table[hash(k)] = k;
+                    }
+                    buf += "static constexpr std::uint64_t __keys[] = {";
+                    for (size_t i = 0; i < slots; i++) {
+                        if (i != 0) {
+                            buf += ", ";
+                        }
+                        buf += std::to_string(table[i]) + "u";
+                    }
+                    buf += "};\n";
+                    buf += "auto __sw = std::uint64_t(" + trace_expr(tsw.cond, formatter) + ");\n";
+                    buf += "auto __h = std::size_t((__sw * " + std::to_string(mul) + "u) >> " + std::to_string(64 - bits) + ");\n";
+                    buf += "switch (__keys[__h] == __sw ? __h : " + std::to_string(slots) + ") {\n";
+                    for (auto k : keys) {
+                        label.push_back(std::to_string(hash(k)));
+                    }
+                }
+                else {
+                    buf += "switch (" + trace_expr(tsw.cond, formatter) + ") {\n";
+                    for (auto& t : tsw.to) {
+                        label.push_back(trace_expr(t.first, formatter));
+                    }
+                }
+                for (size_t i = 0; i < tsw.to.size(); i++) {
+                    buf += "case " + label[i] + ":";
+                    write_beginblock(buf);
+                    write_transfer(ctx, buf, tsw.to[i].second);
+                    write_endblock(buf);
+                }
+                if (tsw.defaults.cargoname.size()) {
+                    buf += "default:";
+                    write_beginblock(buf);
+                    write_transfer(ctx, buf, tsw.defaults);
+                    write_endblock(buf);
+                }
+                else {
+                    buf += "default:\nbreak;\n";
+                }
+                buf += "}";
+                write_endblock(buf);
+                return true;
+            }
+
+            // collect_set collects params which are popped or assigned by cmds
+            static void collect_set(std::vector<std::shared_ptr<Command>>& cmds, std::vector<std::string>& set) {
+                auto add = [&](const std::string& name) {
+                    if (name.size() && std::find(set.begin(), set.end(), name) == set.end()) {
+                        set.push_back(name);
+                    }
+                };
+                for (auto& c : cmds) {
+                    if (c->kind == CommandKind::pop) {
+                        add(castptr<PopCommand>(c)->refid);
+                    }
+                    else if (c->kind == CommandKind::assign) {
+                        add(castptr<AssignCommand>(c)->target);
+                    }
+                    else if (c->kind == CommandKind::if_) {
+                        for (auto& cond : castptr<IfCommand>(c)->ifs) {
+                            collect_set(cond->cmds, set);
+                        }
+                    }
+                }
+            }
+
+            // branch of if command resets params which only other branches set
+            // reset does not touch param set by this branch, so it is safe to run again on resume
+            static bool write_branch_reset(CppOutContext& ctx, std::string& buf, Cargo& cargo, const std::vector<std::string>& all, std::vector<std::shared_ptr<Command>>* cmds, auto& formatter) {
+                std::vector<std::string> own;
+                if (cmds) {
+                    collect_set(*cmds, own);
+                }
+                for (auto& name : all) {
+                    if (std::find(own.begin(), own.end(), name) != own.end()) {
+                        continue;
+                    }
+                    auto param = find_param(cargo, name);
+                    if (!param) {
+                        return false;
+                    }
+                    write_reset(ctx, buf, *param, formatter);
+                }
+                return true;
+            }
+
+            static bool write_commands(CppOutContext& ctx, std::string& buf, std::vector<std::shared_ptr<Command>>& cmds, Cargo& cargo, Record& record, auto& formatter, DecodeMode* mode = nullptr) {
+                for (auto& c : cmds) {
+                    switch (c->kind) {
+                        case CommandKind::pop: {
+                            auto pop = castptr<PopCommand>(c);
+                            if (pop->refid.size()) {
+                                auto param = find_param(cargo, pop->refid);
+                                if (!param) {
+                                    return false;
+                                }
+                                if (!write_pop_param(ctx, buf, *param, pop->numpop, cargo, record, formatter, mode)) {
+                                    return false;
+                                }
+                                break;
+                            }
+                            begin_step(buf, mode);
+                            write_beginblock(buf);
+                            buf += "std::size_t __len = std::size_t(" + trace_expr(pop->numpop, formatter) + ");\n";
+                            write_short_check(ctx, buf, cargo, "__len", mode);
+                            buf += "__pos += __len;";
+                            write_endblock(buf);
+                            end_step(buf, mode);
+                            break;
+                        }
+                        case CommandKind::push: {
+                            auto push = castptr<PushCommand>(c);
+                            if (mode && mode->resume) {
+                                // bytes before resumed step are no longer kept
+                                return false;
+                            }
+                            write_beginblock(buf);
+                            buf += "std::size_t __len = std::size_t(" + trace_expr(push->numpop, formatter) + ");\n";
+                            write_check(ctx, buf, "__pos < __len", cargo.name + "_read_push");
+                            buf += "__pos -= __len;";
+                            write_endblock(buf);
+                            break;
+                        }
+                        case CommandKind::if_: {
+                            auto cif = castptr<IfCommand>(c);
+                            std::vector<std::string> all;
+                            for (auto& cond : cif->ifs) {
+                                collect_set(cond->cmds, all);
+                            }
+                            for (size_t i = 0; i < cif->ifs.size(); i++) {
+                                auto& cond = cif->ifs[i];
+                                if (i != 0) {
+                                    buf += "else ";
+                                }
+                                if (cond->expr) {
+                                    write_if(buf, trace_expr(cond->expr, formatter));
+                                }
+                                write_beginblock(buf);
+                                if (!write_branch_reset(ctx, buf, cargo, all, &cond->cmds, formatter)) {
+                                    return false;
+                                }
+                                if (!write_commands(ctx, buf, cond->cmds, cargo, record, formatter, mode)) {
+                                    return false;
+                                }
+                                write_endblock(buf);
+                            }
+                            if (all.size() && cif->ifs.size() && cif->ifs.back()->expr) {
+                                buf += "else ";
+                                write_beginblock(buf);
+                                if (!write_branch_reset(ctx, buf, cargo, all, nullptr, formatter)) {
+                                    return false;
+                                }
+                                write_endblock(buf);
+                            }
+                            break;
+                        }
+                        case CommandKind::bind:
+                            write_check(ctx, buf, write_not(trace_expr(castptr<BindCommand>(c)->expr, formatter)), cargo.name + "_read_bind");
+                            break;
+                        case CommandKind::test:
+                            write_check(ctx, buf, write_not(trace_expr(castptr<TestCommand>(c)->expr, formatter)), cargo.name + "_read_test");
+                            break;
+                        case CommandKind::assign: {
+                            auto assign = castptr<AssignCommand>(c);
+                            if (!find_param(cargo, assign->target)) {
+                                return false;
+                            }
+                            begin_step(buf, mode);
+                            buf += assign->target + " = " + trace_expr(assign->expr, formatter) + ";\n";
+                            end_step(buf, mode);
+                            break;
+                        }
+                        case CommandKind::call: {
+                            std::shared_ptr<Expr> call = castptr<CallCommand>(c)->call;
+                            begin_step(buf, mode);
+                            buf += trace_expr(call, formatter) + ";\n";
+                            end_step(buf, mode);
+                            break;
+                        }
+                        case CommandKind::transfer_direct:
+                            write_transfer(ctx, buf, castptr<TransferDirect>(c)->data);
+                            buf += "\n";
+                            break;
+                        case CommandKind::transfer_if: {
+                            auto tif = castptr<TransferIf>(c);
+                            write_if(buf, trace_expr(tif->cond, formatter));
+                            write_beginblock(buf);
+                            write_transfer(ctx, buf, tif->data);
+                            write_endblock(buf);
+                            break;
+                        }
+                        case CommandKind::transfer_switch: {
+                            auto tsw = castptr<TransferSwitch>(c);
+                            if (write_transfer_table(ctx, buf, *tsw, formatter)) {
+                                break;
+                            }
+                            write_beginblock(buf);
+                            buf += "auto __sw = " + trace_expr(tsw->cond, formatter) + ";\n";
+                            for (size_t i = 0; i < tsw->to.size(); i++) {
+                                if (i != 0) {
+                                    buf += "else ";
+                                }
+                                write_if(buf, "__sw == " + trace_expr(tsw->to[i].first, formatter));
+                                write_beginblock(buf);
+                                write_transfer(ctx, buf, tsw->to[i].second);
+                                write_endblock(buf);
+                            }
+                            if (tsw->defaults.cargoname.size()) {
+                                if (tsw->to.size()) {
+                                    buf += "else ";
+                                }
+                                write_beginblock(buf);
+                                write_transfer(ctx, buf, tsw->defaults);
+                                write_endblock(buf);
+                            }
+                            write_endblock(buf);
+                            break;
+                        }
+                        default:
+                            return false;
+                    }
+                }
+                return true;
+            }
+
+            // decode_iov decodes from chain of segments (iov_base/iov_len)
+            // frame within one segment is decoded directly by decode
+            // __pos is offset in whole chain and advanced only if decode succeeded
+            static void write_iov_begin(CppOutContext& ctx, std::string& buf, const std::string& joined, const std::string& nextarg, const std::string& nextpass) {
+                buf += "\ntemplate <class Iov>\n";
+                buf += ctx.error_enum() + " decode_iov(const Iov* __iov, std::size_t __count, std::size_t& __pos" + joined + nextarg + ") {\n";
+                buf += "std::size_t __i = 0, __base = 0;\n";
+                buf += "for (; __i < __count && __base + __iov[__i].iov_len <= __pos; __i++) {\n";
+                buf += "__base += __iov[__i].iov_len;";
+                write_endblock(buf);
+                write_if(buf, "__i < __count");
+                write_beginblock(buf);
+                buf += "std::size_t __off = __pos - __base;\n";
+                write_if(buf, "decode(static_cast<const std::uint8_t*>(__iov[__i].iov_base), __iov[__i].iov_len, __off" + nextpass + ") == " + ctx.error_enum() + "::none");
+                write_beginblock(buf);
+                buf += "__pos = __base + __off;\n";
+                write_return(buf, ctx.error_enum() + "::none");
+                write_endblock(buf);
+                buf += "}\n";
+            }
+
+            // frame straddling segments is fed to decode_stream segment by segment
+            // so only field straddling segments is copied
+            static void write_iov(CppOutContext& ctx, std::string& buf, Cargo& cargo, const std::string& nextarg, const std::string& nextpass) {
+                auto more = ctx.error_enum() + "::need_more";
+                write_iov_begin(ctx, buf, "", nextarg, nextpass);
+                buf += ctx.helper_namespace() + "::stream_state __st;\n";
+                buf += ctx.error_enum() + " __e = " + more + ";\n";
+                buf += "std::size_t __read = __pos;\n";
+                buf += "for (; __i < __count && __e == " + more + "; __i++) {\n";
+                buf += "std::size_t __len = __iov[__i].iov_len;\n";
+                buf += "std::size_t __off = __read - __base;\n";
+                buf += "__e = decode_stream(__st, static_cast<const std::uint8_t*>(__iov[__i].iov_base), __len, __off" + nextpass + ");\n";
+                buf += "__read = __base + __off;\n";
+                buf += "__base += __len;";
+                write_endblock(buf);
+                write_if(buf, "__e == " + ctx.error_enum() + "::none");
+                write_beginblock(buf);
+                buf += "__pos = __read;";
+                write_endblock(buf);
+                write_check(ctx, buf, "__e == " + more, cargo.name + "_short_input");
+                write_return(buf, "__e");
+                write_endblock(buf);
+            }
+
+            // cargo which can not be decoded incrementally decodes frame straddling segments from joined copy of rest of chain
+            // in byte_view mode caller passes __joined, which views may point into
+            static void write_iov_joined(CppOutContext& ctx, std::string& buf, const std::string& nextarg, const std::string& nextpass) {
+                write_iov_begin(ctx, buf, ctx.byte_view ? ", std::string& __joined" : "", nextarg, nextpass);
+                if (ctx.byte_view) {
+                    buf += "__joined.clear();\n";
+                }
+                else {
+                    buf += "std::string __joined;\n";
+                }
+                buf += "for (std::size_t __j = __i; __j < __count; __j++) {\n";
+                buf += "std::size_t __skip = __j == __i ? __pos - __base : 0;\n";
+                buf += "__joined.append(static_cast<const char*>(__iov[__j].iov_base) + __skip, __iov[__j].iov_len - __skip);";
+                write_endblock(buf);
+                buf += "std::size_t __off = 0;\n";
+                buf += ctx.error_enum() + " __e = decode(reinterpret_cast<const std::uint8_t*>(__joined.data()), __joined.size(), __off" + nextpass + ");\n";
+                write_if(buf, "__e == " + ctx.error_enum() + "::none");
+                write_beginblock(buf);
+                buf += "__pos += __off;";
+                write_endblock(buf);
+                write_return(buf, "__e");
+                write_endblock(buf);
+            }
+
+            // write_validate writes validate_into which runs read block without copying byte payload
+            // and static validate which checks wire buffer against all constraints
+            // scalar fields are still read into scratch object because conditions refer them
+            // if offsets is true, lazy_scan which also records where byte and nested cargo are is written instead
+            static bool write_validate(CppOutContext& ctx, std::string& buf, Cargo& cargo, Record& record, bool offsets = false) {
+                std::string current;
+                auto formatter = format_alias_and_cargo(record, current, cargo);
+                std::string body, unused;
+                DecodeMode mode;
+                mode.validate = true;
+                mode.offsets = offsets;
+                std::string nextarg, nextpass;
+                if (transfer_targets(cargo).size()) {
+                    nextarg = ", transfer_t* __next = nullptr";
+                    nextpass = ", __next";
+                }
+                auto u = unused_attr(cargo);
+                const std::string args = u + "const std::uint8_t* __p, " + u + "std::size_t __n, " + u + "std::size_t& __pos";
+                if (auto base = cargo.base.cargo.lock()) {
+                    auto& basename = cargo.base.basename;
+                    std::string basepass;
+                    if (transfer_targets(*base).size()) {
+                        body += basename + "::transfer_t __base_next = " + basename + "::transfer_t::none;\n";
+                        basepass = ", &__base_next";
+                    }
+                    write_if(body, "auto __e = " + basename + "::validate_into(__p, __n, __pos" + basepass + "); __e != " + ctx.error_enum() + "::none");
+                    write_beginblock(body);
+                    write_return(body, "__e");
+                    write_endblock(body);
+                    if (basepass.size()) {
+                        write_check(ctx, body, "__base_next != " + basename + "::transfer_t::" + cargo.name, cargo.name + "_transfer");
+                    }
+                }
+                ChecksumField::write_begin(ctx, body, cargo);
+                if (FixedCodec::convert(ctx, unused, unused, cargo, record)) {
+                    // fixed layout is already cheap
+                    if (offsets) {
+                        write_fixed_offsets(body, cargo, record);
+                    }
+                    write_return(body, "decode(__p, __n, __pos)");
+                }
+                else {
+                    if (auto read = cargo.read.lock()) {
+                        if (!write_commands(ctx, body, read->cmds, cargo, record, formatter, &mode)) {
+                            return false;
+                        }
+                    }
+                    else if (!write_implicit(ctx, body, cargo, record, formatter, &mode)) {
+                        return false;
+                    }
+                    write_return(body, ctx.error_enum() + "::none");
+                }
+                if (offsets) {
+                    // cargo without byte and nested cargo has no offset to record
+                    auto attr = offset_slot(cargo, "") ? "" : "[[maybe_unused]] ";
+                    buf += "\n" + ctx.error_enum() + " lazy_scan(" + args + ", " + attr + "std::size_t* __offs, " + attr + "std::size_t* __lens" + nextarg + ") {\n";
+                    buf += body;
+                    write_endblock(buf);
+                    return true;
+                }
+                buf += "\n" + ctx.error_enum() + " validate_into(" + args + nextarg + ") {\n";
+                buf += body;
+                write_endblock(buf);
+                buf += "\nstatic " + ctx.error_enum() + " validate(const std::uint8_t* __p, std::size_t __n) {\n";
+                buf += cargo.name + " __v;\n";
+                buf += "std::size_t __pos = 0;\n";
+                write_return(buf, "__v.validate_into(__p, __n, __pos)");
+                write_endblock(buf);
+                return true;
+            }
+
+            // write_resume writes decode_resume which is resumable version of decode
+            // returns false if cargo can not be decoded incrementally
+            static bool write_resume(CppOutContext& ctx, std::string& buf, Cargo& cargo, Record& record) {
+                if (ctx.byte_view) {
+                    // view into input chunk would dangle after chunk is released
+                    return false;
+                }
+                std::string current;
+                auto formatter = format_alias_and_cargo(record, current, cargo);
+                std::string body, unused;
+                DecodeMode mode;
+                mode.resume = true;
+                size_t sums = 0;
+                for (auto& p : cargo.params) {
+                    sums += p->checksum ? 1 : 0;
+                }
+                if (sums > 1) {
+                    // only one running checksum is kept per depth
+                    return false;
+                }
+                if (auto base = cargo.base.cargo.lock()) {
+                    if (!write_resume(ctx, unused, *base, record)) {
+                        return false;
+                    }
+                    auto& basename = cargo.base.basename;
+                    std::string basepass;
+                    begin_step(body, &mode);
+                    if (transfer_targets(*base).size()) {
+                        body += basename + "::transfer_t __base_next = " + basename + "::transfer_t::none;\n";
+                        basepass = ", &__base_next";
+                    }
+                    write_if(body, "auto __e = " + basename + "::decode_resume(__st, __depth + 1, __p, __n, __pos" + basepass + "); __e != " + ctx.error_enum() + "::none");
+                    write_beginblock(body);
+                    write_return(body, "__e");
+                    write_endblock(body);
+                    body += "__st.reset(__depth + 1);\n";
+                    if (basepass.size()) {
+                        write_check(ctx, body, "__base_next != " + basename + "::transfer_t::" + cargo.name, cargo.name + "_transfer");
+                    }
+                    end_step(body, &mode);
+                }
+                write_sum_start(ctx, body, cargo, "", &mode);
+                if (get_fixed_size(cargo, record).second && FixedCodec::convert(ctx, unused, unused, cargo, record)) {
+                    begin_step(body, &mode);
+                    write_short_check(ctx, body, cargo, "fixed_size", &mode);
+                    write_if(body, "auto __e = decode_fixed(__p + __pos); __e != " + ctx.error_enum() + "::none");
+                    write_beginblock(body);
+                    write_return(body, "__e");
+                    write_endblock(body);
+                    body += "__pos += fixed_size;";
+                    end_step(body, &mode);
+                }
+                else if (auto read = cargo.read.lock()) {
+                    if (!write_commands(ctx, body, read->cmds, cargo, record, formatter, &mode)) {
+                        return false;
+                    }
+                }
+                else if (!write_implicit(ctx, body, cargo, record, formatter, &mode)) {
+                    return false;
+                }
+                write_return(body, ctx.error_enum() + "::none");
+                std::string nextarg, nextpass;
+                if (transfer_targets(cargo).size()) {
+                    nextarg = ", transfer_t* __next = nullptr";
+                    nextpass = ", __next";
+                }
+                auto u = unused_attr(cargo);
+                const std::string state = ctx.helper_namespace() + "::stream_state& __st";
+                const std::string args = u + "const std::uint8_t* __p, " + u + "std::size_t __n, " + u + "std::size_t& __pos";
+                buf += "\n" + ctx.error_enum() + " decode_resume(" + u + state + ", " + u + "std::size_t __depth, " + args + nextarg + ") {\n";
+                buf += body;
+                write_endblock(buf);
+                // decode_stream consumes whole chunk and returns need_more with __st.need bytes missing
+                // until cargo is completed
+                buf += "\n" + ctx.error_enum() + " decode_stream(" + state + ", " + args + nextarg + ") {\n";
+                buf += "return " + ctx.helper_namespace() + "::feed_stream(__st, __p, __n, __pos, " + ctx.error_enum() + "::need_more, ";
+                buf += "[&](const std::uint8_t* __b, std::size_t __l, std::size_t& __o) {\n";
+                write_return(buf, "decode_resume(__st, 0, __b, __l, __o" + nextpass + ")");
+                buf += "\n});";
+                write_endblock(buf);
+                write_iov(ctx, buf, cargo, nextarg, nextpass);
+                return true;
+            }
+
+            // write_no_resume declares resumable decoders of cargo which write_resume rejected as deleted
+            // so that call is compile error instead of binding to decoder of base cargo
+            // decode_iov is still written with joined copy
+            static void write_no_resume(CppOutContext& ctx, std::string& buf, Cargo& cargo) {
+                std::string nextarg, nextpass;
+                if (transfer_targets(cargo).size()) {
+                    nextarg = ", transfer_t* __next = nullptr";
+                    nextpass = ", __next";
+                }
+                const std::string state = ctx.helper_namespace() + "::stream_state& __st";
+                auto u = unused_attr(cargo);
+                const std::string args = u + "const std::uint8_t* __p, " + u + "std::size_t __n, " + u + "std::size_t& __pos";
+                buf += "\n// " + cargo.name + " can not be decoded incrementally\n";
+                buf += ctx.error_enum() + " decode_resume(" + state + ", std::size_t __depth, " + args + nextarg + ") = delete;\n";
+                buf += ctx.error_enum() + " decode_stream(" + state + ", " + args + nextarg + ") = delete;\n";
+                write_iov_joined(ctx, buf, nextarg, nextpass);
+            }
+
+            // convert requires TypeResolver (output/common/analisis/resolve_names.h)
+            // to link read block and base cargo
+            static bool convert(CppOutContext& ctx, std::string& buf, Cargo& cargo, Record& record) {
+                std::string current;
+                auto formatter = format_alias_and_cargo(record, current, cargo);
+                std::string body, fixed, unused;
+                ChecksumField::write_begin(ctx, body, cargo);
+                if (FixedCodec::convert(ctx, fixed, unused, cargo, record) &&
+                    FixedCodec::convert(ctx, fixed, unused, cargo, record, true)) {
+                    FixedCodec::write_decode_many(ctx, fixed, cargo, record);
+                    // whole cargo is checked once and read at constant offset
+                    write_short_check(ctx, body, cargo, "fixed_size");
+                    write_if(body, "auto __e = decode_fixed(__p + __pos); __e != " + ctx.error_enum() + "::none");
+                    write_beginblock(body);
+                    write_return(body, "__e");
+                    write_endblock(body);
+                    body += "__pos += fixed_size;\n";
+                }
+                else if (auto read = cargo.read.lock()) {
+                    if (!write_commands(ctx, body, read->cmds, cargo, record, formatter)) {
+                        return false;
+                    }
+                }
+                else if (!write_implicit(ctx, body, cargo, record, formatter)) {
+                    return false;
+                }
+                write_return(body, ctx.error_enum() + "::none");
+                auto targets = transfer_targets(cargo);
+                std::string nextarg, nextpass;
+                if (targets.size()) {
+                    buf += "\nenum class transfer_t {\nnone,\n";
+                    for (auto& t : targets) {
+                        buf += t + ",\n";
+                    }
+                    buf += "};\n";
+                    nextarg = ", transfer_t* __next = nullptr";
+                    nextpass = ", __next";
+                }
+                auto u = unused_attr(cargo);
+                const std::string args = u + "const std::uint8_t* __p, " + u + "std::size_t __n, " + u + "std::size_t& __pos";
+                buf += "\n" + ctx.error_enum() + " decode(" + args + nextarg + ") {\n";
+                if (auto base = cargo.base.cargo.lock()) {
+                    auto& basename = cargo.base.basename;
+                    auto basetarget = transfer_targets(*base);
+                    std::string basepass;
+                    if (basetarget.size()) {
+                        if (std::find(basetarget.begin(), basetarget.end(), cargo.name) == basetarget.end()) {
+                            return false;
+                        }
+                        buf += basename + "::transfer_t __base_next = " + basename + "::transfer_t::none;\n";
+                        basepass = ", &__base_next";
+                    }
+                    write_if(buf, "auto __e = " + basename + "::decode(__p, __n, __pos" + basepass + "); __e != " + ctx.error_enum() + "::none");
+                    write_beginblock(buf);
+                    write_return(buf, "__e");
+                    write_endblock(buf);
+                    if (basetarget.size()) {
+                        write_check(ctx, buf, "__base_next != " + basename + "::transfer_t::" + cargo.name, cargo.name + "_transfer");
+                    }
+                    write_return(buf, "decode_derived(__p, __n, __pos" + nextpass + ")");
+                    write_endblock(buf);
+                    buf += "\n" + ctx.error_enum() + " decode_derived(" + args + nextarg + ") {\n";
+                }
+                buf += body;
+                write_endblock(buf);
+                buf += fixed;
+                buf += "\n" + ctx.error_enum() + " decode(const std::uint8_t* __p, std::size_t __n) {\n";
+                buf += "std::size_t __pos = 0;\n";
+                write_return(buf, "decode(__p, __n, __pos)");
+                write_endblock(buf);
+                if (!write_resume(ctx, buf, cargo, record)) {
+                    write_no_resume(ctx, buf, cargo);
+                }
+                return write_validate(ctx, buf, cargo, record) && write_validate(ctx, buf, cargo, record, true);
+            }
+        };
+    }  // namespace cpp
+}  // namespace binred
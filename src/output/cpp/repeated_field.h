@@ -0,0 +1,278 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#pragma once
+
+#include "../../parse/parser/parse.h"
+#include "output_context.h"
+#include "../../calc/get_const.h"
+#include "../../calc/trace_expr.h"
+#include "../common/fixed_layout.h"
+#include "io_common.h"
+#include "fixed_codec.h"
+
+namespace binred {
+    namespace cpp {
+        // RepeatedField generates decode/encode of param with repeat decoration
+        // array is resized once before elements are read
+        // array of word integer is copied by one memcpy and swapped in place,
+        // array of fixed cargo uses decode_many, array of leb128/varint uses bulk decoder
+        struct RepeatedField : IOCommon {
+            static const char* varlen_kind(ParamType type) {
+                if (type == ParamType::varint) {
+                    return "varint";
+                }
+                if (type == ParamType::leb128 || type == ParamType::zigzag) {
+                    return "leb128";
+                }
+                return nullptr;
+            }
+
+            // element_size is wire size of one element if it is constant, otherwise 0
+            static size_t element_size(CppOutContext& ctx, std::shared_ptr<Param>& param, Record& record) {
+                if (param->type == ParamType::custom) {
+                    auto found = record.cargos.find(castptr<Custom>(param)->cargoname);
+                    if (found == record.cargos.end()) {
+                        return 0;
+                    }
+                    std::string unused;
+                    if (!FixedCodec::convert(ctx, unused, unused, *found->second, record)) {
+                        return 0;
+                    }
+                    return get_fixed_size(*found->second, record).first;
+                }
+                if (param->type == ParamType::integer || param->type == ParamType::uint) {
+                    auto len = get_const_int<size_t>(length_expr(param));
+                    return len.second && len.first <= 8 ? len.first : 0;
+                }
+                return 0;
+            }
+
+            // short_check(buf, len) writes input length check of decoder mode
+            template <class ShortCheck>
+            static bool write_decode(CppOutContext& ctx, std::string& buf, std::shared_ptr<Param>& param, Cargo& cargo, Record& record, auto& formatter, ShortCheck&& short_check, bool resume, bool validate) {
+                auto& name = param->name;
+                auto type = param->type;
+                auto rt = ctx.helper_namespace();
+                auto err = cargo.name + "_" + name;
+                auto kind = varlen_kind(type);
+                auto elem = element_size(ctx, param, record);
+                auto bytes = param->repeat->bytes;
+                auto order = little_endian(cargo, param) ? "le" : "be";
+                if (type == ParamType::custom) {
+                    if (!record.cargos.count(castptr<Custom>(param)->cargoname)) {
+                        return false;
+                    }
+                    if (resume) {
+                        // progress inside element array is not kept by stream_state
+                        return false;
+                    }
+                }
+                else if (!elem && !kind) {
+                    return false;
+                }
+                auto size = std::to_string(elem);
+                auto expr = "std::size_t(" + trace_expr(param->repeat->expr, formatter) + ")";
+                std::string end = "__n";
+                write_beginblock(buf);
+                if (bytes) {
+                    buf += "std::size_t __len = " + expr + ";\n";
+                    short_check(buf, "__len");
+                    buf += "std::size_t __end = __pos + __len;\n";
+                    end = "__end";
+                    if (elem) {
+                        write_check(ctx, buf, "__len % " + size + " != 0", err + "_length");
+                        buf += "std::size_t __cnt = __len / " + size + ";\n";
+                    }
+                    else if (kind) {
+                        buf += "std::size_t __cnt = " + rt + "::" + kind + "_count(__p + __pos, __len);\n";
+                        write_check(ctx, buf, "__cnt == std::size_t(-1)", err + "_length");
+                    }
+                }
+                else {
+                    buf += "std::size_t __cnt = " + expr + ";\n";
+                    if (elem) {
+                        write_check(ctx, buf, "__cnt > std::size_t(-1) / " + size, err + "_length");
+                        short_check(buf, "__cnt * " + size);
+                    }
+                    else {
+                        // element takes one byte at least, so huge count is rejected before allocation
+                        short_check(buf, "__cnt");
+                    }
+                }
+                if (type == ParamType::custom && !elem) {
+                    auto fn = validate ? ".validate_into(__p, " : ".decode(__p, ";
+                    if (bytes) {
+                        buf += name + ".clear();\n";
+                        buf += "while (__pos < __end) {\n";
+                        buf += "auto& __v = " + name + ".emplace_back();\n";
+                        buf += "std::size_t __start = __pos;\n";
+                    }
+                    else {
+                        buf += name + ".resize(__cnt);\n";
+                        buf += "for (auto& __v : " + name + ") {\n";
+                    }
+                    write_if(buf, std::string("auto __e = __v") + fn + end + ", __pos); __e != " + ctx.error_enum() + "::none");
+                    write_beginblock(buf);
+                    write_return(buf, "__e");
+                    write_endblock(buf);
+                    if (bytes) {
+                        // element which takes no byte would repeat forever
+                        write_check(ctx, buf, "__pos == __start", err + "_length");
+                    }
+                    buf += "}";
+                    write_endblock(buf);
+                    return true;
+                }
+                buf += name + ".resize(__cnt);\n";
+                if (type == ParamType::custom) {
+                    auto& cargoname = castptr<Custom>(param)->cargoname;
+                    if (elem <= 16) {
+                        write_if(buf, "auto __e = " + cargoname + "::decode_many(__p + __pos, __cnt, " + name + ".data()); __e != " + ctx.error_enum() + "::none");
+                    }
+                    else {
+                        buf += "for (std::size_t __i = 0; __i < __cnt; __i++) {\n";
+                        write_if(buf, "auto __e = " + name + "[__i].decode_fixed(__p + __pos + __i * " + size + "); __e != " + ctx.error_enum() + "::none");
+                    }
+                    write_beginblock(buf);
+                    write_return(buf, "__e");
+                    write_endblock(buf);
+                    if (elem > 16) {
+                        buf += "}\n";
+                    }
+                    buf += "__pos += __cnt * " + size + ";";
+                }
+                else if (kind) {
+                    ctx.use_bulk = true;
+                    auto fn = type == ParamType::zigzag ? "::decode_zigzags(__p, " : type == ParamType::varint ? "::decode_varints(__p, " : "::decode_leb128s(__p, ";
+                    write_if(buf, "!" + rt + fn + end + ", __pos, " + name + ".data(), __cnt)");
+                    write_beginblock(buf);
+                    if (bytes) {
+                        ctx.set_error_enum(err + "_length");
+                        write_return(buf, ctx.error_enum() + "::" + err + "_length");
+                    }
+                    else if (resume) {
+                        // bytes needed are unknown until values are scanned
+                        ctx.set_error_enum("need_more");
+                        buf += "__st.need = 1;\n";
+                        write_return(buf, ctx.error_enum() + "::need_more");
+                    }
+                    else {
+                        ctx.set_error_enum(cargo.name + "_short_input");
+                        write_return(buf, ctx.error_enum() + "::" + cargo.name + "_short_input");
+                    }
+                    write_endblock(buf);
+                }
+                else if (FixedCodec::is_word(elem)) {
+                    buf += rt + "::load_" + order + "_array(" + name + ".data(), __p + __pos, __cnt);\n";
+                    buf += "__pos += __cnt * " + size + ";";
+                }
+                else {
+                    auto value = rt + "::load_" + order + "_bytes(__p + __pos, " + size + ")";
+                    if (type == ParamType::integer) {
+                        auto shift = std::to_string(64 - elem * 8);
+                        value = "std::int64_t(" + value + " << " + shift + ") >> " + shift;
+                    }
+                    buf += "for (auto& __v : " + name + ") {\n";
+                    buf += "__v = std::remove_reference_t<decltype(__v)>(" + value + ");\n";
+                    buf += "__pos += " + size + ";";
+                    write_endblock(buf);
+                }
+                write_endblock(buf);
+                return true;
+            }
+
+            // in iov mode, size counts scratch bytes only like WriteToCppEncode
+            static bool write_encode(CppOutContext& ctx, std::string& size, std::string& buf, std::shared_ptr<Param>& param, Cargo& cargo, Record& record, auto& formatter, bool iov) {
+                auto& name = param->name;
+                auto type = param->type;
+                auto rt = ctx.helper_namespace();
+                auto err = cargo.name + "_" + name;
+                auto kind = varlen_kind(type);
+                auto elem = element_size(ctx, param, record);
+                if (type == ParamType::custom) {
+                    if (!record.cargos.count(castptr<Custom>(param)->cargoname)) {
+                        return false;
+                    }
+                }
+                else if (!elem && !kind) {
+                    return false;
+                }
+                auto elemstr = std::to_string(elem);
+                auto order = little_endian(cargo, param) ? "le" : "be";
+                auto expr = "std::size_t(" + trace_expr(param->repeat->expr, formatter) + ")";
+                auto value = type == ParamType::zigzag ? rt + "::zigzag_encode(__v)" : std::string("__v");
+                auto sum = [&](const std::string& var, const std::string& each) {
+                    return "for (auto& __v : " + name + ") {\n" + var + " += " + each + ";\n}\n";
+                };
+                std::string each;
+                if (kind) {
+                    each = rt + "::" + kind + "_size(" + value + ")";
+                }
+                else if (!elem) {
+                    each = "__v.encoded_size()";
+                }
+                if (elem) {
+                    size += "__size += " + name + ".size() * " + elemstr + ";\n";
+                }
+                else {
+                    size += sum("__size", iov && !kind ? "__v.iov_scratch_size()" : each);
+                }
+                write_beginblock(buf);
+                if (param->repeat->bytes) {
+                    if (elem) {
+                        buf += "std::size_t __len = " + name + ".size() * " + elemstr + ";\n";
+                    }
+                    else {
+                        buf += "std::size_t __len = 0;\n";
+                        buf += sum("__len", each);
+                    }
+                    write_check(ctx, buf, "__len != " + expr, err + "_length");
+                }
+                else {
+                    write_check(ctx, buf, name + ".size() != " + expr, err + "_length");
+                }
+                if (type == ParamType::custom) {
+                    buf += "for (auto& __v : " + name + ") {\n";
+                    if (elem) {
+                        write_if(buf, "auto __e = __v.encode_fixed(__out + __pos); __e != " + ctx.error_enum() + "::none");
+                    }
+                    else if (iov) {
+                        write_if(buf, "auto __e = __v.encode_iov_to(__o, __pos); __e != " + ctx.error_enum() + "::none");
+                    }
+                    else {
+                        write_if(buf, "auto __e = __v.encode_to(__out, __pos); __e != " + ctx.error_enum() + "::none");
+                    }
+                    write_beginblock(buf);
+                    write_return(buf, "__e");
+                    write_endblock(buf);
+                    if (elem) {
+                        buf += "__pos += " + elemstr + ";\n";
+                    }
+                    buf += "}";
+                }
+                else if (kind) {
+                    buf += "for (auto& __v : " + name + ") {\n";
+                    buf += "__pos += " + rt + "::store_" + kind + "(__out + __pos, " + value + ");\n";
+                    buf += "}";
+                }
+                else if (FixedCodec::is_word(elem)) {
+                    buf += rt + "::store_" + order + "_array(__out + __pos, " + name + ".data(), " + name + ".size());\n";
+                    buf += "__pos += " + name + ".size() * " + elemstr + ";";
+                }
+                else {
+                    buf += "for (auto& __v : " + name + ") {\n";
+                    buf += rt + "::store_" + order + "_bytes(__out + __pos, std::uint64_t(__v), " + elemstr + ");\n";
+                    buf += "__pos += " + elemstr + ";";
+                    write_endblock(buf);
+                }
+                write_endblock(buf);
+                return true;
+            }
+        };
+    }  // namespace cpp
+}  // namespace binred
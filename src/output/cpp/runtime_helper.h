@@ -0,0 +1,950 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#pragma once
+#include "output_context.h"
+
+namespace binred {
+    namespace cpp {
+        // write_runtime_block writes body into helper namespace under its own include guard
+        // so that headers generated with different options can be included together
+        void write_runtime_block(CppOutContext& ctx, std::string& ret, const char* guard, const char* body) {
+            ret += std::string("\n#ifndef ") + guard + "\n#define " + guard + "\nnamespace " + ctx.helper_namespace() + " {\n";
+            ret += body;
+            ret += "}\n#endif\n";
+        }
+
+        // helper functions used by generated code
+        // output once before generated structs
+        // blocks which only some options or fields need are written only when used
+        std::string runtime_helper(CppOutContext& ctx) {
+            std::string ret;
+            if (ctx.pmr) {
+                ret += "\n#include <memory_resource>";
+            }
+            if (ctx.compare) {
+                ret += "\n#include <compare>\n#include <functional>";
+            }
+            ret += R"(
+#ifndef BINRED_RUNTIME_HELPER
+#define BINRED_RUNTIME_HELPER
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <stdlib.h>
+#include <intrin.h>
+#endif
+namespace )";
+            ret += ctx.helper_namespace();
+            ret += R"( {
+inline std::uint8_t bswap(std::uint8_t v) {
+return v;
+}
+
+inline std::uint16_t bswap(std::uint16_t v) {
+#if defined(_MSC_VER) && !defined(__clang__)
+return _byteswap_ushort(v);
+#else
+return __builtin_bswap16(v);
+#endif
+}
+
+inline std::uint32_t bswap(std::uint32_t v) {
+#if defined(_MSC_VER) && !defined(__clang__)
+return _byteswap_ulong(v);
+#else
+return __builtin_bswap32(v);
+#endif
+}
+
+inline std::uint64_t bswap(std::uint64_t v) {
+#if defined(_MSC_VER) && !defined(__clang__)
+return _byteswap_uint64(v);
+#else
+return __builtin_bswap64(v);
+#endif
+}
+
+template <class T>
+inline T load_be(const std::uint8_t* p) {
+T v;
+::memcpy(&v, p, sizeof(T));
+if constexpr (std::endian::native == std::endian::little) {
+v = bswap(v);
+}
+return v;
+}
+
+template <class T>
+inline T load_ne(const std::uint8_t* p) {
+T v;
+::memcpy(&v, p, sizeof(T));
+return v;
+}
+
+template <class T>
+inline void store_be(std::uint8_t* p, T v) {
+if constexpr (std::endian::native == std::endian::little) {
+v = bswap(v);
+}
+::memcpy(p, &v, sizeof(T));
+}
+
+// load_le/store_le are plain copy on little endian host
+template <class T>
+inline T load_le(const std::uint8_t* p) {
+T v;
+::memcpy(&v, p, sizeof(T));
+if constexpr (std::endian::native == std::endian::big) {
+v = bswap(v);
+}
+return v;
+}
+
+template <class T>
+inline void store_le(std::uint8_t* p, T v) {
+if constexpr (std::endian::native == std::endian::big) {
+v = bswap(v);
+}
+::memcpy(p, &v, sizeof(T));
+}
+
+// varint is QUIC variable-length integer; 2 bit prefix of first byte gives length 1, 2, 4 or 8
+constexpr std::uint64_t varint_max = 0x3fffffffffffffff;
+
+inline std::size_t varint_length(std::uint8_t first) {
+return std::size_t(1) << (first >> 6);
+}
+
+inline std::size_t varint_size(std::uint64_t v) {
+return v < 0x40 ? 1 : v < 0x4000 ? 2 : v < 0x40000000 ? 4 : 8;
+}
+
+// load_varint reads varint whose length is already checked against n
+// if 8 bytes are readable one word is loaded and masked by prefix
+inline std::uint64_t load_varint(const std::uint8_t* p, std::size_t n) {
+auto len = varint_length(p[0]);
+if (n >= 8) {
+auto shift = 64 - len * 8;
+return (load_be<std::uint64_t>(p) >> shift) & (varint_max >> shift);
+}
+std::uint64_t v = p[0] & 0x3f;
+for (std::size_t i = 1; i < len; i++) {
+v = (v << 8) | p[i];
+}
+return v;
+}
+
+// store_varint writes v in shortest form and returns written length
+inline std::size_t store_varint(std::uint8_t* p, std::uint64_t v) {
+auto len = varint_size(v);
+auto w = (v & varint_max) | (std::uint64_t(std::countr_zero(len)) << (len * 8 - 2));
+switch (len) {
+case 1:
+p[0] = std::uint8_t(w);
+break;
+case 2:
+store_be(p, std::uint16_t(w));
+break;
+case 4:
+store_be(p, std::uint32_t(w));
+break;
+default:
+store_be(p, w);
+break;
+}
+return len;
+}
+
+// leb128 carries 7 bit per byte from low to high, top bit tells next byte follows
+// leb128_length returns length of value at p
+// it is n + 1 if no terminator in n (< 10) bytes and 0 if value exceeds 10 bytes
+inline std::size_t leb128_length(const std::uint8_t* p, std::size_t n) {
+if constexpr (std::endian::native == std::endian::little) {
+if (n >= 8) {
+auto stop = ~load_ne<std::uint64_t>(p) & 0x8080808080808080;
+if (stop) {
+return std::size_t(std::countr_zero(stop)) / 8 + 1;
+}
+}
+}
+auto lim = (std::min)(n, std::size_t(10));
+for (std::size_t i = 0; i < lim; i++) {
+if (!(p[i] & 0x80)) {
+return i + 1;
+}
+}
+return n < 10 ? n + 1 : 0;
+}
+
+inline std::uint64_t load_leb128(const std::uint8_t* p, std::size_t len) {
+std::uint64_t v = 0;
+for (std::size_t i = 0; i < len; i++) {
+v |= std::uint64_t(p[i] & 0x7f) << (7 * i);
+}
+return v;
+}
+
+inline std::size_t leb128_size(std::uint64_t v) {
+return std::size_t(64 - std::countl_zero(v | 1) + 6) / 7;
+}
+
+inline std::size_t store_leb128(std::uint8_t* p, std::uint64_t v) {
+std::size_t i = 0;
+for (; v >= 0x80; i++) {
+p[i] = std::uint8_t(v | 0x80);
+v >>= 7;
+}
+p[i] = std::uint8_t(v);
+return i + 1;
+}
+
+inline std::uint64_t zigzag_encode(std::int64_t v) {
+return (std::uint64_t(v) << 1) ^ std::uint64_t(v >> 63);
+}
+
+inline std::int64_t zigzag_decode(std::uint64_t v) {
+return std::int64_t(v >> 1) ^ -std::int64_t(v & 1);
+}
+
+// varint_count/leb128_count count values in len bytes, -1 if last value overruns len
+inline std::size_t varint_count(const std::uint8_t* p, std::size_t len) {
+std::size_t i = 0, count = 0;
+for (; i < len; i += varint_length(p[i])) {
+count++;
+}
+return i == len ? count : std::size_t(-1);
+}
+
+inline std::size_t leb128_count(const std::uint8_t* p, std::size_t len) {
+std::size_t count = 0;
+for (std::size_t i = 0; i < len; i++) {
+count += !(p[i] & 0x80);
+}
+return len == 0 || !(p[len - 1] & 0x80) ? count : std::size_t(-1);
+}
+
+// load_be_array copies count words at once and swaps them in place
+// swap loop has no dependency between words so compiler vectorizes it
+template <class T>
+inline void load_be_array(T* out, const std::uint8_t* p, std::size_t count) {
+if (count) {
+::memcpy(out, p, count * sizeof(T));
+}
+if constexpr (sizeof(T) != 1 && std::endian::native == std::endian::little) {
+using U = std::make_unsigned_t<T>;
+for (std::size_t i = 0; i < count; i++) {
+out[i] = T(bswap(U(out[i])));
+}
+}
+}
+
+template <class T>
+inline void store_be_array(std::uint8_t* p, const T* in, std::size_t count) {
+if constexpr (sizeof(T) == 1 || std::endian::native == std::endian::big) {
+if (count) {
+::memcpy(p, in, count * sizeof(T));
+}
+}
+else {
+using U = std::make_unsigned_t<T>;
+for (std::size_t i = 0; i < count; i++) {
+store_be(p + i * sizeof(T), U(in[i]));
+}
+}
+}
+
+// load_be_bytes/store_be_bytes handle big endian integer of len (not word) bytes
+inline std::uint64_t load_be_bytes(const std::uint8_t* p, std::size_t len) {
+std::uint64_t v = 0;
+for (std::size_t i = 0; i < len; i++) {
+v = (v << 8) | p[i];
+}
+return v;
+}
+
+inline void store_be_bytes(std::uint8_t* p, std::uint64_t v, std::size_t len) {
+for (std::size_t i = 0; i < len; i++) {
+p[i] = std::uint8_t(v >> ((len - i - 1) * 8));
+}
+}
+
+template <class T>
+inline void load_le_array(T* out, const std::uint8_t* p, std::size_t count) {
+if (count) {
+::memcpy(out, p, count * sizeof(T));
+}
+if constexpr (sizeof(T) != 1 && std::endian::native == std::endian::big) {
+using U = std::make_unsigned_t<T>;
+for (std::size_t i = 0; i < count; i++) {
+out[i] = T(bswap(U(out[i])));
+}
+}
+}
+
+template <class T>
+inline void store_le_array(std::uint8_t* p, const T* in, std::size_t count) {
+if constexpr (sizeof(T) == 1 || std::endian::native == std::endian::little) {
+if (count) {
+::memcpy(p, in, count * sizeof(T));
+}
+}
+else {
+using U = std::make_unsigned_t<T>;
+for (std::size_t i = 0; i < count; i++) {
+store_le(p + i * sizeof(T), U(in[i]));
+}
+}
+}
+
+inline std::uint64_t load_le_bytes(const std::uint8_t* p, std::size_t len) {
+std::uint64_t v = 0;
+for (std::size_t i = len; i > 0; i--) {
+v = (v << 8) | p[i - 1];
+}
+return v;
+}
+
+inline void store_le_bytes(std::uint8_t* p, std::uint64_t v, std::size_t len) {
+for (std::size_t i = 0; i < len; i++) {
+p[i] = std::uint8_t(v >> (i * 8));
+}
+}
+
+// stream_state keeps progress of decode_resume between input chunks
+// steps holds done step count of each nesting depth
+// sums holds running checksum of each nesting depth
+// pending holds bytes of the step which is not completed yet
+struct stream_state {
+std::vector<std::size_t> steps;
+std::vector<std::uint32_t> sums;
+std::size_t need = 0;
+std::string pending;
+
+std::size_t& at(std::size_t depth) {
+if (steps.size() <= depth) {
+steps.resize(depth + 1);
+}
+return steps[depth];
+}
+
+std::uint32_t& sum(std::size_t depth) {
+if (sums.size() <= depth) {
+sums.resize(depth + 1);
+}
+return sums[depth];
+}
+
+void reset(std::size_t depth) {
+if (depth < steps.size()) {
+steps.resize(depth);
+}
+if (depth < sums.size()) {
+sums.resize(depth);
+}
+}
+
+void clear() {
+steps.clear();
+sums.clear();
+need = 0;
+pending.clear();
+}
+};
+
+// feed_stream feeds chunk to resume
+// bytes of incomplete step are kept in st.pending and step is run once all its bytes arrive
+// step whose length is known only from its bytes (leb128) may ask more again
+template <class E, class F>
+inline E feed_stream(stream_state& st, const std::uint8_t* p, std::size_t n, std::size_t& pos, E more, F&& resume) {
+while (st.pending.size()) {
+auto take = (std::min)(st.need, n - pos);
+st.pending.append(reinterpret_cast<const char*>(p + pos), take);
+pos += take;
+st.need -= take;
+if (st.need) {
+return more;
+}
+std::size_t ppos = 0;
+auto e = resume(reinterpret_cast<const std::uint8_t*>(st.pending.data()), st.pending.size(), ppos);
+if (e != more) {
+st.clear();
+return e;
+}
+st.pending.erase(0, ppos);
+}
+auto e = resume(p, n, pos);
+if (e == more) {
+st.pending.assign(reinterpret_cast<const char*>(p + pos), n - pos);
+pos = n;
+}
+else {
+st.clear();
+}
+return e;
+}
+
+// iov_out collects output of encode_iov as segment list for writev/sendmsg
+// fixed bytes are written to scratch, large byte field is referenced in place
+// scratch and referenced fields must be alive until segments are written
+template <class Iov>
+struct iov_out {
+Iov* iov = nullptr;
+std::size_t max = 0;
+std::uint8_t* scratch = nullptr;
+std::size_t cap = 0;
+std::size_t count = 0;
+std::size_t begin = 0;
+
+iov_out(Iov* iov, std::size_t max, std::uint8_t* scratch, std::size_t cap)
+: iov(iov), max(max), scratch(scratch), cap(cap) {}
+
+iov_out(const iov_out&) = delete;
+
+void clear() {
+count = 0;
+begin = 0;
+}
+
+// flush appends scratch bytes written since last segment
+bool flush(std::size_t pos) {
+if (pos == begin) {
+return true;
+}
+if (count >= max) {
+return false;
+}
+iov[count].iov_base = scratch + begin;
+iov[count].iov_len = pos - begin;
+count++;
+begin = pos;
+return true;
+}
+
+bool ref(std::size_t pos, const void* p, std::size_t len) {
+if (!flush(pos)) {
+return false;
+}
+if (!len) {
+return true;
+}
+if (count >= max) {
+return false;
+}
+iov[count].iov_base = const_cast<void*>(p);
+iov[count].iov_len = len;
+count++;
+return true;
+}
+};
+
+// iov_checksum sums segments from first, so checksum can cover referenced field
+template <class Iov, class F>
+inline std::uint32_t iov_checksum(const iov_out<Iov>& o, std::size_t first, std::uint32_t sum, F&& f) {
+for (std::size_t i = first; i < o.count; i++) {
+sum = f(sum, static_cast<const std::uint8_t*>(o.iov[i].iov_base), o.iov[i].iov_len);
+}
+return sum;
+}
+
+// iov_buffer is iov_out with inline segment and scratch area
+template <class Iov, std::size_t N = 16, std::size_t S = 256>
+struct iov_buffer : iov_out<Iov> {
+Iov vec[N]{};
+std::uint8_t area[S]{};
+
+iov_buffer()
+: iov_out<Iov>(vec, N, area, S) {}
+};
+}
+#endif
+)";
+            if (ctx.byte_view) {
+                ret += R"(
+#ifndef BINRED_RUNTIME_OWNED
+#define BINRED_RUNTIME_OWNED
+#include <memory>
+namespace )";
+                ret += ctx.helper_namespace();
+                ret += R"( {
+// owned is value returned by to_owned in byte_view mode
+// its views point into storage which is allocated once and does not move with owned
+template <class T>
+struct owned {
+std::unique_ptr<char[]> storage;
+T value;
+
+const T& operator*() const {
+return value;
+}
+
+const T* operator->() const {
+return &value;
+}
+};
+}
+#endif
+)";
+            }
+            // intrinsics are needed by cpu dispatched blocks only
+            if (ctx.use_checksum || ctx.use_decode_many || ctx.use_bulk) {
+                ret += R"(
+#ifndef BINRED_RUNTIME_INTRIN
+#define BINRED_RUNTIME_INTRIN
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define BINRED_RUNTIME_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#define BINRED_TARGET(x)
+#else
+#define BINRED_TARGET(x) __attribute__((target(x)))
+#endif
+#endif
+#endif
+)";
+            }
+            if (ctx.compare) {
+                write_runtime_block(ctx, ret, "BINRED_RUNTIME_HASH", R"(
+// hash functions are wyhash style: 64x64 to 128 bit multiply folded into 64 bit
+// hash value is for in-process table only and not stable across versions
+constexpr std::uint64_t hash_p0 = 0xa0761d6478bd642f, hash_p1 = 0xe7037ed1a0b428db;
+constexpr std::uint64_t hash_p2 = 0x8ebc6af09c88c6e3, hash_p3 = 0x589965cc75374cc3;
+
+inline void hash_mum(std::uint64_t& a, std::uint64_t& b) {
+#if defined(__SIZEOF_INT128__)
+__uint128_t r = __uint128_t(a) * b;
+a = std::uint64_t(r);
+b = std::uint64_t(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+a = _umul128(a, b, &b);
+#else
+std::uint64_t ha = a >> 32, hb = b >> 32, la = std::uint32_t(a), lb = std::uint32_t(b);
+std::uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32);
+std::uint64_t c = t < rl;
+std::uint64_t lo = t + (rm1 << 32);
+c += lo < t;
+a = lo;
+b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+inline std::uint64_t hash_mix(std::uint64_t a, std::uint64_t b) {
+hash_mum(a, b);
+return a ^ b;
+}
+
+// hash_word folds one field value into running hash
+inline std::uint64_t hash_word(std::uint64_t h, std::uint64_t v) {
+return hash_mix(h ^ hash_p0, v ^ hash_p1);
+}
+
+inline std::uint64_t hash_bytes(const std::uint8_t* p, std::size_t n, std::uint64_t seed) {
+seed ^= hash_mix(seed ^ hash_p0, hash_p1);
+std::uint64_t a = 0, b = 0;
+if (n <= 16) {
+if (n >= 4) {
+auto mid = (n >> 3) << 2;
+a = (std::uint64_t(load_le<std::uint32_t>(p)) << 32) | load_le<std::uint32_t>(p + mid);
+b = (std::uint64_t(load_le<std::uint32_t>(p + n - 4)) << 32) | load_le<std::uint32_t>(p + n - 4 - mid);
+}
+else if (n > 0) {
+a = (std::uint64_t(p[0]) << 16) | (std::uint64_t(p[n >> 1]) << 8) | p[n - 1];
+}
+}
+else {
+auto i = n;
+if (i > 48) {
+auto s1 = seed, s2 = seed;
+// three independent lanes keep multipliers busy
+do {
+seed = hash_mix(load_le<std::uint64_t>(p) ^ hash_p1, load_le<std::uint64_t>(p + 8) ^ seed);
+s1 = hash_mix(load_le<std::uint64_t>(p + 16) ^ hash_p2, load_le<std::uint64_t>(p + 24) ^ s1);
+s2 = hash_mix(load_le<std::uint64_t>(p + 32) ^ hash_p3, load_le<std::uint64_t>(p + 40) ^ s2);
+p += 48;
+i -= 48;
+} while (i > 48);
+seed ^= s1 ^ s2;
+}
+while (i > 16) {
+seed = hash_mix(load_le<std::uint64_t>(p) ^ hash_p1, load_le<std::uint64_t>(p + 8) ^ seed);
+p += 16;
+i -= 16;
+}
+a = load_le<std::uint64_t>(p + i - 16);
+b = load_le<std::uint64_t>(p + i - 8);
+}
+a ^= hash_p1;
+b ^= seed;
+hash_mum(a, b);
+return hash_mix(a ^ hash_p0 ^ n, b ^ hash_p1);
+}
+)");
+            }
+            if (ctx.harness) {
+                write_runtime_block(ctx, ret, "BINRED_RUNTIME_RANDOM", R"(
+// random_next is splitmix64 used by generated randomize (bench corpus)
+inline std::uint64_t random_next(std::uint64_t& s) {
+std::uint64_t z = (s += 0x9e3779b97f4a7c15);
+z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+return z ^ (z >> 31);
+}
+
+// random_value is small for first attempts so that length fields stay short
+// later attempts widen range to meet bind constraint
+inline std::uint64_t random_value(std::uint64_t& s, std::size_t attempt) {
+auto v = random_next(s);
+switch (attempt % 4) {
+case 0:
+return v % 16;
+case 1:
+return v % 2;
+case 2:
+return v & 0xff;
+default:
+return v;
+}
+}
+
+inline void random_fill(std::uint64_t& s, void* p, std::size_t n) {
+auto out = static_cast<std::uint8_t*>(p);
+for (std::size_t i = 0; i < n; i++) {
+out[i] = std::uint8_t(random_next(s));
+}
+}
+)");
+            }
+            if (ctx.use_decode_many) {
+                write_runtime_block(ctx, ret, "BINRED_RUNTIME_DECODE_MANY", R"(
+template <class T>
+inline auto decode_many_scalar(const std::uint8_t* p, std::size_t count, T* out, std::size_t i = 0) {
+for (; i < count; i++) {
+if (auto e = out[i].decode_fixed(p + i * T::fixed_size); e != decltype(e){}) {
+return e;
+}
+}
+return decltype(out->decode_fixed(p)){};
+}
+
+#ifdef BINRED_RUNTIME_X86
+enum class simd_level {
+none,
+ssse3,
+avx2,
+};
+
+inline simd_level get_simd_level() {
+static const simd_level level = [] {
+#if defined(_MSC_VER) && !defined(__clang__)
+int info[4];
+__cpuid(info, 0);
+if (info[0] >= 7) {
+__cpuidex(info, 7, 0);
+if (info[1] & (1 << 5)) {
+return simd_level::avx2;
+}
+}
+__cpuid(info, 1);
+if (info[2] & (1 << 9)) {
+return simd_level::ssse3;
+}
+return simd_level::none;
+#else
+__builtin_cpu_init();
+if (__builtin_cpu_supports("avx2")) {
+return simd_level::avx2;
+}
+if (__builtin_cpu_supports("ssse3")) {
+return simd_level::ssse3;
+}
+return simd_level::none;
+#endif
+}();
+return level;
+}
+
+// every record is loaded as 16 byte so records which may overrun input are left to scalar loop
+template <class T>
+BINRED_TARGET("ssse3")
+inline auto decode_many_ssse3(const std::uint8_t* p, std::size_t count, T* out) {
+const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(T::swap_mask));
+alignas(16) std::uint8_t img[16];
+std::size_t i = 0;
+for (; i * T::fixed_size + 16 <= count * T::fixed_size; i++) {
+__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i * T::fixed_size));
+_mm_store_si128(reinterpret_cast<__m128i*>(img), _mm_shuffle_epi8(v, mask));
+if (auto e = out[i].decode_native(img); e != decltype(e){}) {
+return e;
+}
+}
+return decode_many_scalar(p, count, out, i);
+}
+
+// two records are shuffled at once, one per 128 bit lane
+template <class T>
+BINRED_TARGET("avx2")
+inline auto decode_many_avx2(const std::uint8_t* p, std::size_t count, T* out) {
+const __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(T::swap_mask));
+const __m256i mask = _mm256_set_m128i(half, half);
+alignas(32) std::uint8_t img[32];
+std::size_t i = 0;
+for (; (i + 1) * T::fixed_size + 16 <= count * T::fixed_size; i += 2) {
+const std::uint8_t* base = p + i * T::fixed_size;
+__m256i v = _mm256_set_m128i(_mm_loadu_si128(reinterpret_cast<const __m128i*>(base + T::fixed_size)),
+_mm_loadu_si128(reinterpret_cast<const __m128i*>(base)));
+_mm256_store_si256(reinterpret_cast<__m256i*>(img), _mm256_shuffle_epi8(v, mask));
+if (auto e = out[i].decode_native(img); e != decltype(e){}) {
+return e;
+}
+if (auto e = out[i + 1].decode_native(img + 16); e != decltype(e){}) {
+return e;
+}
+}
+return decode_many_scalar(p, count, out, i);
+}
+#endif
+
+// decode_many is dispatched by cpu feature on x86 and falls back to scalar loop elsewhere
+template <class T>
+inline auto decode_many(const std::uint8_t* p, std::size_t count, T* out) {
+#ifdef BINRED_RUNTIME_X86
+switch (get_simd_level()) {
+case simd_level::avx2:
+return decode_many_avx2(p, count, out);
+case simd_level::ssse3:
+return decode_many_ssse3(p, count, out);
+default:
+break;
+}
+#endif
+return decode_many_scalar(p, count, out);
+}
+)");
+            }
+            if (ctx.use_checksum) {
+                write_runtime_block(ctx, ret, "BINRED_RUNTIME_CHECKSUM", R"(
+// checksum functions take running value like zlib (0 for crc, 1 for adler32 at start)
+// so message can be summed in pieces
+// crc_table is slicing-by-8 table of reflected polynomial
+struct crc_table {
+std::uint32_t t[8][256];
+};
+
+constexpr crc_table make_crc_table(std::uint32_t poly) {
+crc_table ret{};
+for (std::uint32_t i = 0; i < 256; i++) {
+std::uint32_t c = i;
+for (int k = 0; k < 8; k++) {
+c = (c >> 1) ^ (c & 1 ? poly : 0);
+}
+ret.t[0][i] = c;
+}
+for (std::size_t k = 1; k < 8; k++) {
+for (std::size_t i = 0; i < 256; i++) {
+ret.t[k][i] = (ret.t[k - 1][i] >> 8) ^ ret.t[0][ret.t[k - 1][i] & 0xff];
+}
+}
+return ret;
+}
+
+inline constexpr crc_table crc32_table = make_crc_table(0xedb88320);
+inline constexpr crc_table crc32c_table = make_crc_table(0x82f63b78);
+
+inline std::uint32_t crc_slice8(const crc_table& tb, std::uint32_t crc, const std::uint8_t* p, std::size_t n) {
+crc = ~crc;
+for (; n >= 8; p += 8, n -= 8) {
+std::uint64_t w = load_le<std::uint64_t>(p) ^ crc;
+crc = tb.t[7][w & 0xff] ^ tb.t[6][(w >> 8) & 0xff] ^ tb.t[5][(w >> 16) & 0xff] ^ tb.t[4][(w >> 24) & 0xff] ^
+tb.t[3][(w >> 32) & 0xff] ^ tb.t[2][(w >> 40) & 0xff] ^ tb.t[1][(w >> 48) & 0xff] ^ tb.t[0][w >> 56];
+}
+for (; n; p++, n--) {
+crc = tb.t[0][(crc ^ *p) & 0xff] ^ (crc >> 8);
+}
+return ~crc;
+}
+
+#ifdef BINRED_RUNTIME_X86
+inline bool has_sse42() {
+static const bool supported = [] {
+#if defined(_MSC_VER) && !defined(__clang__)
+int info[4];
+__cpuid(info, 1);
+return (info[2] & (1 << 20)) != 0;
+#else
+__builtin_cpu_init();
+return __builtin_cpu_supports("sse4.2") != 0;
+#endif
+}();
+return supported;
+}
+
+BINRED_TARGET("sse4.2")
+inline std::uint32_t crc32c_sse42(std::uint32_t crc, const std::uint8_t* p, std::size_t n) {
+crc = ~crc;
+#if defined(__x86_64__) || defined(_M_X64)
+std::uint64_t c = crc;
+for (; n >= 8; p += 8, n -= 8) {
+c = _mm_crc32_u64(c, load_ne<std::uint64_t>(p));
+}
+crc = std::uint32_t(c);
+#endif
+for (; n >= 4; p += 4, n -= 4) {
+crc = _mm_crc32_u32(crc, load_ne<std::uint32_t>(p));
+}
+for (; n; p++, n--) {
+crc = _mm_crc32_u8(crc, *p);
+}
+return ~crc;
+}
+#endif
+
+inline std::uint32_t crc32c(std::uint32_t crc, const std::uint8_t* p, std::size_t n) {
+#ifdef BINRED_RUNTIME_X86
+if (has_sse42()) {
+return crc32c_sse42(crc, p, n);
+}
+#endif
+return crc_slice8(crc32c_table, crc, p, n);
+}
+
+inline std::uint32_t crc32(std::uint32_t crc, const std::uint8_t* p, std::size_t n) {
+return crc_slice8(crc32_table, crc, p, n);
+}
+
+// sums are reduced once per 5552 bytes, the longest run which can not overflow 32 bit
+inline std::uint32_t adler32(std::uint32_t adler, const std::uint8_t* p, std::size_t n) {
+std::uint32_t a = adler & 0xffff, b = adler >> 16;
+while (n) {
+auto run = (std::min)(n, std::size_t(5552));
+n -= run;
+for (; run; run--) {
+a += *p++;
+b += a;
+}
+a %= 65521;
+b %= 65521;
+}
+return (b << 16) | a;
+}
+)");
+            }
+            if (ctx.use_bulk) {
+                write_runtime_block(ctx, ret, "BINRED_RUNTIME_BULK", R"(
+#ifdef BINRED_RUNTIME_X86
+// varint_short16 reports whether next 16 bytes are all 1 byte varint (prefix 00)
+BINRED_TARGET("sse2")
+inline bool varint_short16(const std::uint8_t* p) {
+auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+// bit 6 is moved to sign bit by x + x
+return _mm_movemask_epi8(_mm_or_si128(x, _mm_add_epi8(x, x))) == 0;
+}
+#endif
+
+// decode_varints decodes count varints from p + pos into out
+// returns false if input is short; pos is not advanced in that case
+inline bool decode_varints(const std::uint8_t* p, std::size_t n, std::size_t& pos, std::uint64_t* out, std::size_t count) {
+auto cur = pos;
+std::size_t i = 0;
+while (i < count) {
+#ifdef BINRED_RUNTIME_X86
+if (count - i >= 16 && n - cur >= 16 && varint_short16(p + cur)) {
+for (std::size_t k = 0; k < 16; k++) {
+out[i + k] = p[cur + k];
+}
+i += 16;
+cur += 16;
+continue;
+}
+#endif
+if (cur >= n || n - cur < varint_length(p[cur])) {
+return false;
+}
+out[i] = load_varint(p + cur, n - cur);
+cur += varint_length(p[cur]);
+i++;
+}
+pos = cur;
+return true;
+}
+
+#ifdef BINRED_RUNTIME_X86
+// leb128_mask16 returns continuation bits of next 16 bytes, bit k for byte k
+BINRED_TARGET("sse2")
+inline unsigned leb128_mask16(const std::uint8_t* p) {
+return unsigned(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))));
+}
+#endif
+
+// decode_leb128s decodes count leb128 values from p + pos into out
+// on x86 16 bytes are scanned at once and every value ending in them is split by continuation mask
+// returns false if input is short or value exceeds 10 bytes; pos is not advanced in that case
+inline bool decode_leb128s(const std::uint8_t* p, std::size_t n, std::size_t& pos, std::uint64_t* out, std::size_t count) {
+auto cur = pos;
+std::size_t i = 0;
+while (i < count) {
+#ifdef BINRED_RUNTIME_X86
+if (n - cur >= 16) {
+auto cont = leb128_mask16(p + cur);
+if (cont == 0 && count - i >= 16) {
+for (std::size_t k = 0; k < 16; k++) {
+out[i + k] = p[cur + k];
+}
+i += 16;
+cur += 16;
+continue;
+}
+auto ends = ~cont & 0xffff;
+if (!ends) {
+return false;
+}
+unsigned start = 0;
+while (ends && i < count) {
+unsigned last = std::countr_zero(ends);
+if (last - start >= 10) {
+return false;
+}
+out[i] = load_leb128(p + cur + start, last - start + 1);
+i++;
+start = last + 1;
+ends &= ends - 1;
+}
+cur += start;
+continue;
+}
+#endif
+auto len = leb128_length(p + cur, n - cur);
+if (len == 0 || n - cur < len) {
+return false;
+}
+out[i] = load_leb128(p + cur, len);
+cur += len;
+i++;
+}
+pos = cur;
+return true;
+}
+
+inline bool decode_zigzags(const std::uint8_t* p, std::size_t n, std::size_t& pos, std::int64_t* out, std::size_t count) {
+if (!decode_leb128s(p, n, pos, reinterpret_cast<std::uint64_t*>(out), count)) {
+return false;
+}
+for (std::size_t i = 0; i < count; i++) {
+out[i] = zigzag_decode(std::uint64_t(out[i]));
+}
+return true;
+}
+)");
+            }
+            return ret;
+        }
+    }  // namespace cpp
+}  // namespace binred
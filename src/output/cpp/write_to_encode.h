@@ -0,0 +1,451 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#pragma once
+
+#include "../../parse/parser/parse.h"
+#include "output_context.h"
+#include "../../calc/get_const.h"
+#include "../../calc/trace_expr.h"
+#include "io_common.h"
+#include "fixed_codec.h"
+#include "repeated_field.h"
+#include "checksum_field.h"
+
+namespace binred {
+    namespace cpp {
+        // WriteToCppEncode lowers `write` block of cargo into encoded_size and encode_to member function
+        // encoded_size computes exact output length, encode_to writes into caller buffer (__out) in one pass
+        // if cargo has no write block, params are written in declared order
+        struct WriteToCppEncode : IOCommon {
+            static std::string write_be(size_t len, const std::string& value, bool little = false) {
+                std::string ret;
+                for (size_t i = 0; i < len; i++) {
+                    auto shift = (little ? i : len - i - 1) * 8;
+                    ret += "__out[__pos + " + std::to_string(i) + "] = std::uint8_t(std::uint64_t(" + value + ")";
+                    if (shift) {
+                        ret += " >> " + std::to_string(shift);
+                    }
+                    ret += ");\n";
+                }
+                return ret;
+            }
+
+            // in iov mode, size counts scratch bytes only and byte field of non-constant layout is referenced by __o
+            static bool write_push_param(CppOutContext& ctx, std::string& size, std::string& buf, std::shared_ptr<Param>& param, std::shared_ptr<Expr>& len, Cargo& cargo, Record& record, auto& formatter, bool iov = false) {
+                auto& name = param->name;
+                auto type = param->type;
+                if (!write_param_check(ctx, buf, param, cargo, formatter)) {
+                    return false;
+                }
+                ChecksumField::write_mark(ctx, buf, cargo, name, iov);
+                if (param->repeat) {
+                    return RepeatedField::write_encode(ctx, size, buf, param, cargo, record, formatter, iov);
+                }
+                if (type == ParamType::integer || type == ParamType::uint || type == ParamType::bit) {
+                    auto got = get_const_int<size_t>(len);
+                    if (!got.second || got.first == 0 || got.first > 8) {
+                        return false;
+                    }
+                    auto lenstr = std::to_string(got.first);
+                    size += "__size += " + lenstr + ";\n";
+                    BitField bits;
+                    if (param->checksum) {
+                        if (got.first != 4) {
+                            return false;
+                        }
+                        write_beginblock(buf);
+                        buf += "std::uint32_t __sum = " + ChecksumField::encoded_sum(ctx, buf, param, cargo, iov) + ";\n";
+                        buf += write_be(got.first, "__sum", little_endian(cargo, param));
+                        buf += "__pos += " + lenstr + ";";
+                        write_endblock(buf);
+                        return true;
+                    }
+                    buf += write_be(got.first, type == ParamType::bit && get_bitfield(cargo, name, bits) ? "get_" + name + "()" : name, little_endian(cargo, param));
+                    buf += "__pos += " + lenstr + ";\n";
+                }
+                else if (type == ParamType::varint || type == ParamType::leb128 || type == ParamType::zigzag) {
+                    // length of push is ignored, value is written in shortest form
+                    auto rt = ctx.helper_namespace();
+                    auto kind = type == ParamType::varint ? "varint" : "leb128";
+                    auto value = type == ParamType::zigzag ? rt + "::zigzag_encode(" + name + ")" : name;
+                    size += "__size += " + rt + "::" + kind + "_size(" + value + ");\n";
+                    buf += "__pos += " + rt + "::store_" + kind + "(__out + __pos, " + value + ");\n";
+                }
+                else if (type == ParamType::byte) {
+                    auto declared = get_const_int<size_t>(length_expr(param));
+                    if (ctx.allow_fixed() && declared.second && declared.first != 0) {
+                        auto got = get_const_int<size_t>(len);
+                        if (!got.second || declared.first != got.first) {
+                            return false;
+                        }
+                        auto lenstr = std::to_string(got.first);
+                        size += "__size += " + lenstr + ";\n";
+                        write_call(buf, "::memcpy", "__out + __pos", name, lenstr) += ";\n";
+                        buf += "__pos += " + lenstr + ";\n";
+                    }
+                    else {
+                        auto lenexpr = "std::size_t(" + trace_expr(len, formatter) + ")";
+                        if (!iov) {
+                            size += "__size += " + lenexpr + ";\n";
+                        }
+                        write_beginblock(buf);
+                        buf += "std::size_t __len = " + lenexpr + ";\n";
+                        write_check(ctx, buf, ctx.length_of_byte(name) + " != __len", cargo.name + "_" + name + "_length");
+                        if (iov) {
+                            write_check(ctx, buf, "!__o.ref(__pos, std::data(" + name + "), __len)", cargo.name + "_iov_count");
+                        }
+                        else {
+                            write_call(buf, "::memcpy", "__out + __pos", "std::data(" + name + ")", "__len") += ";\n";
+                            buf += "__pos += __len;";
+                        }
+                        write_endblock(buf);
+                    }
+                }
+                else if (type == ParamType::custom) {
+                    if (!record.cargos.count(castptr<Custom>(param)->cargoname)) {
+                        return false;
+                    }
+                    if (iov) {
+                        size += "__size += " + name + ".iov_scratch_size();\n";
+                        write_if(buf, "auto __e = " + name + ".encode_iov_to(__o, __pos); __e != " + ctx.error_enum() + "::none");
+                    }
+                    else {
+                        size += "__size += " + name + ".encoded_size();\n";
+                        write_if(buf, "auto __e = " + name + ".encode_to(__out, __pos); __e != " + ctx.error_enum() + "::none");
+                    }
+                    write_beginblock(buf);
+                    write_return(buf, "__e");
+                    write_endblock(buf);
+                }
+                else {
+                    return false;
+                }
+                return true;
+            }
+
+            // packed bit run is written by one big endian store from its storage word
+            static bool write_packed_run(CppOutContext& ctx, std::string& size, std::string& buf, BitField& bits, std::vector<std::shared_ptr<Param>*>& run, Cargo& cargo, auto& formatter) {
+                for (auto p : run) {
+                    write_param_check(ctx, buf, *p, cargo, formatter);
+                }
+                auto bytes = bits.total / 8;
+                size += "__size += " + std::to_string(bytes) + ";\n";
+                if (bits.total == bits.storage_bits) {
+                    buf += ctx.helper_namespace() + "::store_be<" + storage_type(bits.storage_bits) + ">(__out + __pos, " + bits.storage + ");\n";
+                }
+                else {
+                    buf += write_be(bytes, bits.storage);
+                }
+                buf += "__pos += " + std::to_string(bytes) + ";\n";
+                run.clear();
+                return true;
+            }
+
+            static bool write_bit_run(CppOutContext& ctx, std::string& size, std::string& buf, std::vector<std::shared_ptr<Param>*>& run, Cargo& cargo, auto& formatter, bool iov) {
+                for (auto p : run) {
+                    ChecksumField::write_mark(ctx, buf, cargo, (*p)->name, iov);
+                }
+                if (BitField bits; get_bitfield(cargo, (*run[0])->name, bits)) {
+                    return write_packed_run(ctx, size, buf, bits, run, cargo, formatter);
+                }
+                size_t total = 0;
+                std::vector<size_t> width;
+                for (auto p : run) {
+                    auto w = get_const_int<size_t>(length_expr(*p));
+                    if (!w.second || w.first == 0) {
+                        return false;
+                    }
+                    width.push_back(w.first);
+                    total += w.first;
+                    write_param_check(ctx, buf, *p, cargo, formatter);
+                }
+                if (total % 8 != 0 || total > 64) {
+                    return false;
+                }
+                auto bytes = total / 8;
+                size += "__size += " + std::to_string(bytes) + ";\n";
+                write_beginblock(buf);
+                buf += "std::uint64_t __bits = 0;\n";
+                auto shift = total;
+                for (size_t i = 0; i < run.size(); i++) {
+                    auto& name = (*run[i])->name;
+                    shift -= width[i];
+                    auto mask = bitfield_mask(width[i]);
+                    buf += "__bits |= (std::uint64_t(" + name + ") & " + mask + ") << " + std::to_string(shift) + ";\n";
+                }
+                buf += write_be(bytes, "__bits");
+                buf += "__pos += " + std::to_string(bytes) + ";";
+                write_endblock(buf);
+                run.clear();
+                return true;
+            }
+
+            static bool write_implicit(CppOutContext& ctx, std::string& size, std::string& buf, Cargo& cargo, Record& record, auto& formatter, bool iov) {
+                std::vector<std::shared_ptr<Param>*> run;
+                for (auto& param : cargo.params) {
+                    if (param->type == ParamType::bit && !param->if_c) {
+                        run.push_back(&param);
+                        continue;
+                    }
+                    if (run.size() && !write_bit_run(ctx, size, buf, run, cargo, formatter, iov)) {
+                        return false;
+                    }
+                    if (is_absent(param)) {
+                        continue;
+                    }
+                    if (param->if_c) {
+                        auto cond = trace_expr(param->if_c->expr, formatter);
+                        write_if(size, cond);
+                        write_beginblock(size);
+                        write_if(buf, cond);
+                        write_beginblock(buf);
+                    }
+                    if (param->type == ParamType::bit) {
+                        run.push_back(&param);
+                        if (!write_bit_run(ctx, size, buf, run, cargo, formatter, iov)) {
+                            return false;
+                        }
+                    }
+                    else if (param->type == ParamType::custom) {
+                        std::shared_ptr<Expr> nolen;
+                        if (!write_push_param(ctx, size, buf, param, nolen, cargo, record, formatter, iov)) {
+                            return false;
+                        }
+                    }
+                    else if (!write_push_param(ctx, size, buf, param, length_expr(param), cargo, record, formatter, iov)) {
+                        return false;
+                    }
+                    if (param->if_c) {
+                        write_endblock(size);
+                        write_endblock(buf);
+                    }
+                }
+                if (run.size() && !write_bit_run(ctx, size, buf, run, cargo, formatter, iov)) {
+                    return false;
+                }
+                return true;
+            }
+
+            static bool write_commands(CppOutContext& ctx, std::string& size, std::string& buf, std::vector<std::shared_ptr<Command>>& cmds, Cargo& cargo, Record& record, auto& formatter, bool iov) {
+                auto write_stop = [&] {
+                    write_return(size, "__size");
+                    write_return(buf, ctx.error_enum() + "::none");
+                };
+                for (auto& c : cmds) {
+                    switch (c->kind) {
+                        case CommandKind::push: {
+                            auto push = castptr<PushCommand>(c);
+                            if (push->refid.size()) {
+                                auto param = find_param(cargo, push->refid);
+                                if (!param) {
+                                    return false;
+                                }
+                                if (!write_push_param(ctx, size, buf, *param, push->numpop, cargo, record, formatter, iov)) {
+                                    return false;
+                                }
+                                break;
+                            }
+                            auto lenexpr = "std::size_t(" + trace_expr(push->numpop, formatter) + ")";
+                            size += "__size += " + lenexpr + ";\n";
+                            write_beginblock(buf);
+                            buf += "std::size_t __len = " + lenexpr + ";\n";
+                            write_call(buf, "::memset", "__out + __pos", "0", "__len") += ";\n";
+                            buf += "__pos += __len;";
+                            write_endblock(buf);
+                            break;
+                        }
+                        case CommandKind::if_: {
+                            auto cif = castptr<IfCommand>(c);
+                            for (size_t i = 0; i < cif->ifs.size(); i++) {
+                                auto& cond = cif->ifs[i];
+                                if (i != 0) {
+                                    size += "else ";
+                                    buf += "else ";
+                                }
+                                if (cond->expr) {
+                                    auto condstr = trace_expr(cond->expr, formatter);
+                                    write_if(size, condstr);
+                                    write_if(buf, condstr);
+                                }
+                                write_beginblock(size);
+                                write_beginblock(buf);
+                                if (!write_commands(ctx, size, buf, cond->cmds, cargo, record, formatter, iov)) {
+                                    return false;
+                                }
+                                write_endblock(size);
+                                write_endblock(buf);
+                            }
+                            break;
+                        }
+                        case CommandKind::bind:
+                            write_check(ctx, buf, write_not(trace_expr(castptr<BindCommand>(c)->expr, formatter)), cargo.name + "_write_bind");
+                            break;
+                        case CommandKind::test:
+                            write_check(ctx, buf, write_not(trace_expr(castptr<TestCommand>(c)->expr, formatter)), cargo.name + "_write_test");
+                            break;
+                        case CommandKind::call: {
+                            std::shared_ptr<Expr> call = castptr<CallCommand>(c)->call;
+                            buf += trace_expr(call, formatter) + ";\n";
+                            break;
+                        }
+                        case CommandKind::transfer_direct:
+                            write_stop();
+                            size += "\n";
+                            buf += "\n";
+                            break;
+                        case CommandKind::transfer_if: {
+                            auto cond = trace_expr(castptr<TransferIf>(c)->cond, formatter);
+                            write_if(size, cond);
+                            write_beginblock(size);
+                            write_if(buf, cond);
+                            write_beginblock(buf);
+                            write_stop();
+                            write_endblock(size);
+                            write_endblock(buf);
+                            break;
+                        }
+                        case CommandKind::transfer_switch:
+                            // derived cargo is encoded by its own encode_to after base part
+                            write_stop();
+                            size += "\n";
+                            buf += "\n";
+                            break;
+                        default:
+                            return false;
+                    }
+                }
+                return true;
+            }
+
+            // ends_with_stop reports whether last command already returned by write_stop
+            static bool ends_with_stop(std::vector<std::shared_ptr<Command>>& cmds) {
+                if (cmds.empty()) {
+                    return false;
+                }
+                auto kind = cmds.back()->kind;
+                return kind == CommandKind::transfer_direct || kind == CommandKind::transfer_switch;
+            }
+
+            static bool write_body(CppOutContext& ctx, std::string& size, std::string& body, std::string& fixed, Cargo& cargo, Record& record, bool iov) {
+                std::string current;
+                auto formatter = format_alias_and_cargo(record, current, cargo);
+                std::string unused;
+                ChecksumField::write_begin(ctx, body, cargo, iov);
+                if (FixedCodec::convert(ctx, unused, fixed, cargo, record)) {
+                    size += "__size += fixed_size;\n";
+                    write_if(body, "auto __e = encode_fixed(__out + __pos); __e != " + ctx.error_enum() + "::none");
+                    write_beginblock(body);
+                    write_return(body, "__e");
+                    write_endblock(body);
+                    body += "__pos += fixed_size;\n";
+                }
+                else if (auto write = cargo.write.lock()) {
+                    if (!write_commands(ctx, size, body, write->cmds, cargo, record, formatter, iov)) {
+                        return false;
+                    }
+                    if (ends_with_stop(write->cmds)) {
+                        return true;
+                    }
+                }
+                else if (!write_implicit(ctx, size, body, cargo, record, formatter, iov)) {
+                    return false;
+                }
+                write_return(size, "__size");
+                write_return(body, ctx.error_enum() + "::none");
+                return true;
+            }
+
+            // write_iov generates encode_iov which fills iov_out instead of one flat buffer
+            // iov_scratch_size is bytes written to scratch, so caller can size scratch
+            static bool write_iov(CppOutContext& ctx, std::string& buf, Cargo& cargo, Record& record) {
+                std::string size, body, unused;
+                if (!write_body(ctx, size, body, unused, cargo, record, true)) {
+                    return false;
+                }
+                auto base = cargo.base.cargo.lock();
+                auto& basename = cargo.base.basename;
+                auto rt = ctx.helper_namespace();
+                const std::string args = rt + "::iov_out<Iov>& __o, std::size_t& __pos";
+                buf += "\nstd::size_t iov_scratch_size() const {\n";
+                if (base) {
+                    buf += "std::size_t __size = " + basename + "::iov_scratch_size();\n";
+                }
+                else {
+                    buf += "std::size_t __size = 0;\n";
+                }
+                buf += size;
+                write_endblock(buf);
+                buf += "\ntemplate <class Iov>\n" + ctx.error_enum() + " encode_iov_to(" + args + ") const {\n";
+                if (base) {
+                    write_if(buf, "auto __e = " + basename + "::encode_iov_to(__o, __pos); __e != " + ctx.error_enum() + "::none");
+                    write_beginblock(buf);
+                    write_return(buf, "__e");
+                    write_endblock(buf);
+                    write_return(buf, "encode_iov_derived(__o, __pos)");
+                    write_endblock(buf);
+                    buf += "\ntemplate <class Iov>\n" + ctx.error_enum() + " encode_iov_derived(" + args + ") const {\n";
+                }
+                buf += "std::uint8_t* __out = __o.scratch;\n";
+                buf += body;
+                write_endblock(buf);
+                buf += "\ntemplate <class Iov>\n" + ctx.error_enum() + " encode_iov(" + rt + "::iov_out<Iov>& __o) const {\n";
+                write_check(ctx, buf, "iov_scratch_size() > __o.cap", cargo.name + "_iov_scratch");
+                buf += "__o.clear();\n";
+                buf += "std::size_t __pos = 0;\n";
+                write_if(buf, "auto __e = encode_iov_to(__o, __pos); __e != " + ctx.error_enum() + "::none");
+                write_beginblock(buf);
+                write_return(buf, "__e");
+                write_endblock(buf);
+                write_check(ctx, buf, "!__o.flush(__pos)", cargo.name + "_iov_count");
+                write_return(buf, ctx.error_enum() + "::none");
+                write_endblock(buf);
+                return true;
+            }
+
+            // convert requires TypeResolver (output/common/analisis/resolve_names.h)
+            // to link write block and base cargo
+            static bool convert(CppOutContext& ctx, std::string& buf, Cargo& cargo, Record& record) {
+                std::string size, body, fixed;
+                if (!write_body(ctx, size, body, fixed, cargo, record, false)) {
+                    return false;
+                }
+                auto base = cargo.base.cargo.lock();
+                auto& basename = cargo.base.basename;
+                auto u = unused_attr(cargo);
+                const std::string args = u + "std::uint8_t* __out, " + u + "std::size_t& __pos";
+                buf += "\nstd::size_t encoded_size() const {\n";
+                if (base) {
+                    buf += "std::size_t __size = " + basename + "::encoded_size();\n";
+                }
+                else {
+                    buf += "std::size_t __size = 0;\n";
+                }
+                buf += size;
+                write_endblock(buf);
+                buf += "\n" + ctx.error_enum() + " encode_to(" + args + ") const {\n";
+                if (base) {
+                    write_if(buf, "auto __e = " + basename + "::encode_to(__out, __pos); __e != " + ctx.error_enum() + "::none");
+                    write_beginblock(buf);
+                    write_return(buf, "__e");
+                    write_endblock(buf);
+                    write_return(buf, "encode_derived(__out, __pos)");
+                    write_endblock(buf);
+                    buf += "\n" + ctx.error_enum() + " encode_derived(" + args + ") const {\n";
+                }
+                buf += body;
+                write_endblock(buf);
+                buf += fixed;
+                buf += "\n" + ctx.error_enum() + " encode_to(std::uint8_t* __out) const {\n";
+                buf += "std::size_t __pos = 0;\n";
+                write_return(buf, "encode_to(__out, __pos)");
+                write_endblock(buf);
+                return write_iov(ctx, buf, cargo, record);
+            }
+        };
+    }  // namespace cpp
+}  // namespace binred
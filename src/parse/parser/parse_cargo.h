@@ -76,6 +76,14 @@ namespace binred {
                 return false;
             }
         }
+        Endian endian = Endian::none;
+        if (e->is_(TokenKind::keyword) && (e->has_("le") || e->has_("be"))) {
+            endian = e->has_("le") ? Endian::little : Endian::big;
+            e = r.ConsumeReadorEOF();
+            if (!e) {
+                return false;
+            }
+        }
         EXPAND_MACRO(mep)
         if (!e->has_("{")) {
             r.SetError(ErrorCode::expect_symbol, "{");
@@ -84,6 +92,7 @@ namespace binred {
         auto tmp = std::make_shared<Cargo>(std::move(start));
         tmp->name = name;
         tmp->base = std::move(base);
+        tmp->endian = endian;
         r.Consume();
         std::set<std::string> already_set;
         if (base.selfname.size()) {
@@ -110,6 +119,17 @@ namespace binred {
             }
             param->name = id->get_identifier();
             param->token = e;
+            // checksum range must start at param read before checksum itself
+            if (param->checksum && param->checksum->from.size()) {
+                bool found = false;
+                for (auto& p : tmp->params) {
+                    found = found || p->name == param->checksum->from;
+                }
+                if (!found) {
+                    r.SetError(ErrorCode::undefined_variable, "checksum");
+                    return false;
+                }
+            }
             tmp->params.push_back(param);
             tmp->expanded = tmp->expanded || param->expand;
             if (!already_set.insert(param->name).second) {
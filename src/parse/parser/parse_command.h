@@ -98,6 +98,7 @@ namespace binred {
         if (tmp->call = parse_callexpr(r, rec); !tmp->call) {
             return false;
         }
+        cmd = tmp;
         return true;
     }
 
@@ -166,7 +167,10 @@ namespace binred {
                     r.SetError(ErrorCode::multiple_default);
                     return false;
                 }
-                r.Consume();
+                e = r.ConsumeReadorEOF();
+                if (!e) {
+                    return false;
+                }
                 if (!e->has_(":")) {
                     r.SetError(ErrorCode::expect_symbol, ":");
                     return false;
@@ -224,6 +228,7 @@ namespace binred {
                     return false;
                 }
                 tmp->data.cargoname = e->to_string();
+                cmd = tmp;
                 r.Consume();
             }
             else {
@@ -285,6 +290,7 @@ namespace binred {
         if (!tmp->expr) {
             return false;
         }
+        cmd = tmp;
         return true;
     }
 
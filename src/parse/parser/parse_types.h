@@ -85,6 +85,57 @@ namespace binred {
                     r.Consume();
                     param->expand = true;
                 }
+                else if (e->has_("repeat")) {
+                    if (param->repeat) {
+                        r.SetError(ErrorCode::double_decoration, "repeat");
+                        return false;
+                    }
+                    r.Consume();
+                    auto tmp = std::make_shared<Repeat>();
+                    tmp->token = e;
+                    // `repeat byte expr` gives byte length instead of count
+                    if (auto b = r.ReadorEOF(); b && b->is_(TokenKind::keyword) && b->has_("byte")) {
+                        r.Consume();
+                        tmp->bytes = true;
+                    }
+                    tmp->expr = binary(r, mep.get_tree(), mep);
+                    if (!tmp->expr) {
+                        return false;
+                    }
+                    param->repeat = tmp;
+                }
+                else if (e->has_("checksum")) {
+                    if (param->checksum) {
+                        r.SetError(ErrorCode::double_decoration, "checksum");
+                        return false;
+                    }
+                    r.Consume();
+                    auto tmp = std::make_shared<Checksum>();
+                    tmp->token = e;
+                    if (!read_idname(r, tmp->algo)) {
+                        return false;
+                    }
+                    if (tmp->algo != "crc32" && tmp->algo != "crc32c" && tmp->algo != "adler32") {
+                        r.SetError(ErrorCode::expect_id, "crc32, crc32c or adler32");
+                        return false;
+                    }
+                    // `checksum algo $param` starts covered range at param
+                    if (auto d = r.Read(); d && d->has_("$")) {
+                        r.Consume();
+                        if (!read_idname(r, tmp->from)) {
+                            return false;
+                        }
+                    }
+                    param->checksum = tmp;
+                }
+                else if (e->has_("le") || e->has_("be")) {
+                    if (param->endian != Endian::none) {
+                        r.SetError(ErrorCode::double_decoration, "le/be");
+                        return false;
+                    }
+                    r.Consume();
+                    param->endian = e->has_("le") ? Endian::little : Endian::big;
+                }
                 else if (e->has_("nilable")) {
                     if (param->nilable) {
                         r.SetError(ErrorCode::double_decoration, "expand");
@@ -125,6 +176,22 @@ namespace binred {
             else if (e->has_("uint")) {
                 b = std::make_shared<UInt>();
             }
+            else if (e->has_("varint") || e->has_("leb128") || e->has_("zigzag")) {
+                if (e->has_("varint")) {
+                    b = std::make_shared<VarInt>();
+                }
+                else if (e->has_("leb128")) {
+                    b = std::make_shared<Leb128>();
+                }
+                else {
+                    b = std::make_shared<ZigZag>();
+                }
+                b->token = e;
+                r.Consume();
+                b->length = std::make_shared<ExprLength>();
+                param = b;
+                return parse_condition(r, param, mep);
+            }
             else {
                 r.SetError(ErrorCode::expect_type_keyword);
                 return false;
@@ -149,6 +216,18 @@ namespace binred {
         if (!parse_condition(r, param, mep)) {
             return false;
         }
+        if (param->repeat && (param->type == ParamType::bit || param->type == ParamType::byte)) {
+            r.SetError(ErrorCode::unexpected_keyword, "repeat");
+            return false;
+        }
+        if (param->checksum && (param->type != ParamType::uint || param->repeat)) {
+            r.SetError(ErrorCode::unexpected_keyword, "checksum");
+            return false;
+        }
+        if (param->endian != Endian::none && param->type != ParamType::integer && param->type != ParamType::uint && param->type != ParamType::custom) {
+            r.SetError(ErrorCode::unexpected_keyword, "le/be");
+            return false;
+        }
         return true;
     }
 }  // namespace binred
@@ -66,6 +66,9 @@ namespace binred {
                     "uint",
                     "bit",
                     "byte",
+                    "varint",
+                    "leb128",
+                    "zigzag",
                     "string",
                     "call",
                     "if",
@@ -78,6 +81,10 @@ namespace binred {
                     "test",
                     "expand",
                     "nilable",
+                    "repeat",
+                    "le",
+                    "checksum",
+                    "be",
                     "nil",
                     "true",
                     "false",
@@ -119,6 +126,7 @@ namespace binred {
         expect_condition_keyword,
         undefined_macro,
         unimplemented,
+        undefined_variable,
     };
 
     struct TokenReader : TokenReaderBase<std::string,true> {
@@ -30,6 +30,7 @@ namespace binred {
         std::string name;
         std::vector<std::shared_ptr<Param>> params;
         BaseInfo base;
+        Endian endian = Endian::none;
         bool expanded = false;
 
         std::map<std::string, std::weak_ptr<Cargo>> derived;
@@ -15,9 +15,35 @@ namespace binred {
         uint,
         bit,
         byte,
+        varint,
+        leb128,
+        zigzag,
         custom,
     };
 
+    // Endian is byte order of integer param, none follows cargo (big endian if cargo also has none)
+    enum class Endian {
+        none,
+        big,
+        little,
+    };
+
+    // Repeat makes param array of its type
+    // expr is element count, or byte length of whole array if bytes is true
+    struct Repeat {
+        std::shared_ptr<Expr> expr;
+        bool bytes = false;
+        std::shared_ptr<token_t> token;
+    };
+
+    // Checksum makes uint param checksum of preceding bytes of cargo
+    // algo is crc32, crc32c or adler32; bytes from param named from (or from start of cargo) up to this param are covered
+    struct Checksum {
+        std::string algo;
+        std::string from;
+        std::shared_ptr<token_t> token;
+    };
+
     struct Param {
         Param(ParamType t)
             : type(t) {}
@@ -26,6 +52,9 @@ namespace binred {
         std::shared_ptr<Condition> if_c;
         std::shared_ptr<Condition> bind_c;
         std::shared_ptr<Value> default_v;
+        std::shared_ptr<Repeat> repeat;
+        std::shared_ptr<Checksum> checksum;
+        Endian endian = Endian::none;
         std::shared_ptr<token_t> token;
         bool expand = false;
         bool nilable = false;
@@ -75,6 +104,25 @@ namespace binred {
             : Builtin(ParamType::byte) {}
     };
 
+    // VarInt is QUIC variable-length integer (2 bit length prefix, up to 62 bit value)
+    // it has no length because wire size is taken from prefix
+    struct VarInt : Builtin {
+        VarInt()
+            : Builtin(ParamType::varint) {}
+    };
+
+    // Leb128 is unsigned LEB128 (7 bit per byte, top bit continues), ZigZag is signed one zig-zag mapped onto it
+    // both have no length like VarInt
+    struct Leb128 : Builtin {
+        Leb128()
+            : Builtin(ParamType::leb128) {}
+    };
+
+    struct ZigZag : Builtin {
+        ZigZag()
+            : Builtin(ParamType::zigzag) {}
+    };
+
     struct Cargo;
 
     struct Custom : Param {
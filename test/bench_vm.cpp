@@ -0,0 +1,83 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+// bench_vm compares decode time of generated code, Interpreter and bytecode Machine
+// usage: bench_vm [<iterations>]; configure with -DCMAKE_BUILD_TYPE=Release for meaningful numbers
+// visitor of interpreters is Discard, so that only decoding is measured
+
+#include BINRED_TEST_HEADER
+#include "check.h"
+#include <build/build_files.h>
+#include <interpret/bytecode.h>
+#include <chrono>
+#include <cstdlib>
+
+using binred_test::bytes;
+using binred_test::wire;
+using namespace binred::interpret;
+
+template <class F>
+static double time_ns(size_t count, F&& f) {
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; i++) {
+        f();
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / double(count);
+}
+
+struct Bench {
+    Schema& schema;
+    Interpreter in;
+    Machine vm;
+    size_t count;
+    volatile size_t sink = 0;
+
+    Bench(Schema& schema, const Program& prog, size_t count)
+        : schema(schema), in(schema), vm(prog), count(count) {}
+
+    template <class T>
+    void run(const char* name, const std::string& input) {
+        auto p = bytes(input);
+        auto index = schema.index.at(name);
+        auto gen = time_ns(count, [&] {
+            T v;
+            size_t pos = 0;
+            CHECK(v.decode(p, input.size(), pos) == FrameError::none);
+            sink = sink + pos;
+        });
+        auto tree = time_ns(count, [&] {
+            size_t pos = 0;
+            CHECK(in.decode(name, p, input.size(), pos, Discard{}) == DecodeError::none);
+            sink = sink + pos;
+        });
+        auto code = time_ns(count, [&] {
+            size_t pos = 0;
+            CHECK(vm.decode(index, p, input.size(), pos, Discard{}) == DecodeError::none);
+            sink = sink + pos;
+        });
+        std::printf("%-12s generated %7.1fns  interpreter %7.1fns (%5.2fx)  vm %7.1fns (%5.2fx)\n",
+                    name, gen, tree, tree / gen, code, code / gen);
+    }
+};
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    binred::build::Build build;
+    CHECK(build.load({BINRED_TEST_SCHEMA_DIR "fields.brd", BINRED_TEST_SCHEMA_DIR "http2.brd"}, 1));
+    Schema schema;
+    CHECK(!Planner::build(build.record, schema));
+    auto prog = Compiler::compile(schema);
+    Bench b(schema, prog, count);
+    b.run<DataFrame>("DataFrame", wire("000006 00 08 00000001 02 61626364 6566"));
+    b.run<Settings>("Settings", wire("a5 fffffe 0003"));
+    b.run<Quic>("Quic", wire("c1 00000001 80000005"));
+    b.run<Folded>("Folded", wire("0002 01 00000007 61626364 6263"));
+    b.run<StreamFrame>("StreamFrame", wire("4005 03 04 61626364"));
+    b.run<Posting>("Posting", wire("0b 04 02 6162"));
+    b.run<Batch>("Batch", wire("0003 00000001 00000002 00000003 02 0001 0002 0003 0004 0003 020406 04 01020304"));
+    b.run<Mixed>("Mixed", wire("0100 00000002 030000 02 0400 0500"));
+}
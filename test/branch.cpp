@@ -0,0 +1,61 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#include BINRED_TEST_HEADER
+#include "check.h"
+
+using binred_test::bytes;
+using binred_test::wire;
+
+int main() {
+    // field skipped by condition must not keep value of previous message decoded into same object
+    std::string padded = wire("000006 00 08 00000001 02 61626364 6566");
+    std::string plain = wire("000003 00 00 00000001 646566");
+    DataFrame data;
+    CHECK(data.decode(bytes(padded), padded.size()) == FrameError::none);
+    CHECK(data.decode(bytes(plain), plain.size()) == FrameError::none);
+    CHECK(data.get_padding() == 0 && data.get_data() == "def" && data.get_pad() == "");
+
+    DataFrame streamed;
+    for (auto& input : {padded, plain}) {
+        binred_rt::stream_state st;
+        size_t pos = 0;
+        CHECK(streamed.decode_stream(st, bytes(input), input.size(), pos) == FrameError::none);
+    }
+    CHECK(streamed.get_padding() == 0 && streamed.get_data() == "def" && streamed.get_pad() == "");
+
+    std::string two = wire("02 00000001 6e6f 72");
+    std::string one = wire("01 05");
+    std::string none = wire("03");
+    Opt opt;
+    CHECK(opt.decode(bytes(two), two.size()) == FrameError::none);
+    CHECK(opt.get_big() == 1 && opt.get_rest() == "r");
+    CHECK(opt.decode(bytes(one), one.size()) == FrameError::none);
+    CHECK(opt.get_small() == 5 && opt.get_big() == 0 && opt.get_note()[0] == 0 && opt.get_rest() == "");
+    CHECK(opt.decode(bytes(two), two.size()) == FrameError::none);
+    CHECK(opt.get_small() == 0 && opt.get_note()[0] == 'n');
+    CHECK(opt.decode(bytes(none), none.size()) == FrameError::none);
+    CHECK(opt.get_small() == 0 && opt.get_big() == 0 && opt.get_note()[1] == 0 && opt.get_rest() == "");
+
+    // field whose condition is statically false is not on wire and keeps its default
+    std::string dead = wire("01 02");
+    Dead d;
+    size_t pos = 0;
+    CHECK(d.decode(bytes(dead), dead.size(), pos) == FrameError::none && pos == 2);
+    CHECK(d.get_a() == 1 && d.get_gone() == 7 && d.get_b() == 2);
+    CHECK(d.encoded_size() == 2);
+
+    // element which takes no byte fails instead of repeating forever
+    std::string zero = wire("02 0000");
+    RZ rz;
+    CHECK(rz.decode(bytes(zero), zero.size()) == FrameError::RZ_es_length);
+    CHECK(RZ::validate(bytes(zero), zero.size()) == FrameError::RZ_es_length);
+    RZ::Lazy lazy(bytes(zero), zero.size());
+    std::vector<Z> es;
+    CHECK(lazy.get_es(es) == FrameError::RZ_es_length);
+    std::puts("branch: ok");
+}
@@ -0,0 +1,42 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#include BINRED_TEST_HEADER
+#include "check.h"
+
+using binred_test::bytes;
+using binred_test::wire;
+
+int main() {
+    std::string padded = wire("000006 00 08 00000001 02 61626364 6566");
+    DataFrame data;
+    CHECK(data.decode(bytes(padded), padded.size()) == FrameError::none);
+    // payload is view into input
+    CHECK(data.get_data().data() == padded.data() + 10);
+    CHECK(data.get_pad().data() == padded.data() + 14);
+    CHECK(data.view_size() == 6);
+
+    // frame within one segment is viewed in place, frame straddling segments is viewed in joined copy
+    struct Segment {
+        const void* iov_base;
+        std::size_t iov_len;
+    } whole[] = {{padded.data(), padded.size()}}, split[] = {{padded.data(), 12}, {padded.data() + 12, padded.size() - 12}};
+    std::string joined;
+    DataFrame chained;
+    size_t pos = 0;
+    CHECK(chained.decode_iov(whole, 1, pos, joined) == FrameError::none && pos == padded.size());
+    CHECK(chained.get_data().data() == padded.data() + 10 && joined.empty());
+    pos = 0;
+    CHECK(chained.decode_iov(split, 2, pos, joined) == FrameError::none && pos == padded.size());
+    CHECK(joined == padded && chained.get_data().data() == joined.data() + 10 && chained.get_pad() == "ef");
+    auto owned = data.to_owned();
+    padded.assign(padded.size(), 'x');
+    CHECK(owned->get_data() == "abcd" && owned->get_pad() == "ef" && owned->get_length() == 6);
+    auto moved = std::move(owned);
+    CHECK(moved.value.get_data() == "abcd" && moved.value.get_data().data() == moved.storage.get());
+    std::puts("byte_view: ok");
+}
@@ -0,0 +1,52 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// CHECK stops test driver at first failed condition
+#define CHECK(cond)                                                                       \
+    do {                                                                                  \
+        if (!(cond)) {                                                                    \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            std::exit(1);                                                                 \
+        }                                                                                 \
+    } while (0)
+
+namespace binred_test {
+    inline const std::uint8_t* bytes(const std::string& s) {
+        return reinterpret_cast<const std::uint8_t*>(s.data());
+    }
+
+    // wire builds input from hex digits, other characters are ignored
+    inline std::string wire(const char* hex) {
+        std::string ret;
+        int half = -1;
+        for (; *hex; hex++) {
+            int v;
+            if (*hex >= '0' && *hex <= '9') {
+                v = *hex - '0';
+            }
+            else if (*hex >= 'a' && *hex <= 'f') {
+                v = *hex - 'a' + 10;
+            }
+            else {
+                continue;
+            }
+            if (half < 0) {
+                half = v;
+                continue;
+            }
+            ret.push_back(char(half * 16 + v));
+            half = -1;
+        }
+        return ret;
+    }
+}  // namespace binred_test
@@ -0,0 +1,28 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size);
+
+// stands in for libFuzzer: generated entry aborts if decoded value does not round trip
+int main() {
+    std::uint64_t s = 1;
+    std::string input;
+    for (size_t i = 0; i < 100000; i++) {
+        s = s * 6364136223846793005u + 1442695040888963407u;
+        input.resize(size_t(s >> 58));
+        for (auto& c : input) {
+            s = s * 6364136223846793005u + 1442695040888963407u;
+            c = char(s >> 56);
+        }
+        LLVMFuzzerTestOneInput(reinterpret_cast<const std::uint8_t*>(input.data()), input.size());
+    }
+    std::puts("fuzz: ok");
+}
@@ -0,0 +1,55 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#include BINRED_TEST_HEADER
+#include "check.h"
+
+using binred_test::bytes;
+using binred_test::wire;
+
+int main() {
+    std::string settings = wire("a5 fffffe 0003");
+    Settings s;
+    size_t pos = 0;
+    CHECK(binred_gen::decode(s, bytes(settings), settings.size(), pos) == FrameError::none && pos == settings.size());
+    CHECK(s.kind == 5 && s.value == -2 && s.id == 3);
+    std::string out(binred_gen::encoded_size(s), '\0');
+    CHECK(binred_gen::encode_to(s, reinterpret_cast<std::uint8_t*>(out.data())) == FrameError::none && out == settings);
+    std::string zero = wire("a5 fffffe 0000");
+    pos = 0;
+    CHECK(binred_gen::decode(s, bytes(zero), zero.size(), pos) == FrameError::Settings_id_bind);
+
+    std::string frame = wire("4005 03 04 61626364 ff");
+    StreamFrame f;
+    pos = 0;
+    CHECK(binred_gen::decode(f, bytes(frame), frame.size(), pos) == FrameError::none && pos == frame.size() - 1);
+    CHECK(f.id == 5 && f.off == 3 && f.len == 4 && f.data == "abcd");
+
+    // cargo with read block or checksum (and cargo linked to it) falls back to member functions
+    std::string padded = wire("000006 00 08 00000001 02 61626364 6566");
+    DataFrame data;
+    pos = 0;
+    CHECK(data.decode(bytes(padded), padded.size(), pos) == FrameError::none && data.get_data() == "abcd");
+    std::string msg(Msg{}.encoded_size(), '\0');
+    CHECK(Msg{}.encode_to(reinterpret_cast<std::uint8_t*>(msg.data())) == FrameError::none);
+    Msg m;
+    CHECK(m.decode(bytes(msg), msg.size()) == FrameError::none);
+
+    // cargo whose links are all supported stays generic
+    std::string line = wire("00000001 02 6162 0001 0002 74616773");
+    Line l;
+    pos = 0;
+    CHECK(binred_gen::decode(l, bytes(line), line.size(), pos) == FrameError::none && pos == line.size());
+    CHECK(l.id == 1 && l.name == "ab" && l.p.y == 2);
+
+    // element which takes no byte fails instead of repeating forever
+    std::string empty = wire("02 0000");
+    RZ rz;
+    pos = 0;
+    CHECK(binred_gen::decode(rz, bytes(empty), empty.size(), pos) == FrameError::RZ_es_length);
+    std::puts("generic: ok");
+}
@@ -0,0 +1,93 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#include BINRED_TEST_HEADER
+#include "check.h"
+
+// http2.brd has no checksum, fixed cargo array or bulk varint and is built without option,
+// so runtime blocks used only by them are not written
+#if defined(BINRED_RUNTIME_INTRIN) || defined(BINRED_RUNTIME_CHECKSUM) || defined(BINRED_RUNTIME_DECODE_MANY) || \
+    defined(BINRED_RUNTIME_BULK) || defined(BINRED_RUNTIME_HASH) || defined(BINRED_RUNTIME_RANDOM)
+#error "unused runtime block is written"
+#endif
+
+using binred_test::bytes;
+using binred_test::wire;
+
+// length 6, DATA, PADDED, stream 1, padding 2, data "abcd", pad "ef"
+static const std::string padded = wire("000006 00 08 00000001 02 61626364 6566");
+// length 3, DATA, stream 1, data "def"
+static const std::string plain = wire("000003 00 00 00000001 646566");
+// length 8, PING
+static const std::string ping = wire("000008 06 00 00000000 0102030405060708");
+
+struct Segment {
+    const void* iov_base;
+    std::size_t iov_len;
+};
+
+int main() {
+    FrameHeader head;
+    FrameHeader::transfer_t next = FrameHeader::transfer_t::none;
+    size_t pos = 0;
+    CHECK(head.decode(bytes(padded), padded.size(), pos, &next) == FrameError::none);
+    CHECK(pos == 9 && next == FrameHeader::transfer_t::DataFrame);
+    pos = 0;
+    CHECK(head.decode(bytes(ping), ping.size(), pos, &next) == FrameError::none);
+    CHECK(next == FrameHeader::transfer_t::Ping);
+
+    DataFrame data;
+    pos = 0;
+    CHECK(data.decode(bytes(padded), padded.size(), pos) == FrameError::none);
+    CHECK(pos == padded.size());
+    CHECK(data.get_padding() == 2 && data.get_data() == "abcd" && data.get_pad() == "ef");
+    std::string out(data.encoded_size(), '\0');
+    CHECK(data.encode_to(reinterpret_cast<std::uint8_t*>(out.data())) == FrameError::none);
+    CHECK(out == padded);
+    CHECK(data.decode(bytes(padded), padded.size() - 1) == FrameError::DataFrame_short_input);
+
+    Ping p;
+    CHECK(p.decode(bytes(ping), ping.size()) == FrameError::none);
+    CHECK(p.get_length() == 8);
+
+    CHECK(DataFrame::validate(bytes(padded), padded.size()) == FrameError::none);
+    CHECK(DataFrame::validate(bytes(padded), padded.size() - 1) != FrameError::none);
+    DataFrame::Lazy lazy(bytes(padded), padded.size());
+    std::string_view view;
+    CHECK(lazy.get_data(view) == FrameError::none && view == "abcd");
+    // variable length byte inside repeated nested cargo is decoded by getter
+    std::string nested = wire("01 03 616263");
+    C::Lazy clazy(bytes(nested), nested.size());
+    std::vector<E> es;
+    CHECK(clazy.get_es(es) == FrameError::none && es.size() == 1 && es[0].get_d() == "abc");
+
+    // one byte at a time
+    DataFrame streamed;
+    binred_rt::stream_state st;
+    FrameError err = FrameError::need_more;
+    for (size_t i = 0; i < padded.size(); i++) {
+        size_t off = 0;
+        err = streamed.decode_stream(st, bytes(padded) + i, 1, off);
+        CHECK(i + 1 == padded.size() || err == FrameError::need_more);
+    }
+    CHECK(err == FrameError::none && streamed.get_data() == "abcd" && streamed.get_pad() == "ef");
+
+    Segment iov[] = {{padded.data(), 5}, {padded.data() + 5, 7}, {padded.data() + 12, padded.size() - 12}};
+    DataFrame chained;
+    pos = 0;
+    CHECK(chained.decode_iov(iov, 3, pos) == FrameError::none);
+    CHECK(pos == padded.size() && chained.get_data() == "abcd" && chained.get_pad() == "ef");
+    pos = 0;
+    CHECK(chained.decode_iov(iov, 2, pos) == FrameError::DataFrame_short_input && pos == 0);
+    // frame within one segment is decoded directly
+    Segment whole[] = {{padded.data(), padded.size()}};
+    DataFrame direct;
+    pos = 0;
+    CHECK(direct.decode_iov(whole, 1, pos) == FrameError::none);
+    CHECK(pos == padded.size() && direct.get_data() == "abcd" && direct.get_pad() == "ef");
+    std::puts("http2: ok");
+}
@@ -0,0 +1,222 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#include BINRED_TEST_HEADER
+#include "check.h"
+#include <build/build_files.h>
+#include <interpret/bytecode.h>
+#include <cstring>
+
+using binred_test::bytes;
+using binred::interpret::Node;
+
+// interpreter loads same schema as generated header at run time
+// and must accept, reject and read every input like generated decoder
+// bytecode machine compiled from same schema must build same tree as interpreter
+
+static const Node& child(const Node& n, const char* key) {
+    auto found = n.find(key);
+    CHECK(found != nullptr);
+    return *found;
+}
+
+static std::int64_t number(const Node& n, const char* key) {
+    auto& c = child(n, key);
+    CHECK(c.kind == Node::Kind::number);
+    return c.number;
+}
+
+template <class Bytes>
+static bool same_bytes(const Node& n, const char* key, const Bytes& b) {
+    auto& c = child(n, key);
+    return c.kind == Node::Kind::bytes && c.bytes.size() == std::size(b) && std::memcmp(c.bytes.data(), std::data(b), c.bytes.size()) == 0;
+}
+
+template <class Vec>
+static bool same_numbers(const Node& n, const char* key, const Vec& v) {
+    auto& c = child(n, key);
+    if (c.kind != Node::Kind::array || c.children.size() != v.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < v.size(); i++) {
+        if (c.children[i].number != std::int64_t(v[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// fixed length byte is array and getter returns pointer to it
+static std::string_view fixed(const std::uint8_t* p, size_t len) {
+    return std::string_view(reinterpret_cast<const char*>(p), len);
+}
+
+static bool same_tree(const Node& a, const Node& b) {
+    if (a.kind != b.kind || a.name != b.name || a.number != b.number || a.bytes != b.bytes ||
+        a.cargo != b.cargo || a.children.size() != b.children.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.children.size(); i++) {
+        if (!same_tree(a.children[i], b.children[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#define NUM(key) CHECK(number(n, #key) == std::int64_t(v.get_##key()))
+// param with false if decoration is absent from tree and reset in struct
+#define NUM_IF(key) CHECK(n.find(#key) ? number(n, #key) == std::int64_t(v.get_##key()) : v.get_##key() == 0)
+
+struct Checker {
+    binred::build::Build build;
+    binred::interpret::Schema schema;
+    binred::interpret::Program prog;
+
+    Checker() {
+        CHECK(build.load({BINRED_TEST_SCHEMA_DIR "fields.brd", BINRED_TEST_SCHEMA_DIR "http2.brd", BINRED_TEST_SCHEMA_DIR "zero.brd"}, 1));
+        CHECK(!binred::interpret::Planner::build(build.record, schema));
+        prog = binred::interpret::Compiler::compile(schema);
+    }
+
+    // input rejected by generated decoder is rejected with err by both interpreter and machine
+    void reject(const char* name, const std::string& input, binred::interpret::DecodeError err) {
+        binred::interpret::Interpreter in(schema);
+        binred::interpret::Machine vm(prog);
+        size_t ipos = 0, vpos = 0;
+        CHECK(in.decode(name, bytes(input), input.size(), ipos, binred::interpret::Discard{}) == err);
+        CHECK(vm.decode(name, bytes(input), input.size(), vpos, binred::interpret::Discard{}) == err);
+    }
+
+    // input is random value encoded, its prefixes and copies with one byte overwritten
+    template <class T, class Fields>
+    void compare(const char* name, Fields&& fields) {
+        binred::interpret::Interpreter in(schema);
+        binred::interpret::Machine vm(prog);
+        binred::interpret::TreeBuilder tree, vmtree;
+        std::uint64_t seed = 11;
+        size_t made = 0, accepted = 0;
+        auto one = [&](const std::string& input) {
+            T v;
+            size_t gpos = 0, ipos = 0;
+            auto gerr = v.decode(bytes(input), input.size(), gpos);
+            tree.reset();
+            auto ierr = in.decode(name, bytes(input), input.size(), ipos, tree);
+            size_t vpos = 0;
+            vmtree.reset();
+            auto verr = vm.decode(name, bytes(input), input.size(), vpos, vmtree);
+            CHECK(verr == ierr);
+            CHECK((gerr == FrameError::none) == (ierr == binred::interpret::DecodeError::none));
+            if (gerr != FrameError::none) {
+                return;
+            }
+            CHECK(gpos == ipos && vpos == ipos && same_tree(tree.root, vmtree.root));
+            fields(v, tree.root);
+            accepted++;
+        };
+        for (size_t i = 0; i < 1000 && made < 50; i++) {
+            T v;
+            if (v.randomize(seed) != FrameError::none) {
+                continue;
+            }
+            std::string enc(v.encoded_size(), '\0');
+            if (v.encode_to(reinterpret_cast<std::uint8_t*>(enc.data())) != FrameError::none) {
+                continue;
+            }
+            made++;
+            for (size_t k = 0; k <= enc.size(); k++) {
+                one(enc.substr(0, k));
+            }
+            for (size_t k = 0; k < enc.size(); k++) {
+                auto flip = enc;
+                flip[k] = char(binred_rt::random_next(seed));
+                one(flip);
+            }
+        }
+        CHECK(made != 0);
+        std::printf("%s: %zu values, %zu accepted inputs\n", name, made, accepted);
+    }
+};
+
+int main() {
+    Checker c;
+    c.compare<Settings>("Settings", [](const Settings& v, const Node& n) {
+        NUM(flagA);
+        NUM(flagB);
+        NUM(kind);
+        NUM(value);
+        NUM(id);
+    });
+    c.compare<Quic>("Quic", [](const Quic& v, const Node& n) {
+        NUM(form);
+        NUM(fixed);
+        NUM(ptype);
+        NUM(pnlen);
+        NUM(version);
+        NUM(r);
+        NUM(sid);
+    });
+    c.compare<Folded>("Folded", [](const Folded& v, const Node& n) {
+        NUM(a);
+        NUM(b);
+        NUM(c);
+        CHECK(same_bytes(n, "d", fixed(v.get_d(), 4)) && same_bytes(n, "e", v.get_e()));
+    });
+    c.compare<Fixed>("Fixed", [](const Fixed& v, const Node& n) {
+        NUM(f);
+        NUM(g);
+        CHECK(same_bytes(n, "z", fixed(v.get_z(), 8)));
+        auto& p = child(n, "p");
+        CHECK(number(p, "x") == v.get_p().get_x() && number(p, "y") == v.get_p().get_y());
+    });
+    c.compare<StreamFrame>("StreamFrame", [](const StreamFrame& v, const Node& n) {
+        NUM(id);
+        NUM_IF(off);
+        NUM(len);
+        CHECK(same_bytes(n, "data", v.get_data()));
+    });
+    c.compare<Posting>("Posting", [](const Posting& v, const Node& n) {
+        NUM(doc);
+        NUM(delta);
+        NUM_IF(tf);
+        CHECK(same_bytes(n, "name", v.get_name()));
+    });
+    c.compare<Batch>("Batch", [](const Batch& v, const Node& n) {
+        NUM(n);
+        NUM(m);
+        NUM(blen);
+        NUM(vlen);
+        CHECK(same_numbers(n, "ids", v.get_ids()) && same_numbers(n, "deltas", v.get_deltas()) && same_numbers(n, "vs", v.get_vs()));
+        auto& points = child(n, "points");
+        CHECK(points.children.size() == v.get_points().size());
+        for (size_t i = 0; i < points.children.size(); i++) {
+            CHECK(number(points.children[i], "x") == v.get_points()[i].get_x());
+            CHECK(number(points.children[i], "y") == v.get_points()[i].get_y());
+        }
+    });
+    c.compare<Mixed>("Mixed", [](const Mixed& v, const Node& n) {
+        NUM(a);
+        NUM(b);
+        NUM(c);
+        NUM(n);
+        CHECK(same_numbers(n, "arr", v.get_arr()));
+    });
+    c.compare<DataFrame>("DataFrame", [](const DataFrame& v, const Node& n) {
+        NUM(length);
+        NUM(flag);
+        NUM(id);
+        NUM_IF(padding);
+        CHECK(same_bytes(n, "data", v.get_data()) && same_bytes(n, "pad", v.get_pad()));
+    });
+    // element which takes no byte fails instead of repeating forever
+    std::string empty = binred_test::wire("02 0000");
+    RZ rz;
+    size_t pos = 0;
+    CHECK(rz.decode(bytes(empty), empty.size(), pos) == FrameError::RZ_es_length);
+    c.reject("RZ", empty, binred::interpret::DecodeError::length);
+    std::puts("interpret: ok");
+}
@@ -0,0 +1,30 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#include BINRED_TEST_HEADER
+#include "check.h"
+#include <memory_resource>
+
+using binred_test::bytes;
+using binred_test::wire;
+
+int main() {
+    std::string padded = wire("000006 00 08 00000001 02 61626364 6566");
+    std::string batch = wire("0002 00000001 00000002 01 0001 0002 0002 0203 01 05");
+    char area[4096];
+    std::pmr::monotonic_buffer_resource arena(area, sizeof(area), std::pmr::null_memory_resource());
+    DataFrame data{DataFrame::allocator_type(&arena)};
+    CHECK(data.decode(bytes(padded), padded.size()) == FrameError::none);
+    CHECK(data.get_data() == "abcd" && data.get_data().get_allocator().resource() == &arena);
+    Batch b{Batch::allocator_type(&arena)};
+    CHECK(b.decode(bytes(batch), batch.size()) == FrameError::none);
+    CHECK(b.get_ids().size() == 2 && b.get_ids().get_allocator().resource() == &arena);
+    CHECK(b.get_points().size() == 1 && b.get_points()[0].get_y() == 2);
+    CHECK(b.get_deltas().size() == 2 && b.get_deltas()[0] == 1 && b.get_deltas()[1] == -2);
+    CHECK(b.get_vs().size() == 1 && b.get_vs()[0] == 5);
+    std::puts("pmr: ok");
+}
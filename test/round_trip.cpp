@@ -0,0 +1,65 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#include BINRED_TEST_HEADER
+#include "check.h"
+#include <unordered_set>
+
+using binred_test::bytes;
+
+// random value encodes, and its decoding encodes to same bytes and decodes again to equal value
+// decoded value is compared because checksum field of random value is not what encode_to writes
+template <class T>
+static void round_trip(const char* name) {
+    std::uint64_t seed = 7;
+    std::unordered_set<std::uint64_t> hashes;
+    size_t made = 0;
+    for (size_t i = 0; i < 2000 && made < 200; i++) {
+        T v;
+        if (v.randomize(seed) != FrameError::none) {
+            continue;
+        }
+        std::string once(v.encoded_size(), '\0');
+        if (v.encode_to(reinterpret_cast<std::uint8_t*>(once.data())) != FrameError::none) {
+            continue;
+        }
+        made++;
+        T back;
+        size_t pos = 0;
+        CHECK(back.decode(bytes(once), once.size(), pos) == FrameError::none && pos == once.size());
+        std::string twice(back.encoded_size(), '\0');
+        CHECK(back.encode_to(reinterpret_cast<std::uint8_t*>(twice.data())) == FrameError::none && twice == once);
+        T again;
+        CHECK(again.decode(bytes(twice), twice.size()) == FrameError::none);
+        CHECK(again == back && again.hash() == back.hash());
+        hashes.insert(back.hash());
+    }
+    CHECK(made != 0);
+    std::printf("%s: %zu values, %zu hashes\n", name, made, hashes.size());
+}
+
+// lazy_scan of fixed layout cargo records constant offsets of byte and nested cargo
+static void fixed_offsets() {
+    std::string in(13, '\x5a');
+    Fixed v;
+    std::size_t pos = 0, offs[2] = {}, lens[2] = {};
+    CHECK(v.lazy_scan(bytes(in), in.size(), pos, offs, lens) == FrameError::none && pos == in.size());
+    CHECK(offs[0] == 1 && lens[0] == 8 && offs[1] == 9 && lens[1] == 4);
+}
+
+int main() {
+    fixed_offsets();
+    round_trip<Settings>("Settings");
+    round_trip<Quic>("Quic");
+    round_trip<Fixed>("Fixed");
+    round_trip<StreamFrame>("StreamFrame");
+    round_trip<Posting>("Posting");
+    round_trip<Batch>("Batch");
+    round_trip<Mixed>("Mixed");
+    round_trip<Msg>("Msg");
+    round_trip<Frame>("Frame");
+}
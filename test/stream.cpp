@@ -0,0 +1,72 @@
+/*
+    binred - binary I/O code generator
+    Copyright (c) 2021 on-keyday (https://github.com/on-keyday)
+    Released under the MIT license
+    https://opensource.org/licenses/mit-license.php
+*/
+
+#include BINRED_TEST_HEADER
+#include "check.h"
+
+using binred_test::bytes;
+using binred_test::wire;
+
+struct Segment {
+    const void* iov_base;
+    std::size_t iov_len;
+};
+
+template <class T>
+concept streamable = requires(T v, binred_rt::stream_state st, const std::uint8_t* p, std::size_t n, std::size_t pos) {
+    v.decode_stream(st, p, n, pos);
+    v.decode_resume(st, 0, p, n, pos);
+};
+
+template <class T>
+concept chainable = requires(T v, std::size_t n, std::size_t pos, const Segment* iov) {
+    v.decode_iov(iov, n, pos);
+};
+
+// cargo which can not be decoded incrementally must not bind to decoder of its base
+static_assert(streamable<Base> && streamable<Line> && streamable<Msg>);
+static_assert(!streamable<Rec>, "array of cargo");
+static_assert(!streamable<Frame>, "more than one checksum");
+static_assert(chainable<Base> && chainable<Line> && chainable<Msg>);
+// decode_iov of them decodes from joined copy
+static_assert(chainable<Rec> && chainable<Frame>);
+
+int main() {
+    std::string rec = wire("00000001 02 6869 0001 0002 61626364 0003 0004 65666768 0005 0006 696a6b6c");
+    Rec r;
+    size_t pos = 0;
+    CHECK(r.decode(bytes(rec), rec.size(), pos) == FrameError::none && pos == rec.size());
+    CHECK(r.get_name() == "hi" && r.get_pts()[1].get_y() == 4 && r.get_p().get_x() == 5);
+
+    // two records back to back, both straddling segments
+    std::string recs = rec + rec;
+    Segment split[] = {{recs.data(), 6}, {recs.data() + 6, rec.size()}, {recs.data() + 6 + rec.size(), rec.size() - 6}};
+    for (size_t i = 0; i < 2; i++) {
+        Rec joined;
+        pos = i * rec.size();
+        CHECK(joined.decode_iov(split, 3, pos) == FrameError::none && pos == (i + 1) * rec.size());
+        CHECK(joined.get_name() == "hi" && joined.get_pts()[1].get_y() == 4 && joined.get_p().get_x() == 5);
+    }
+    pos = rec.size();
+    CHECK(r.decode_iov(split, 2, pos) == FrameError::Rec_short_input && pos == rec.size());
+
+    std::string line = wire("00000001 02 6869 0005 0006 696a6b6c");
+    Line l;
+    binred_rt::stream_state st;
+    FrameError err = FrameError::need_more;
+    for (size_t i = 0; i < line.size(); i++) {
+        size_t off = 0;
+        err = l.decode_stream(st, bytes(line) + i, 1, off);
+    }
+    CHECK(err == FrameError::none && l.get_id() == 1 && l.get_name() == "hi" && l.get_p().get_y() == 6);
+    Segment iov[] = {{line.data(), 3}, {line.data() + 3, 5}, {line.data() + 8, line.size() - 8}};
+    Line chained;
+    pos = 0;
+    CHECK(chained.decode_iov(iov, 3, pos) == FrameError::none && pos == line.size());
+    CHECK(chained.get_name() == "hi" && chained.get_p().get_y() == 6);
+    std::puts("stream: ok");
+}